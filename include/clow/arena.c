@@ -0,0 +1,152 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: arena.c
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+#include "clow/arena.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+/* Alignment of max_align_t without requiring C11. */
+typedef union {
+	long double ld;
+	double d;
+	void* p;
+	void (*f)(void);
+	long long ll;
+} arena_max_align;
+
+#define ARENA_DEFAULT_ALIGNMENT (sizeof(arena_max_align) >= 16 ? 16 : sizeof(arena_max_align))
+
+void arena_initialize(arena_t* allocator, void* buffer, size_t buffer_size) {
+	assert(allocator != NULL);
+	assert(buffer != NULL || buffer_size == 0);
+	allocator->buffer = buffer;
+	allocator->buffer_size = buffer_size;
+	allocator->offset = 0;
+	allocator->peak = 0;
+}
+
+void* arena_alloc(arena_t* allocator, size_t bytes, size_t alignment) {
+	uintptr_t start;
+	uintptr_t aligned;
+	size_t offset;
+	assert(allocator != NULL);
+
+	if (alignment == 0)
+		alignment = ARENA_DEFAULT_ALIGNMENT;
+	assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+	// Align the address, not the offset, the buffer itself can be unaligned
+	start = (uintptr_t)allocator->buffer + allocator->offset;
+	aligned = (start + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	offset = allocator->offset + (size_t)(aligned - start);
+	if (aligned < start || offset > allocator->buffer_size || bytes > allocator->buffer_size - offset)
+	{
+		//Requesting more memory than available
+		return NULL;
+	}
+
+	allocator->offset = offset + bytes;
+	if (allocator->offset > allocator->peak)
+		allocator->peak = allocator->offset;
+	return (void*)aligned;
+}
+
+arena_marker arena_get_marker(arena_t* allocator) {
+	assert(allocator != NULL);
+	return allocator->offset;
+}
+
+void arena_restore(arena_t* allocator, arena_marker marker) {
+	assert(allocator != NULL);
+	assert(marker <= allocator->offset && "Marker is after the current position, it was taken before a restore or a reset!");
+	if (marker <= allocator->offset)
+		allocator->offset = marker;
+}
+
+void arena_reset(arena_t* allocator) {
+	assert(allocator != NULL);
+	allocator->offset = 0;
+}
+
+size_t arena_remaining(arena_t* allocator) {
+	assert(allocator != NULL);
+	return allocator->buffer_size - allocator->offset;
+}
+
+void arena_frame_initialize(arena_frame_t* allocator, void* buffer, size_t buffer_size, size_t frame_count) {
+	size_t frame_size;
+	size_t i;
+	assert(allocator != NULL);
+	assert(frame_count >= 1 && frame_count <= ARENA_FRAME_MAX && "Frame count must be between 1 and ARENA_FRAME_MAX!");
+
+	if (frame_count < 1)
+		frame_count = 1;
+	if (frame_count > ARENA_FRAME_MAX)
+		frame_count = ARENA_FRAME_MAX;
+
+	frame_size = buffer_size / frame_count;
+	for (i = 0; i < ARENA_FRAME_MAX; i++)
+	{
+		if (i < frame_count)
+			arena_initialize(&allocator->arenas[i], (void*)((uintptr_t)buffer + i * frame_size), frame_size);
+		else
+			arena_initialize(&allocator->arenas[i], NULL, 0);
+	}
+	allocator->frame_count = frame_count;
+	allocator->frame_index = 0;
+}
+
+void arena_frame_begin(arena_frame_t* allocator) {
+	assert(allocator != NULL);
+	allocator->frame_index++;
+	arena_reset(arena_frame_current(allocator));
+}
+
+void* arena_frame_alloc(arena_frame_t* allocator, size_t bytes, size_t alignment) {
+	return arena_alloc(arena_frame_current(allocator), bytes, alignment);
+}
+
+arena_t* arena_frame_current(arena_frame_t* allocator) {
+	assert(allocator != NULL);
+	return &allocator->arenas[allocator->frame_index % allocator->frame_count];
+}
+
+arena_t* arena_frame_previous(arena_frame_t* allocator, size_t age) {
+	assert(allocator != NULL);
+	assert(age < allocator->frame_count && "That frame arena has already been recycled!");
+	assert(age <= allocator->frame_index && "No frame that old yet!");
+	return &allocator->arenas[(allocator->frame_index + allocator->frame_count - age % allocator->frame_count) % allocator->frame_count];
+}
@@ -0,0 +1,142 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: arena.h
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// DESCRIPTION: A linear (bump pointer) arena over an externally allocated buffer.
+// Allocations have no header and can't be released one by one, instead a marker saves the
+// current position to restore it later and reset releases everything, both in O(1).
+// The frame variant splits the buffer in 2 or 3 arenas used round robin, one per frame, so the
+// scratch memory of the previous frames stays valid while the current one is built.
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ First version.
+//
+// USAGE ////////////////////////////////////////////////////////////////////////////////////
+//
+// arena_t arena;
+// arena_initialize(&arena, mem, size);
+//
+// float* positions = (float*)arena_alloc(&arena, 1024 * sizeof(float), 16);
+// arena_marker marker = arena_get_marker(&arena);
+// void* temporary = arena_alloc(&arena, 4096, 8);
+// arena_restore(&arena, marker); // temporary is released, positions is still valid
+// arena_reset(&arena);           // everything is released
+//
+// Double buffered frames
+// arena_frame_t frames;
+// arena_frame_initialize(&frames, mem, size, 2);
+// while (running)
+// {
+//     arena_frame_begin(&frames);                          // recycles the arena of frame N - 2
+//     void* scratch = arena_frame_alloc(&frames, 256, 16); // valid during frame N and N + 1
+//     arena_t* last = arena_frame_previous(&frames, 1);    // frame N - 1 data is still there
+// }
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INCLUDED_ARENA
+#define INCLUDED_ARENA
+
+#include <stddef.h>
+
+/* Max arenas of a frame arena, triple buffering. */
+#define ARENA_FRAME_MAX 3
+
+/* Defines the arena allocator. */
+typedef struct {
+	void* buffer;
+	size_t buffer_size;
+	/* Bytes used from the start of the buffer, the next allocation starts here. */
+	size_t offset;
+	/* Highest offset reached, to size the buffer. */
+	size_t peak;
+} arena;
+
+/* Position of an arena, restoring it releases everything allocated after. */
+typedef size_t arena_marker;
+
+/* Round robin arenas, one per frame in flight. */
+typedef struct {
+	arena arenas[ARENA_FRAME_MAX];
+	size_t frame_count;
+	/* Frames begun, the current arena is frame_index % frame_count. */
+	size_t frame_index;
+} arena_frame;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+	typedef arena arena_t;
+	typedef arena_frame arena_frame_t;
+
+	/* Initialize the arena, empty. */
+	void arena_initialize(arena_t* allocator, void* buffer, size_t buffer_size);
+
+	/* Allocates bytes aligned to alignment, a power of two (0 is the alignment of max_align_t).
+	   NULL when the remaining space is not enough. */
+	void* arena_alloc(arena_t* allocator, size_t bytes, size_t alignment);
+
+	/* Returns the current position. */
+	arena_marker arena_get_marker(arena_t* allocator);
+
+	/* Releases everything allocated after the marker, markers taken after it become invalid. */
+	void arena_restore(arena_t* allocator, arena_marker marker);
+
+	/* Releases everything. */
+	void arena_reset(arena_t* allocator);
+
+	/* Bytes left at the end of the buffer, the padding of an aligned allocation is not accounted. */
+	size_t arena_remaining(arena_t* allocator);
+
+	/* Initialize frame_count (1 to ARENA_FRAME_MAX) arenas sharing the buffer evenly. The first frame is begun. */
+	void arena_frame_initialize(arena_frame_t* allocator, void* buffer, size_t buffer_size, size_t frame_count);
+
+	/* Starts a new frame, resetting the arena of frame_count frames ago. */
+	void arena_frame_begin(arena_frame_t* allocator);
+
+	/* Allocates from the arena of the current frame. */
+	void* arena_frame_alloc(arena_frame_t* allocator, size_t bytes, size_t alignment);
+
+	/* Arena of the current frame. */
+	arena_t* arena_frame_current(arena_frame_t* allocator);
+
+	/* Arena of age frames ago, its allocations are still valid. age must be lower than frame_count. */
+	arena_t* arena_frame_previous(arena_frame_t* allocator, size_t age);
+
+#if defined(__cplusplus)
+};
+#endif
+
+
+#endif /*INCLUDED_ARENA*/
@@ -41,6 +41,7 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -143,6 +144,641 @@ static void coalescence(freelist* const allocator, freelist_block* current) {
 }
 
 
+/* TLSF mode ////////////////////////////////////////////////////////////////////////////// */
+
+/* Block sizes are multiple of the alignment, so the two low bits of the size are free for flags. */
+#define FREELIST_TLSF_ALIGN_SIZE_LOG2 (sizeof(size_t) == 8 ? 3 : 2)
+#define FREELIST_TLSF_ALIGN_SIZE ((size_t)1 << FREELIST_TLSF_ALIGN_SIZE_LOG2)
+
+/* Number of second level subdivisions for each first level class (power of two). */
+#define FREELIST_TLSF_SL_INDEX_COUNT_LOG2 4
+#define FREELIST_TLSF_SL_INDEX_COUNT (1 << FREELIST_TLSF_SL_INDEX_COUNT_LOG2)
+
+/* Biggest block is 2^FL_INDEX_MAX, blocks below SMALL_BLOCK_SIZE are all kept in first level 0. */
+#define FREELIST_TLSF_FL_INDEX_MAX (sizeof(size_t) == 8 ? 32 : 30)
+#define FREELIST_TLSF_FL_INDEX_SHIFT (FREELIST_TLSF_SL_INDEX_COUNT_LOG2 + FREELIST_TLSF_ALIGN_SIZE_LOG2)
+#define FREELIST_TLSF_FL_INDEX_COUNT (FREELIST_TLSF_FL_INDEX_MAX - FREELIST_TLSF_FL_INDEX_SHIFT + 1)
+#define FREELIST_TLSF_SMALL_BLOCK_SIZE ((size_t)1 << FREELIST_TLSF_FL_INDEX_SHIFT)
+
+#define FREELIST_TLSF_BLOCK_FREE_BIT ((size_t)1 << 0)
+#define FREELIST_TLSF_BLOCK_PREV_FREE_BIT ((size_t)1 << 1)
+
+/* A block in TLSF mode.
+   prev_physical is the boundary tag, it's stored in the last word of the previous block and it's valid only if the previous block is free.
+   size is the freelist_header of the block, the only overhead of used blocks.
+   next_free and prev_free overlap the payload and are valid only while the block is free. */
+typedef struct freelist_tlsf_block {
+	struct freelist_tlsf_block* prev_physical;
+	size_t size;
+	struct freelist_tlsf_block* next_free;
+	struct freelist_tlsf_block* prev_free;
+} freelist_tlsf_block;
+
+/* Segregated lists of free blocks, a bit set in fl_bitmap means that sl_bitmap of that class has a bit set,
+   a bit set in sl_bitmap means that the matching list is not empty. Empty lists point to block_null. */
+typedef struct freelist_tlsf_control {
+	freelist_tlsf_block block_null;
+	unsigned int fl_bitmap;
+	unsigned int sl_bitmap[FREELIST_TLSF_FL_INDEX_COUNT];
+	freelist_tlsf_block* blocks[FREELIST_TLSF_FL_INDEX_COUNT][FREELIST_TLSF_SL_INDEX_COUNT];
+} freelist_tlsf_control;
+
+/* Overhead of a used block is only the size. */
+#define FREELIST_TLSF_BLOCK_OVERHEAD (sizeof(size_t))
+/* Offset of the payload from the block start. */
+#define FREELIST_TLSF_BLOCK_START_OFFSET (offsetof(freelist_tlsf_block, size) + sizeof(size_t))
+/* A free block must be able to store the list links and the next block boundary tag. */
+#define FREELIST_TLSF_BLOCK_SIZE_MIN (sizeof(freelist_tlsf_block) - sizeof(freelist_tlsf_block*))
+#define FREELIST_TLSF_BLOCK_SIZE_MAX ((size_t)1 << FREELIST_TLSF_FL_INDEX_MAX)
+
+/* Index of the least significant bit set, -1 when none. */
+static int freelist_tlsf_ffs(unsigned int word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return word ? __builtin_ctz(word) : -1;
+#else
+	int bit;
+	if (!word)
+		return -1;
+	bit = 0;
+	while (!(word & 1u))
+	{
+		word >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/* Index of the most significant bit set, -1 when none. */
+static int freelist_tlsf_fls(size_t size)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return size ? 63 - __builtin_clzll((unsigned long long)size) : -1;
+#else
+	int bit;
+	bit = -1;
+	while (size)
+	{
+		size >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+static size_t freelist_tlsf_align_up(size_t x, size_t align)
+{
+	assert((align & (align - 1)) == 0 && "Must be power of two!");
+	return (x + (align - 1)) & ~(align - 1);
+}
+
+static size_t freelist_tlsf_align_down(size_t x, size_t align)
+{
+	assert((align & (align - 1)) == 0 && "Must be power of two!");
+	return x - (x & (align - 1));
+}
+
+static size_t freelist_tlsf_block_size(const freelist_tlsf_block* block)
+{
+	return block->size & ~(FREELIST_TLSF_BLOCK_FREE_BIT | FREELIST_TLSF_BLOCK_PREV_FREE_BIT);
+}
+
+static void freelist_tlsf_block_set_size(freelist_tlsf_block* block, size_t size)
+{
+	block->size = size | (block->size & (FREELIST_TLSF_BLOCK_FREE_BIT | FREELIST_TLSF_BLOCK_PREV_FREE_BIT));
+}
+
+static int freelist_tlsf_block_is_last(const freelist_tlsf_block* block)
+{
+	return freelist_tlsf_block_size(block) == 0;
+}
+
+static int freelist_tlsf_block_is_free(const freelist_tlsf_block* block)
+{
+	return (block->size & FREELIST_TLSF_BLOCK_FREE_BIT) != 0;
+}
+
+static void freelist_tlsf_block_set_free(freelist_tlsf_block* block)
+{
+	block->size |= FREELIST_TLSF_BLOCK_FREE_BIT;
+}
+
+static void freelist_tlsf_block_set_used(freelist_tlsf_block* block)
+{
+	block->size &= ~FREELIST_TLSF_BLOCK_FREE_BIT;
+}
+
+static int freelist_tlsf_block_is_prev_free(const freelist_tlsf_block* block)
+{
+	return (block->size & FREELIST_TLSF_BLOCK_PREV_FREE_BIT) != 0;
+}
+
+static void freelist_tlsf_block_set_prev_free(freelist_tlsf_block* block)
+{
+	block->size |= FREELIST_TLSF_BLOCK_PREV_FREE_BIT;
+}
+
+static void freelist_tlsf_block_set_prev_used(freelist_tlsf_block* block)
+{
+	block->size &= ~FREELIST_TLSF_BLOCK_PREV_FREE_BIT;
+}
+
+static void* freelist_tlsf_block_to_ptr(freelist_tlsf_block* block)
+{
+	return freelist_offset_ptr(block, FREELIST_TLSF_BLOCK_START_OFFSET);
+}
+
+static freelist_tlsf_block* freelist_tlsf_ptr_to_block(void* ptr)
+{
+	return (freelist_tlsf_block*)freelist_subtract_ptr(ptr, FREELIST_TLSF_BLOCK_START_OFFSET);
+}
+
+/* Next physical block, its boundary tag overlaps the last word of this block. */
+static freelist_tlsf_block* freelist_tlsf_block_next(freelist_tlsf_block* block)
+{
+	assert(!freelist_tlsf_block_is_last(block));
+	return (freelist_tlsf_block*)freelist_offset_ptr(freelist_tlsf_block_to_ptr(block), freelist_tlsf_block_size(block) - FREELIST_TLSF_BLOCK_OVERHEAD);
+}
+
+/* Write the boundary tag of the next block and return it. */
+static freelist_tlsf_block* freelist_tlsf_block_link_next(freelist_tlsf_block* block)
+{
+	freelist_tlsf_block* next;
+	next = freelist_tlsf_block_next(block);
+	next->prev_physical = block;
+	return next;
+}
+
+static void freelist_tlsf_block_mark_as_free(freelist_tlsf_block* block)
+{
+	freelist_tlsf_block* next;
+	next = freelist_tlsf_block_link_next(block);
+	freelist_tlsf_block_set_prev_free(next);
+	freelist_tlsf_block_set_free(block);
+}
+
+static void freelist_tlsf_block_mark_as_used(freelist_tlsf_block* block)
+{
+	freelist_tlsf_block* next;
+	next = freelist_tlsf_block_next(block);
+	freelist_tlsf_block_set_prev_used(next);
+	freelist_tlsf_block_set_used(block);
+}
+
+/* First and second level index of the class containing size. */
+static void freelist_tlsf_mapping_insert(size_t size, int* fl, int* sl)
+{
+	if (size < FREELIST_TLSF_SMALL_BLOCK_SIZE)
+	{
+		*fl = 0;
+		*sl = (int)(size / (FREELIST_TLSF_SMALL_BLOCK_SIZE / FREELIST_TLSF_SL_INDEX_COUNT));
+	}
+	else
+	{
+		*fl = freelist_tlsf_fls(size);
+		*sl = (int)(size >> (*fl - FREELIST_TLSF_SL_INDEX_COUNT_LOG2)) ^ (1 << FREELIST_TLSF_SL_INDEX_COUNT_LOG2);
+		*fl -= (FREELIST_TLSF_FL_INDEX_SHIFT - 1);
+	}
+}
+
+/* Like mapping insert but rounds up to the next class, so any block of that class is big enough. */
+static void freelist_tlsf_mapping_search(size_t size, int* fl, int* sl)
+{
+	if (size >= FREELIST_TLSF_SMALL_BLOCK_SIZE)
+	{
+		size += ((size_t)1 << (freelist_tlsf_fls(size) - FREELIST_TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+	}
+	freelist_tlsf_mapping_insert(size, fl, sl);
+}
+
+static freelist_tlsf_block* freelist_tlsf_search_suitable_block(freelist_tlsf_control* control, int* fl, int* sl)
+{
+	unsigned int sl_map;
+	unsigned int fl_map;
+
+	// Search in the same first level class for a bigger second level
+	sl_map = control->sl_bitmap[*fl] & (~0u << *sl);
+	if (!sl_map)
+	{
+		// Nothing, search in the bigger first level classes
+		fl_map = control->fl_bitmap & (~0u << (*fl + 1));
+		if (!fl_map)
+			return NULL;
+
+		*fl = freelist_tlsf_ffs(fl_map);
+		sl_map = control->sl_bitmap[*fl];
+	}
+	assert(sl_map && "Second level bitmap is corrupted!");
+	*sl = freelist_tlsf_ffs(sl_map);
+
+	return control->blocks[*fl][*sl];
+}
+
+static void freelist_tlsf_remove_free_block(freelist_tlsf_control* control, freelist_tlsf_block* block, int fl, int sl)
+{
+	freelist_tlsf_block* prev;
+	freelist_tlsf_block* next;
+	prev = block->prev_free;
+	next = block->next_free;
+	assert(prev && "prev_free must not be null");
+	assert(next && "next_free must not be null");
+	next->prev_free = prev;
+	prev->next_free = next;
+
+	// If block is the head of the list update the head and the bitmaps when it becomes empty
+	if (control->blocks[fl][sl] == block)
+	{
+		control->blocks[fl][sl] = next;
+		if (next == &control->block_null)
+		{
+			control->sl_bitmap[fl] &= ~(1u << sl);
+			if (!control->sl_bitmap[fl])
+			{
+				control->fl_bitmap &= ~(1u << fl);
+			}
+		}
+	}
+}
+
+static void freelist_tlsf_insert_free_block(freelist_tlsf_control* control, freelist_tlsf_block* block, int fl, int sl)
+{
+	freelist_tlsf_block* current;
+	current = control->blocks[fl][sl];
+	assert(current && "Free list must not be null");
+	block->next_free = current;
+	block->prev_free = &control->block_null;
+	current->prev_free = block;
+
+	assert(freelist_tlsf_block_to_ptr(block) == (void*)freelist_tlsf_align_up((size_t)(uintptr_t)freelist_tlsf_block_to_ptr(block), FREELIST_TLSF_ALIGN_SIZE) && "Block not aligned properly");
+
+	control->blocks[fl][sl] = block;
+	control->fl_bitmap |= (1u << fl);
+	control->sl_bitmap[fl] |= (1u << sl);
+}
+
+static void freelist_tlsf_block_remove(freelist_tlsf_control* control, freelist_tlsf_block* block)
+{
+	int fl;
+	int sl;
+	freelist_tlsf_mapping_insert(freelist_tlsf_block_size(block), &fl, &sl);
+	freelist_tlsf_remove_free_block(control, block, fl, sl);
+}
+
+static void freelist_tlsf_block_insert(freelist_tlsf_control* control, freelist_tlsf_block* block)
+{
+	int fl;
+	int sl;
+	freelist_tlsf_mapping_insert(freelist_tlsf_block_size(block), &fl, &sl);
+	freelist_tlsf_insert_free_block(control, block, fl, sl);
+}
+
+static int freelist_tlsf_block_can_split(freelist_tlsf_block* block, size_t size)
+{
+	return freelist_tlsf_block_size(block) >= sizeof(freelist_tlsf_block) + size;
+}
+
+/* Split block in two, the second one is returned marked as free. */
+static freelist_tlsf_block* freelist_tlsf_block_split(freelist_tlsf_block* block, size_t size)
+{
+	freelist_tlsf_block* remaining;
+	size_t remaining_size;
+	remaining = (freelist_tlsf_block*)freelist_offset_ptr(freelist_tlsf_block_to_ptr(block), size - FREELIST_TLSF_BLOCK_OVERHEAD);
+	remaining_size = freelist_tlsf_block_size(block) - (size + FREELIST_TLSF_BLOCK_OVERHEAD);
+	assert(freelist_tlsf_block_to_ptr(remaining) == (void*)freelist_tlsf_align_up((size_t)(uintptr_t)freelist_tlsf_block_to_ptr(remaining), FREELIST_TLSF_ALIGN_SIZE) && "Remaining block not aligned properly");
+	assert(freelist_tlsf_block_size(block) == remaining_size + size + FREELIST_TLSF_BLOCK_OVERHEAD);
+
+	remaining->size = 0;
+	freelist_tlsf_block_set_size(remaining, remaining_size);
+	assert(freelist_tlsf_block_size(remaining) >= FREELIST_TLSF_BLOCK_SIZE_MIN && "Block split with invalid size");
+
+	freelist_tlsf_block_set_size(block, size);
+	freelist_tlsf_block_mark_as_free(remaining);
+
+	return remaining;
+}
+
+/* Absorb a free block into the previous one. */
+static freelist_tlsf_block* freelist_tlsf_block_absorb(freelist_tlsf_block* prev, freelist_tlsf_block* block)
+{
+	assert(!freelist_tlsf_block_is_last(prev) && "Previous block can't be last");
+	prev->size += freelist_tlsf_block_size(block) + FREELIST_TLSF_BLOCK_OVERHEAD;
+	freelist_tlsf_block_link_next(prev);
+	return prev;
+}
+
+static freelist_tlsf_block* freelist_tlsf_block_merge_prev(freelist_tlsf_control* control, freelist_tlsf_block* block)
+{
+	freelist_tlsf_block* prev;
+	if (freelist_tlsf_block_is_prev_free(block))
+	{
+		prev = block->prev_physical;
+		assert(prev && "Previous physical block can't be null");
+		assert(freelist_tlsf_block_is_free(prev) && "Previous block is not free though marked as such");
+		freelist_tlsf_block_remove(control, prev);
+		block = freelist_tlsf_block_absorb(prev, block);
+	}
+	return block;
+}
+
+static freelist_tlsf_block* freelist_tlsf_block_merge_next(freelist_tlsf_control* control, freelist_tlsf_block* block)
+{
+	freelist_tlsf_block* next;
+	next = freelist_tlsf_block_next(block);
+	if (freelist_tlsf_block_is_free(next))
+	{
+		assert(!freelist_tlsf_block_is_last(block) && "Previous block can't be last");
+		freelist_tlsf_block_remove(control, next);
+		block = freelist_tlsf_block_absorb(block, next);
+	}
+	return block;
+}
+
+/* Give back to the free lists the trailing part of a free block. */
+static void freelist_tlsf_block_trim_free(freelist_tlsf_control* control, freelist_tlsf_block* block, size_t size)
+{
+	freelist_tlsf_block* remaining;
+	assert(freelist_tlsf_block_is_free(block) && "Block must be free");
+	if (freelist_tlsf_block_can_split(block, size))
+	{
+		remaining = freelist_tlsf_block_split(block, size);
+		freelist_tlsf_block_link_next(block);
+		freelist_tlsf_block_set_prev_free(remaining);
+		freelist_tlsf_block_insert(control, remaining);
+	}
+}
+
+/* Give back to the free lists the leading part of a free block, the trailing part of size bytes is returned. */
+static freelist_tlsf_block* freelist_tlsf_block_trim_free_leading(freelist_tlsf_control* control, freelist_tlsf_block* block, size_t size)
+{
+	freelist_tlsf_block* remaining;
+	remaining = block;
+	if (freelist_tlsf_block_can_split(block, size))
+	{
+		remaining = freelist_tlsf_block_split(block, size - FREELIST_TLSF_BLOCK_OVERHEAD);
+		freelist_tlsf_block_set_prev_free(remaining);
+		freelist_tlsf_block_link_next(block);
+		freelist_tlsf_block_insert(control, block);
+	}
+	return remaining;
+}
+
+/* Give back to the free lists the trailing part of a used block, merged with the next block if that is free. */
+static void freelist_tlsf_block_trim_used(freelist_tlsf_control* control, freelist_tlsf_block* block, size_t size)
+{
+	freelist_tlsf_block* remaining;
+	assert(!freelist_tlsf_block_is_free(block) && "Block must be used");
+	if (freelist_tlsf_block_can_split(block, size))
+	{
+		remaining = freelist_tlsf_block_split(block, size);
+		freelist_tlsf_block_set_prev_used(remaining);
+		remaining = freelist_tlsf_block_merge_next(control, remaining);
+		freelist_tlsf_block_insert(control, remaining);
+	}
+}
+
+/* Round the request to the alignment and to the minimum block, 0 if too big. */
+static size_t freelist_tlsf_adjust_request_size(size_t size)
+{
+	size_t aligned;
+	if (size == 0 || size >= FREELIST_TLSF_BLOCK_SIZE_MAX)
+		return 0;
+
+	aligned = freelist_tlsf_align_up(size, FREELIST_TLSF_ALIGN_SIZE);
+	return aligned < FREELIST_TLSF_BLOCK_SIZE_MIN ? FREELIST_TLSF_BLOCK_SIZE_MIN : aligned;
+}
+
+static freelist_tlsf_block* freelist_tlsf_locate_free(freelist_tlsf_control* control, size_t size)
+{
+	int fl;
+	int sl;
+	freelist_tlsf_block* block;
+
+	if (!size)
+		return NULL;
+
+	block = NULL;
+	freelist_tlsf_mapping_search(size, &fl, &sl);
+	if (fl < FREELIST_TLSF_FL_INDEX_COUNT)
+		block = freelist_tlsf_search_suitable_block(control, &fl, &sl);
+
+	if (!block || block == &control->block_null)
+	{
+		// The rounded search skips the class of the request, blocks there can still be big enough
+		freelist_tlsf_mapping_insert(size, &fl, &sl);
+		if (fl >= FREELIST_TLSF_FL_INDEX_COUNT)
+			return NULL;
+
+		block = control->blocks[fl][sl];
+		while (block != &control->block_null && freelist_tlsf_block_size(block) < size)
+		{
+			block = block->next_free;
+		}
+		if (block == &control->block_null)
+			return NULL;
+	}
+
+	assert(freelist_tlsf_block_size(block) >= size);
+	freelist_tlsf_remove_free_block(control, block, fl, sl);
+	return block;
+}
+
+static freelist_tlsf_block* freelist_tlsf_first_block(freelist_tlsf_control* control)
+{
+	void* pool;
+	pool = freelist_offset_ptr(control, freelist_tlsf_align_up(sizeof(freelist_tlsf_control), FREELIST_TLSF_ALIGN_SIZE));
+	return (freelist_tlsf_block*)freelist_subtract_ptr(pool, FREELIST_TLSF_BLOCK_OVERHEAD);
+}
+
+static void* freelist_tlsf_malloc(freelist* const allocator, size_t bytes)
+{
+	freelist_tlsf_block* block;
+	size_t size;
+
+	size = freelist_tlsf_adjust_request_size(bytes);
+	block = freelist_tlsf_locate_free(allocator->tlsf, size);
+	if (!block)
+	{
+		//Requesting more memory than available
+		return NULL;
+	}
+
+	freelist_tlsf_block_trim_free(allocator->tlsf, block, size);
+	freelist_tlsf_block_mark_as_used(block);
+	return freelist_tlsf_block_to_ptr(block);
+}
+
+/* Finds a block with room for the alignment padding, the padding is split off as a free block. */
+static void* freelist_tlsf_malloc_aligned(freelist* const allocator, size_t bytes, size_t alignment)
+{
+	freelist_tlsf_block* block;
+	size_t size;
+	size_t gap;
+	uintptr_t ptr;
+	uintptr_t aligned;
+	// A leading gap must hold a free block
+	const size_t gap_minimum = sizeof(freelist_tlsf_block);
+
+	size = freelist_tlsf_adjust_request_size(bytes);
+	if (!size || alignment > FREELIST_TLSF_BLOCK_SIZE_MAX - size - gap_minimum)
+		return NULL;
+
+	block = freelist_tlsf_locate_free(allocator->tlsf, freelist_tlsf_adjust_request_size(size + alignment + gap_minimum));
+	if (!block)
+	{
+		//Requesting more memory than available
+		return NULL;
+	}
+
+	ptr = (uintptr_t)freelist_tlsf_block_to_ptr(block);
+	aligned = (ptr + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	gap = (size_t)(aligned - ptr);
+	if (gap && gap < gap_minimum)
+	{
+		// Too small for a free block, move to the next aligned address
+		aligned = (ptr + gap_minimum + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+		gap = (size_t)(aligned - ptr);
+	}
+	if (gap)
+		block = freelist_tlsf_block_trim_free_leading(allocator->tlsf, block, gap);
+	assert((uintptr_t)freelist_tlsf_block_to_ptr(block) == aligned);
+
+	freelist_tlsf_block_trim_free(allocator->tlsf, block, size);
+	freelist_tlsf_block_mark_as_used(block);
+	return freelist_tlsf_block_to_ptr(block);
+}
+
+static void freelist_tlsf_free(freelist* const allocator, void* ptr)
+{
+	freelist_tlsf_block* block;
+
+	block = freelist_tlsf_ptr_to_block(ptr);
+	assert(!freelist_tlsf_block_is_free(block) && "Block already marked as free, pointer was already released");
+
+	freelist_tlsf_block_mark_as_free(block);
+	block = freelist_tlsf_block_merge_prev(allocator->tlsf, block);
+	block = freelist_tlsf_block_merge_next(allocator->tlsf, block);
+	freelist_tlsf_block_insert(allocator->tlsf, block);
+}
+
+/* Shrinks or grows into the next physical block when it's free, moves otherwise. */
+static void* freelist_tlsf_realloc(freelist* const allocator, void* ptr, size_t bytes)
+{
+	freelist_tlsf_block* block;
+	freelist_tlsf_block* next;
+	size_t current;
+	size_t size;
+	void* moved;
+
+	block = freelist_tlsf_ptr_to_block(ptr);
+	assert(!freelist_tlsf_block_is_free(block) && "Pointer was already released");
+	current = freelist_tlsf_block_size(block);
+	size = freelist_tlsf_adjust_request_size(bytes);
+	if (!size)
+		return NULL;
+
+	if (size > current)
+	{
+		next = freelist_tlsf_block_next(block);
+		if (!freelist_tlsf_block_is_free(next) || current + freelist_tlsf_block_size(next) + FREELIST_TLSF_BLOCK_OVERHEAD < size)
+		{
+			moved = freelist_tlsf_malloc(allocator, bytes);
+			if (!moved)
+				return NULL;
+			memcpy(moved, ptr, current);
+			freelist_tlsf_free(allocator, ptr);
+			return moved;
+		}
+		freelist_tlsf_block_merge_next(allocator->tlsf, block);
+		freelist_tlsf_block_mark_as_used(block);
+	}
+
+	freelist_tlsf_block_trim_used(allocator->tlsf, block, size);
+	return ptr;
+}
+
+/* Walk all the physical blocks and the segregated lists. When error occurred returns 0, when nothing wrong is detected 1. */
+static int verify_tlsf(freelist* const allocator)
+{
+	freelist_tlsf_control* control;
+	freelist_tlsf_block* block;
+	freelist_tlsf_block* prev;
+	size_t blocks_sum;
+	int prev_free;
+	int fl;
+	int sl;
+
+	control = allocator->tlsf;
+	blocks_sum = 0;
+	prev_free = 0;
+	prev = NULL;
+
+	for (block = freelist_tlsf_first_block(control); !freelist_tlsf_block_is_last(block); block = freelist_tlsf_block_next(block))
+	{
+		// This could mean that externally an allocation has written outside the requested bytes and corrupted internal metadata.
+		if (freelist_tlsf_block_size(block) > allocator->buffer_size && "Single block can't be bigger than the whole buffer!")
+			return 0;
+		if (freelist_tlsf_block_size(block) < FREELIST_TLSF_BLOCK_SIZE_MIN && "Block is smaller than the minimum!")
+			return 0;
+		if (freelist_tlsf_block_is_prev_free(block) != prev_free && "Previous free flag doesn't match!")
+			return 0;
+		if (prev_free && freelist_tlsf_block_is_free(block) && "Two consecutive free blocks must be merged!")
+			return 0;
+		if (prev_free && block->prev_physical != prev && "Boundary tag doesn't point to the previous block!")
+			return 0;
+
+		if (freelist_tlsf_block_is_free(block))
+		{
+			freelist_tlsf_mapping_insert(freelist_tlsf_block_size(block), &fl, &sl);
+			if (!(control->sl_bitmap[fl] & (1u << sl)) && "Free block class is not marked in the bitmap!")
+				return 0;
+		}
+
+		blocks_sum += freelist_tlsf_block_size(block) + FREELIST_TLSF_BLOCK_OVERHEAD;
+		if (blocks_sum > allocator->buffer_size)
+			return 0;
+
+		prev_free = freelist_tlsf_block_is_free(block);
+		prev = block;
+	}
+
+	// block is now the sentinel
+	if (freelist_tlsf_block_is_prev_free(block) != prev_free && "Sentinel previous free flag doesn't match!")
+		return 0;
+	if (freelist_tlsf_block_is_free(block) && "Sentinel must be used!")
+		return 0;
+	if (prev_free && block->prev_physical != prev && "Sentinel boundary tag doesn't point to the last block!")
+		return 0;
+
+	for (fl = 0; fl < FREELIST_TLSF_FL_INDEX_COUNT; fl++)
+	{
+		if (!(control->fl_bitmap & (1u << fl)) != !control->sl_bitmap[fl] && "First level bitmap doesn't match the second level!")
+			return 0;
+
+		for (sl = 0; sl < FREELIST_TLSF_SL_INDEX_COUNT; sl++)
+		{
+			int list_fl;
+			int list_sl;
+			block = control->blocks[fl][sl];
+			if (!(control->sl_bitmap[fl] & (1u << sl)) != (block == &control->block_null) && "Second level bitmap doesn't match the list!")
+				return 0;
+
+			while (block != &control->block_null)
+			{
+				if (!freelist_tlsf_block_is_free(block) && "Used block in the free list!")
+					return 0;
+				freelist_tlsf_mapping_insert(freelist_tlsf_block_size(block), &list_fl, &list_sl);
+				if ((list_fl != fl || list_sl != sl) && "Block is in the wrong list!")
+					return 0;
+				block = block->next_free;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
 
 size_t freelist_alloc_overhead(void) {
 	return sizeof(freelist_header);
@@ -163,6 +799,7 @@ void freelist_initialize(freelist_t* allocator, void* buffer, size_t poolSize) {
 	fl.buffer = buffer;
 	fl.buffer_size = poolSize;
 	fl.free_block = (freelist_block*)buffer;
+	fl.tlsf = NULL;
 	temp_block.next = NULL;
 	temp_block.block_size = poolSize;
 	pun_cpy(fl.free_block, freelist_block, &temp_block);
@@ -171,6 +808,75 @@ void freelist_initialize(freelist_t* allocator, void* buffer, size_t poolSize) {
 	verify(allocator, allocator->free_block)
 }
 
+size_t freelist_tlsf_overhead(void) {
+	return freelist_tlsf_align_up(sizeof(freelist_tlsf_control), FREELIST_TLSF_ALIGN_SIZE) + 2 * FREELIST_TLSF_BLOCK_OVERHEAD;
+}
+
+void freelist_initialize_tlsf(freelist_t* allocator, void* buffer, size_t poolSize) {
+	freelist fl;
+	freelist_tlsf_control* control;
+	freelist_tlsf_block* block;
+	freelist_tlsf_block* next;
+	size_t misalignment;
+	size_t pool_bytes;
+	int i;
+	int j;
+	assert(allocator != NULL);
+	assert(buffer != NULL);
+
+	// Control structure and blocks must be aligned, skip the unaligned start of the buffer
+	misalignment = freelist_tlsf_align_up((size_t)(uintptr_t)buffer, FREELIST_TLSF_ALIGN_SIZE) - (size_t)(uintptr_t)buffer;
+	assert(poolSize >= misalignment + freelist_tlsf_overhead() + FREELIST_TLSF_BLOCK_SIZE_MIN && "Memory size must be equal or greater than tlsf_overhead + min block");
+	if (poolSize < misalignment + freelist_tlsf_overhead() + FREELIST_TLSF_BLOCK_SIZE_MIN)
+	{
+		// Can't even hold the control structure, behave as an allocator without free blocks
+		fl.buffer = buffer;
+		fl.buffer_size = poolSize;
+		fl.free_block = NULL;
+		fl.tlsf = NULL;
+		pun_cpy(allocator, freelist, &fl);
+		return;
+	}
+
+	control = (freelist_tlsf_control*)freelist_offset_ptr(buffer, misalignment);
+	control->block_null.next_free = &control->block_null;
+	control->block_null.prev_free = &control->block_null;
+	control->fl_bitmap = 0;
+	for (i = 0; i < FREELIST_TLSF_FL_INDEX_COUNT; i++)
+	{
+		control->sl_bitmap[i] = 0;
+		for (j = 0; j < FREELIST_TLSF_SL_INDEX_COUNT; j++)
+		{
+			control->blocks[i][j] = &control->block_null;
+		}
+	}
+
+	fl.buffer = buffer;
+	fl.buffer_size = poolSize;
+	fl.free_block = NULL;
+	fl.tlsf = control;
+	pun_cpy(allocator, freelist, &fl);
+
+	// Whole pool is one free block followed by a zero sized used sentinel block
+	pool_bytes = freelist_tlsf_align_down(poolSize - misalignment - freelist_tlsf_overhead(), FREELIST_TLSF_ALIGN_SIZE);
+	if (pool_bytes >= FREELIST_TLSF_BLOCK_SIZE_MAX)
+		pool_bytes = FREELIST_TLSF_BLOCK_SIZE_MAX - FREELIST_TLSF_ALIGN_SIZE;
+
+	block = freelist_tlsf_first_block(control);
+	block->size = 0;
+	freelist_tlsf_block_set_size(block, pool_bytes);
+	freelist_tlsf_block_set_free(block);
+	freelist_tlsf_block_set_prev_used(block);
+	freelist_tlsf_block_insert(control, block);
+
+	next = freelist_tlsf_block_link_next(block);
+	next->size = 0;
+	freelist_tlsf_block_set_used(next);
+	freelist_tlsf_block_set_prev_free(next);
+
+	assert(verify_tlsf(allocator) == 1);
+}
+
 void* freelist_get_buffer(freelist_t* allocator)
 {
 	assert(allocator != NULL);
@@ -201,6 +907,9 @@ void* freelist_malloc(freelist_t* allocator, size_t bytes) {
 
 		alloc = (freelist*)allocator;
 
+	if (alloc->tlsf)
+		return freelist_tlsf_malloc(alloc, bytes);
+
 	assert(bytes >= freelist_min_alloc_block() && "Memory size must be equal or greater than min_alloc_block");
 	if (!alloc->free_block || alloc->free_block->block_size < bytes + freelist_alloc_overhead())
 	{
@@ -210,6 +919,10 @@ void* freelist_malloc(freelist_t* allocator, size_t bytes) {
 	assert(alloc->free_block != NULL && alloc->free_block->block_size > 0 && "All memory is being used");
 
 	if (alloc->free_block->block_size >= bytes + freelist_alloc_overhead()) {
+		// A remainder too small for a free block node would overwrite the next block, hand it out with the allocation
+		if (alloc->free_block->block_size - (bytes + freelist_alloc_overhead()) < sizeof(freelist_block))
+			bytes = alloc->free_block->block_size - freelist_alloc_overhead();
+
 		alloc->free_block->block_size -= bytes + freelist_alloc_overhead();
 		header.size = bytes;
 
@@ -251,6 +964,167 @@ void* freelist_malloc(freelist_t* allocator, size_t bytes) {
 	return NULL;
 }
 
+void* freelist_malloc_aligned(freelist_t* allocator, size_t bytes, size_t alignment) {
+	freelist_block* block;
+	freelist_block* next;
+	freelist_block* remaining;
+	freelist_header header;
+	uintptr_t start;
+	uintptr_t result;
+	size_t pad;
+	size_t remaining_size;
+	assert(allocator != NULL);
+	assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+	verify(allocator, allocator->free_block)
+
+	if (alignment <= 1)
+		return freelist_malloc(allocator, bytes < freelist_min_alloc_block() ? freelist_min_alloc_block() : bytes);
+
+	if (allocator->tlsf)
+	{
+		if (alignment <= FREELIST_TLSF_ALIGN_SIZE)
+			return freelist_tlsf_malloc(allocator, bytes);
+		return freelist_tlsf_malloc_aligned(allocator, bytes, alignment);
+	}
+
+	// Same as freelist_malloc, only the first free block is considered
+	block = allocator->free_block;
+	if (!block)
+		return NULL;
+	if (bytes < freelist_min_alloc_block())
+		bytes = freelist_min_alloc_block();
+
+	// The padding in front of the header becomes a free block, it must be big enough to hold one
+	start = (uintptr_t)block;
+	result = (start + freelist_alloc_overhead() + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	pad = (size_t)(result - freelist_alloc_overhead() - start);
+	if (pad && pad < sizeof(freelist_block))
+	{
+		result = (start + freelist_alloc_overhead() + sizeof(freelist_block) + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+		pad = (size_t)(result - freelist_alloc_overhead() - start);
+	}
+	if (pad > block->block_size || block->block_size - pad < bytes + freelist_alloc_overhead())
+	{
+		//Requesting more memory than available
+		return NULL;
+	}
+
+	// A remainder too small for a free block node goes with the allocation
+	remaining_size = block->block_size - pad - freelist_alloc_overhead() - bytes;
+	if (remaining_size < sizeof(freelist_block))
+	{
+		bytes += remaining_size;
+		remaining_size = 0;
+	}
+
+	// The remainder goes first, it's the block the next allocations can use
+	next = block->next;
+	if (pad)
+	{
+		block->block_size = pad;
+		block->next = next;
+		next = block;
+	}
+	if (remaining_size)
+	{
+		remaining = (freelist_block*)(result + bytes);
+		remaining->block_size = remaining_size;
+		remaining->next = next;
+		next = remaining;
+	}
+	allocator->free_block = next;
+
+	header.size = bytes;
+	memcpy((void*)(result - freelist_alloc_overhead()), &header, sizeof(freelist_header));
+
+	verify(allocator, allocator->free_block)
+	return (void*)result;
+}
+
+void* freelist_realloc(freelist_t* allocator, void* ptr, size_t bytes) {
+	freelist_block** link;
+	freelist_block* neighbour;
+	freelist_block temp_block;
+	freelist_header* header;
+	freelist_header tail_header;
+	size_t size;
+	size_t remaining_size;
+	void* end;
+	void* moved;
+	assert(allocator != NULL);
+
+	if (!ptr)
+		return freelist_malloc(allocator, bytes < freelist_min_alloc_block() ? freelist_min_alloc_block() : bytes);
+	if (!bytes)
+	{
+		freelist_free(allocator, ptr);
+		return NULL;
+	}
+	assert(freelist_range_check(allocator, ptr) && "Pointer must be inside the buffer range");
+
+	if (allocator->tlsf)
+		return freelist_tlsf_realloc(allocator, ptr, bytes);
+
+	verify(allocator, allocator->free_block)
+
+	// Word multiple so the free blocks split off stay aligned
+	if (bytes < freelist_min_alloc_block())
+		bytes = freelist_min_alloc_block();
+	bytes = (bytes + (sizeof(void*) - 1)) & ~(sizeof(void*) - 1);
+
+	header = (freelist_header*)freelist_subtract_ptr(ptr, freelist_alloc_overhead());
+	size = header->size;
+	assert(size <= allocator->buffer_size && "Header is corrupted!");
+
+	if (bytes <= size)
+	{
+		// The tail is released as an allocation of its own when it can hold a free block node
+		if (size - bytes >= sizeof(freelist_block))
+		{
+			header->size = bytes;
+			tail_header.size = size - bytes - freelist_alloc_overhead();
+			memcpy(freelist_offset_ptr(ptr, bytes), &tail_header, sizeof(freelist_header));
+			freelist_free(allocator, freelist_offset_ptr(ptr, bytes + freelist_alloc_overhead()));
+		}
+		return ptr;
+	}
+
+	// Grow only if the block right after the allocation is free, the list is not address ordered so walk it
+	end = freelist_offset_ptr(ptr, size);
+	link = &allocator->free_block;
+	while (*link && (void*)*link != end)
+		link = &(*link)->next;
+
+	if (*link && size + (*link)->block_size >= bytes)
+	{
+		neighbour = *link;
+		remaining_size = size + neighbour->block_size - bytes;
+		if (remaining_size < sizeof(freelist_block))
+		{
+			// Too small for a free block node, it goes with the allocation
+			bytes += remaining_size;
+			*link = neighbour->next;
+		}
+		else
+		{
+			temp_block.next = neighbour->next;
+			temp_block.block_size = remaining_size;
+			*link = (freelist_block*)freelist_offset_ptr(ptr, bytes);
+			pun_cpy(*link, freelist_block, &temp_block);
+		}
+		header->size = bytes;
+		verify(allocator, allocator->free_block)
+		return ptr;
+	}
+
+	moved = freelist_malloc(allocator, bytes);
+	if (!moved)
+		return NULL;
+	memcpy(moved, ptr, size);
+	freelist_free(allocator, ptr);
+	return moved;
+}
+
 int freelist_range_check(freelist_t* allocator, void* ptr) {
 	return ptr >= allocator->buffer && ptr < freelist_offset_ptr(allocator->buffer, allocator->buffer_size);
 }
@@ -267,6 +1141,11 @@ void freelist_free(freelist_t* allocator, void* ptr) {
 	// Do nothing if pointer is outside the buffer range"
 	if (freelist_range_check(allocator, ptr) > 0)
 	{
+		if (allocator->tlsf)
+		{
+			freelist_tlsf_free(allocator, ptr);
+			return;
+		}
 
 		verify(allocator, allocator->free_block)
 
@@ -295,6 +1174,12 @@ size_t freelist_get_allocation_size(freelist_t* allocator, void* ptr)
 	if (!ptr)
 		return 0;
 
+	if (allocator->tlsf)
+	{
+		assert(!freelist_tlsf_block_is_free(freelist_tlsf_ptr_to_block(ptr)) && "Pointer was already released");
+		return freelist_tlsf_block_size(freelist_tlsf_ptr_to_block(ptr));
+	}
+
 #ifdef _DEBUG
 	assert_ptr_in_free_block(allocator, ptr);
 #endif
@@ -307,6 +1192,8 @@ size_t freelist_get_allocation_size(freelist_t* allocator, void* ptr)
 
 int freelist_verify_corruption(freelist_t* allocator)
 {
+	if (allocator->tlsf)
+		return verify_tlsf(allocator);
 	return verify_freelist(allocator, allocator->free_block);
 }
 
@@ -8,7 +8,12 @@
 // DESCRIPTION: A freelist is a pool allocator that internally tracks free 
 // space using a linked list where each allocation has some little overhead, 
 // and input buffer must be allocated externally.
-// It uses first fit algorithm and does not take into account alignment.
+// It uses first fit algorithm, freelist_malloc does not take into account alignment while
+// freelist_malloc_aligned returns the padding to the free list.
+// Optionally it can be initialized in TLSF (two level segregated fit) mode, where free
+// blocks are kept in segregated lists indexed by two levels of bitmaps and each block
+// has in-band boundary tags, so both malloc and free are O(1) and any block that fits is found
+// (only when no bigger class has a block, the list of the request own class is walked).
 // 
 // LICENSE: BSD-2
 // Copyright (c) 2025, Kirichenko Stanislav
@@ -38,6 +43,9 @@
 //
 // MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
 // 11 JAN 2025 ~ Kirichenko Stanislav ~ First version.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ TLSF mode.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Aligned allocations.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Realloc in place.
 //
 // USAGE ////////////////////////////////////////////////////////////////////////////////////
 //
@@ -64,23 +72,45 @@
 // freelist_reset(&allocator);
 // free(mem);
 //
+// TLSF mode needs a control structure at the beginning of the buffer
+// size = 4096 + freelist_tlsf_overhead();
+// mem = malloc(size);
+// freelist_initialize_tlsf(&allocator, mem, size);
+// element = freelist_malloc(&allocator, 16);
+// freelist_free(&allocator, element);
+//
+// SIMD data, the padding is not lost
+// element = freelist_malloc_aligned(&allocator, 64, 32);
+// freelist_free(&allocator, element);
+//
+// Resize, the block after the allocation is used when free
+// element = freelist_realloc(&allocator, element, 128);
+// freelist_free(&allocator, element);
+//
 // //////////////////////////////////////////////////////////////////////////////////////////
 
 
 #ifndef INCLUDED_FREELIST
 #define INCLUDED_FREELIST
 
+#include <stddef.h>
+
 /* Defines a starting point of a block with a size. */
 typedef struct freelist_block {
 	struct freelist_block* next;
 	size_t block_size;
 } freelist_block;
 
-/* Defines the freelist allocator. free_block is a linked list of free blocks or null if there aren't free blocks. */
+/* TLSF control structure, lives at the beginning of the buffer. */
+struct freelist_tlsf_control;
+
+/* Defines the freelist allocator. free_block is a linked list of free blocks or null if there aren't free blocks.
+   tlsf is null unless the allocator was initialized in TLSF mode, in that case free_block is unused. */
 typedef struct {
 	void* buffer;
 	size_t buffer_size;
 	freelist_block* free_block;
+	struct freelist_tlsf_control* tlsf;
 } freelist;
 
 #if defined(__cplusplus)
@@ -98,6 +128,12 @@ extern "C" {
 	/* Initialize the free list allocator. */
 	void freelist_initialize(freelist_t* allocator, void* buffer, size_t poolSize);
 
+	/* Bytes of the buffer used by the TLSF control structure, add it to the pool size. */
+	size_t freelist_tlsf_overhead(void);
+
+	/* Initialize the free list allocator in TLSF mode, malloc and free are O(1). */
+	void freelist_initialize_tlsf(freelist_t* allocator, void* buffer, size_t poolSize);
+
 	/* Returns the memory buffer. */
 	void* freelist_get_buffer(freelist_t* allocator);
 
@@ -107,10 +143,19 @@ extern "C" {
 	/* Allocates memory from the allocator if has any. */
 	void* freelist_malloc(freelist_t* allocator, size_t bytes);
 
+	/* Allocates memory aligned to alignment, a power of two. The padding in front of the allocation is split off as
+	   a free block, freelist_free releases the allocation as any other. */
+	void* freelist_malloc_aligned(freelist_t* allocator, size_t bytes, size_t alignment);
+
 	/* Release memory back to the allocator. */
 	void freelist_free(freelist_t* allocator, void* ptr);
 
-	/* Returns the size requested for the allocation of the ptr. */
+	/* Resizes an allocation, in place when shrinking or when the block right after it is free and big enough, otherwise
+	   moves it with freelist_malloc. ptr NULL behaves as freelist_malloc and bytes 0 as freelist_free.
+	   Returns NULL on failure, ptr is still valid then. */
+	void* freelist_realloc(freelist_t* allocator, void* ptr, size_t bytes);
+
+	/* Returns the size requested for the allocation of the ptr, in TLSF mode the usable size which can be bigger. */
 	size_t freelist_get_allocation_size(freelist_t* allocator, void* ptr);
 
 	/* Check if a pointer is in buffer range. */
@@ -41,6 +41,33 @@
 #include <string.h>
 #include <stdbool.h>
 
+/* Default backing of the gpalloc_heap regions. */
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+#if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#define GPALLOC_HEAP_MMAP 1
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#else
+#define GPALLOC_HEAP_MMAP 0
+#endif
+
+/* Lanes of the compact table first fit search. */
+#if GPALLOC_COMPACT_TABLE && !defined(GPALLOC_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define GPALLOC_SIMD_LANES 8
+#elif GPALLOC_COMPACT_TABLE && !defined(GPALLOC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define GPALLOC_SIMD_LANES 4
+#else
+#define GPALLOC_SIMD_LANES 1
+#endif
+#if GPALLOC_SIMD_LANES > 1 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #pragma region Private
 
 // Punning void* for c and c++
@@ -80,48 +107,214 @@ void* gpalloc_align(void* ptr, const size_t alignment) {
 	return NULL;  // Alignment must be a power of two
 }
 
-inline size_t gpalloc_max(const size_t a, const size_t b) {
+static size_t gpalloc_max(const size_t a, const size_t b) {
 	return (a > b) ? a : b;
 }
 
+#pragma region Address map
+
+/* Page of the address map that contains the address. */
+static size_t gpalloc_map_page(const gpalloc_t* allocator, const uintptr_t address)
+{
+	return (size_t)(address - (uintptr_t)allocator->buffer) >> allocator->address_map_shift;
+}
+
+/* Fenwick tree update, the number of blocks starting in the page changes by delta. */
+static void gpalloc_map_add(gpalloc_t* allocator, const size_t page, const uint32_t delta)
+{
+	uint32_t* const map = allocator->address_map;
+	const size_t pages = allocator->address_map_pages;
+	size_t i;
+	for (i = page + 1; i <= pages; i += i & (~i + 1))
+		map[i] += delta;
+}
+
+/* Number of blocks starting before the page, which is the index of the first block at or after the page start. */
+static size_t gpalloc_map_prefix(const gpalloc_t* allocator, const size_t page)
+{
+	size_t count = 0;
+	size_t i;
+	for (i = page; i > 0; i -= i & (~i + 1))
+		count += allocator->address_map[i];
+	return count;
+}
+
+/* A block starting at address appears (delta 1) or disappears (delta -1). */
+static void gpalloc_map_count(gpalloc_t* allocator, const uintptr_t address, const uint32_t delta)
+{
+	if (allocator->address_map != NULL)
+		gpalloc_map_add(allocator, gpalloc_map_page(allocator, address), delta);
+}
+
+/* A block start moves from one address to another, nothing changes while it stays in its page. */
+static void gpalloc_map_move(gpalloc_t* allocator, const uintptr_t from, const uintptr_t to)
+{
+	if (allocator->address_map == NULL)
+		return;
+	const size_t from_page = gpalloc_map_page(allocator, from);
+	const size_t to_page = gpalloc_map_page(allocator, to);
+	if (from_page != to_page)
+	{
+		gpalloc_map_add(allocator, from_page, (uint32_t)-1);
+		gpalloc_map_add(allocator, to_page, 1u);
+	}
+}
+
+#pragma endregion
+
+#if GPALLOC_COMPACT_TABLE
+
+/* Words of the used bitmap for capacity blocks. */
+static size_t gpalloc_used_words(const size_t capacity)
+{
+	return (capacity + 63) / 64;
+}
+
+static gpalloc_allocation gpalloc_block_get(const gpalloc_t* allocator, const size_t index)
+{
+	gpalloc_allocation block;
+	block.address = gpalloc_offset_ptr(allocator->buffer, allocator->block_offsets[index]);
+	block.size = allocator->block_sizes[index];
+	block.used = (size_t)(allocator->block_used[index / 64] >> (index % 64)) & 1u;
+	return block;
+}
+
+/* Writes the block without touching the address map, for slots that don't hold a block yet. */
+static void gpalloc_block_store(gpalloc_t* allocator, const size_t index, const gpalloc_allocation block)
+{
+	const uint64_t bit = (uint64_t)1 << (index % 64);
+	assert(block.size <= UINT32_MAX && "Compact table blocks must be smaller than 4 GiB!");
+	allocator->block_offsets[index] = (uint32_t)gpalloc_ptr_diff(allocator->buffer, block.address);
+	allocator->block_sizes[index] = (uint32_t)block.size;
+	if (block.used)
+		allocator->block_used[index / 64] |= bit;
+	else
+		allocator->block_used[index / 64] &= ~bit;
+}
+
+static uintptr_t gpalloc_block_address(const gpalloc_t* allocator, const size_t index)
+{
+	return (uintptr_t)allocator->buffer + allocator->block_offsets[index];
+}
+
+/* Bytes of metadata of the table. */
+static size_t gpalloc_table_bytes(const gpalloc_t* allocator)
+{
+	return allocator->allocation_array_capacity * 2 * sizeof(uint32_t) + gpalloc_used_words(allocator->allocation_array_capacity) * sizeof(uint64_t);
+}
+
+void gpalloc_clear_out_of_size(gpalloc_t* allocator)
+{
+	const size_t size = allocator->allocation_array_size;
+	const size_t capacity = allocator->allocation_array_capacity;
+	size_t word;
+	memset(allocator->block_offsets + size, 0, sizeof(uint32_t) * (capacity - size));
+	memset(allocator->block_sizes + size, 0, sizeof(uint32_t) * (capacity - size));
+	for (word = size / 64; word < gpalloc_used_words(capacity); word++)
+		allocator->block_used[word] &= word == size / 64 ? (((uint64_t)1 << (size % 64)) - 1) : 0;
+}
+
+#else
+
+static gpalloc_allocation gpalloc_block_get(const gpalloc_t* allocator, const size_t index)
+{
+	return allocator->allocation_array[index];
+}
+
+/* Writes the block without touching the address map, for slots that don't hold a block yet. */
+static void gpalloc_block_store(gpalloc_t* allocator, const size_t index, const gpalloc_allocation block)
+{
+	pun_cpy((allocator->allocation_array + index), gpalloc_allocation, &block);
+}
+
+static uintptr_t gpalloc_block_address(const gpalloc_t* allocator, const size_t index)
+{
+	return (uintptr_t)allocator->allocation_array[index].address;
+}
+
+/* Bytes of metadata of the table. */
+static size_t gpalloc_table_bytes(const gpalloc_t* allocator)
+{
+	return allocator->allocation_array_capacity * sizeof(gpalloc_allocation);
+}
+
 void gpalloc_clear_out_of_size(gpalloc_t* allocator)
 {
 	memset(allocator->allocation_array + allocator->allocation_array_size, 0, sizeof(gpalloc_allocation) * (allocator->allocation_array_capacity - allocator->allocation_array_size));
 }
 
-void gpalloc_check_for_duplicates(gpalloc_t* allocator)
+#endif
+
+/* Overwrites the block at index, the address map follows when its address changes. */
+static void gpalloc_block_set(gpalloc_t* allocator, const size_t index, const gpalloc_allocation block)
 {
-	size_t i;
-	for (i = 0; i < allocator->allocation_array_size; i++)
+	assert(index < allocator->allocation_array_size);
+	gpalloc_map_move(allocator, gpalloc_block_address(allocator, index), (uintptr_t)block.address);
+	gpalloc_block_store(allocator, index, block);
+}
+
+/* Validation, see GPALLOC_VALIDATION */
+#if GPALLOC_VALIDATION >= 1
+#define gpalloc_validate(condition) do { if (!(condition)) { assert(!"gpalloc validation failed: " #condition); abort(); } } while (0)
+#else
+#define gpalloc_validate(condition) ((void)0)
+#endif
+
+#if GPALLOC_VALIDATION >= 2
+#define gpalloc_validate_sweep(allocator) do { if (++(allocator)->validation_counter >= GPALLOC_VALIDATION_INTERVAL) { (allocator)->validation_counter = 0; gpalloc_validate(gpalloc_verify(allocator) == 1); } } while (0)
+#else
+#define gpalloc_validate_sweep(allocator) ((void)0)
+#endif
+
+/* All the metadata memory goes through here, the callback of the options or the C library. new_size 0 releases. */
+static void* gpalloc_metadata_realloc(gpalloc_t* allocator, void* ptr, const size_t old_size, const size_t new_size)
+{
+	if (allocator->options.metadata_realloc != NULL)
+		return allocator->options.metadata_realloc(allocator->options.metadata_user, ptr, old_size, new_size);
+	if (new_size == 0)
 	{
-		size_t j;
-		for (j = 0; j < allocator->allocation_array_size; j++)
-		{
-			if (i == j)
-				continue;
-			gpalloc_allocation* a = allocator->allocation_array + i;
-			gpalloc_allocation* b = allocator->allocation_array + j;
-			assert(a->address != b->address && "Must not exists two elements with same address!");
-		}
+		free(ptr);
+		return NULL;
 	}
+	return realloc(ptr, new_size);
 }
 
-void gpalloc_grow_array(gpalloc_t* allocator, const size_t new_capacity)
+/* Returns false when out of memory, the array is left untouched. */
+bool gpalloc_grow_array(gpalloc_t* allocator, const size_t new_capacity)
 {
 	if (new_capacity > allocator->allocation_array_capacity)
 	{
-		allocator->allocation_array_capacity = new_capacity;
-		if (allocator->allocation_array == NULL)
-		{
-			allocator->allocation_array = (gpalloc_allocation*)malloc(allocator->allocation_array_capacity * sizeof(gpalloc_allocation));
-			gpalloc_clear_out_of_size(allocator);
-		}
-		else
-		{
-			allocator->allocation_array = (gpalloc_allocation*)realloc((void*)allocator->allocation_array, allocator->allocation_array_capacity * sizeof(gpalloc_allocation));
-			gpalloc_clear_out_of_size(allocator);
-		}
+		// Grow geometrically so inserts are amortized O(1) reallocations
+		const size_t capacity = gpalloc_max(new_capacity, allocator->allocation_array_capacity * 2);
+#if GPALLOC_COMPACT_TABLE
+		// Each array keeps what it got, the capacity grows only when all of them did
+		const size_t old_capacity = allocator->allocation_array_capacity;
+		uint32_t* offsets = (uint32_t*)gpalloc_metadata_realloc(allocator, (void*)allocator->block_offsets, old_capacity * sizeof(uint32_t), capacity * sizeof(uint32_t));
+		if (offsets == NULL)
+			return false;
+		allocator->block_offsets = offsets;
+
+		uint32_t* sizes = (uint32_t*)gpalloc_metadata_realloc(allocator, (void*)allocator->block_sizes, old_capacity * sizeof(uint32_t), capacity * sizeof(uint32_t));
+		if (sizes == NULL)
+			return false;
+		allocator->block_sizes = sizes;
+
+		uint64_t* used = (uint64_t*)gpalloc_metadata_realloc(allocator, (void*)allocator->block_used, gpalloc_used_words(old_capacity) * sizeof(uint64_t), gpalloc_used_words(capacity) * sizeof(uint64_t));
+		if (used == NULL)
+			return false;
+		allocator->block_used = used;
+		memset(used + gpalloc_used_words(old_capacity), 0, (gpalloc_used_words(capacity) - gpalloc_used_words(old_capacity)) * sizeof(uint64_t));
+#else
+		gpalloc_allocation* array = (gpalloc_allocation*)gpalloc_metadata_realloc(allocator, (void*)allocator->allocation_array, allocator->allocation_array_capacity * sizeof(gpalloc_allocation), capacity * sizeof(gpalloc_allocation));
+		if (array == NULL)
+			return false;
+
+		allocator->allocation_array = array;
+#endif
+		allocator->allocation_array_capacity = capacity;
+		gpalloc_clear_out_of_size(allocator);
 	}
+	return true;
 }
 
 void gpalloc_emplace(gpalloc_t* allocator, gpalloc_allocation allocation)
@@ -129,28 +322,46 @@ void gpalloc_emplace(gpalloc_t* allocator, gpalloc_allocation allocation)
 	gpalloc_grow_array(allocator, ++allocator->allocation_array_size);
 	assert(allocator->allocation_array_size + 1 <= allocator->allocation_array_capacity);
 
-	pun_cpy((allocator->allocation_array + allocator->allocation_array_size - 1), gpalloc_allocation, &allocation);
+	gpalloc_validate(allocator->allocation_array_size == 1 || gpalloc_block_address(allocator, allocator->allocation_array_size - 2) < (uintptr_t)allocation.address);
 
-	gpalloc_check_for_duplicates(allocator);
+	gpalloc_block_store(allocator, allocator->allocation_array_size - 1, allocation);
+	gpalloc_map_count(allocator, (uintptr_t)allocation.address, 1u);
 }
 
 void gpalloc_insert(gpalloc_t* allocator, const size_t index, gpalloc_allocation allocation)
 {
-	allocator->allocation_array_size++;
-	if (allocator->allocation_array_size >= allocator->allocation_array_capacity)
-		gpalloc_grow_array(allocator, allocator->allocation_array_size);
-
-	size_t i;
-	for (i = allocator->allocation_array_size - 1; i > index; i--)
+	assert(index <= allocator->allocation_array_size);
+	// Neighbours must stay ordered, this also rules out duplicated addresses
+	gpalloc_validate(index == 0 || gpalloc_block_address(allocator, index - 1) < (uintptr_t)allocation.address);
+	gpalloc_validate(index == allocator->allocation_array_size || (uintptr_t)allocation.address < gpalloc_block_address(allocator, index));
+
+	const bool grown = gpalloc_grow_array(allocator, allocator->allocation_array_size + 1);
+	assert(grown && "Capacity must be reserved before inserting!");
+	((void)grown);
+
+	// Move all right from the index in one go
+#if GPALLOC_COMPACT_TABLE
+	const size_t tail = allocator->allocation_array_size - index;
+	memmove(allocator->block_offsets + index + 1, allocator->block_offsets + index, tail * sizeof(uint32_t));
+	memmove(allocator->block_sizes + index + 1, allocator->block_sizes + index, tail * sizeof(uint32_t));
 	{
-		// Move all right from the end
-		memmove(allocator->allocation_array + i, allocator->allocation_array + i - 1, sizeof(gpalloc_allocation));
+		// Shift the used bits from the index up by one, from the top word down
+		uint64_t* const bits = allocator->block_used;
+		const size_t first = index / 64;
+		const uint64_t low_mask = ((uint64_t)1 << (index % 64)) - 1;
+		size_t word;
+		for (word = allocator->allocation_array_size / 64; word > first; word--)
+			bits[word] = (bits[word] << 1) | (bits[word - 1] >> 63);
+		bits[first] = (bits[first] & low_mask) | ((bits[first] & ~low_mask) << 1);
 	}
+#else
+	memmove(allocator->allocation_array + index + 1, allocator->allocation_array + index, (allocator->allocation_array_size - index) * sizeof(gpalloc_allocation));
+#endif
+	allocator->allocation_array_size++;
 
 	// Copy element at index
-	pun_cpy((allocator->allocation_array + index), gpalloc_allocation, &allocation);
-
-	gpalloc_check_for_duplicates(allocator);
+	gpalloc_block_store(allocator, index, allocation);
+	gpalloc_map_count(allocator, (uintptr_t)allocation.address, 1u);
 }
 
 
@@ -159,15 +370,34 @@ void gpalloc_erase_at(gpalloc_t* allocator, const size_t index)
 	assert(index < allocator->allocation_array_size);
 	assert(allocator->allocation_array_size > 0);
 
+	gpalloc_map_count(allocator, gpalloc_block_address(allocator, index), (uint32_t)-1);
 	allocator->allocation_array_size--;
 
-	size_t i;
-	for (i = index; i <= allocator->allocation_array_size - 1; i++)
+	// Move all left from the index in one go
+#if GPALLOC_COMPACT_TABLE
+	const size_t tail = allocator->allocation_array_size - index;
+	memmove(allocator->block_offsets + index, allocator->block_offsets + index + 1, tail * sizeof(uint32_t));
+	memmove(allocator->block_sizes + index, allocator->block_sizes + index + 1, tail * sizeof(uint32_t));
+	allocator->block_offsets[allocator->allocation_array_size] = 0;
+	allocator->block_sizes[allocator->allocation_array_size] = 0;
 	{
-		// Move all left from the index
-		memmove(allocator->allocation_array + i, allocator->allocation_array + i + 1, sizeof(gpalloc_allocation));
+		// Shift the used bits above the index down by one, a zero comes in at the top
+		uint64_t* const bits = allocator->block_used;
+		const size_t first = index / 64;
+		const size_t last = allocator->allocation_array_size / 64;
+		const uint64_t low_mask = ((uint64_t)1 << (index % 64)) - 1;
+		size_t word;
+		bits[first] = (bits[first] & low_mask) | ((bits[first] >> 1) & ~low_mask);
+		for (word = first; word < last; word++)
+		{
+			bits[word] |= bits[word + 1] << 63;
+			bits[word + 1] >>= 1;
+		}
 	}
-	gpalloc_clear_out_of_size(allocator);
+#else
+	memmove(allocator->allocation_array + index, allocator->allocation_array + index + 1, (allocator->allocation_array_size - index) * sizeof(gpalloc_allocation));
+	memset((void*)(allocator->allocation_array + allocator->allocation_array_size), 0, sizeof(gpalloc_allocation));
+#endif
 }
 
 
@@ -175,25 +405,24 @@ void gpalloc_pop(gpalloc_t* allocator)
 {
 	if (allocator->allocation_array_size > 0)
 	{
+		gpalloc_map_count(allocator, gpalloc_block_address(allocator, allocator->allocation_array_size - 1), (uint32_t)-1);
 		allocator->allocation_array_size--;
 		gpalloc_clear_out_of_size(allocator);
 	}
 }
 
-size_t gpalloc_lower_bound(gpalloc_t* allocator, void* ptr)
+/* Binary search of the first block at or after ptr in [first, first + count). */
+static size_t gpalloc_lower_bound_in(const gpalloc_t* allocator, void* ptr, size_t first, size_t count)
 {
 	const uintptr_t address = (uintptr_t)ptr;
 
-	size_t count = allocator->allocation_array_size;
-	size_t first = 0;
 	while (0 < count)// divide and conquer, find half that contains answer
 	{
 
 		const size_t count2 = count / 2;
 		const size_t mid = first + count2;
 
-		const gpalloc_allocation* const allocation = allocator->allocation_array + mid;
-		const uintptr_t block_address = ((uintptr_t)allocation->address);
+		const uintptr_t block_address = gpalloc_block_address(allocator, mid);
 		if (block_address < (uintptr_t)address)//try top half
 		{
 			first = mid + 1;
@@ -207,160 +436,1842 @@ size_t gpalloc_lower_bound(gpalloc_t* allocator, void* ptr)
 	return first;
 }
 
-/* See if index-1 and index +1 can be merged with index */
-void gpalloc_coalescence(gpalloc_t* allocator, size_t index)
+/* Index of the first block at or after ptr. With the address map only the blocks starting in the page of ptr are
+   searched, the ones before the page are counted by the map in O(log pages). */
+size_t gpalloc_lower_bound(gpalloc_t* allocator, void* ptr)
+{
+	if (allocator->address_map != NULL && (uintptr_t)ptr >= (uintptr_t)allocator->buffer && (uintptr_t)ptr - (uintptr_t)allocator->buffer < allocator->buffer_size)
+	{
+		const size_t page = gpalloc_map_page(allocator, (uintptr_t)ptr);
+		const size_t first = gpalloc_map_prefix(allocator, page);
+		const size_t last = gpalloc_map_prefix(allocator, page + 1);
+		return gpalloc_lower_bound_in(allocator, ptr, first, last - first);
+	}
+	return gpalloc_lower_bound_in(allocator, ptr, 0, allocator->allocation_array_size);
+}
+
+#pragma region Free index
+
+#define GPALLOC_INDEX_NULL 0xFFFFFFFFu
+/* Max keys in a node, a node is a handful of cache lines. */
+#define GPALLOC_INDEX_ORDER 15
+/* Enough for any tree that fits in 32 bit node indices. */
+#define GPALLOC_INDEX_MAX_DEPTH 32
+
+typedef struct {
+	size_t size;
+	uintptr_t address;
+} gpalloc_index_key;
+
+/* Leaves hold the keys and are linked in order, internal nodes hold separators:
+   children[i] contains keys k where keys[i-1] <= k < keys[i].
+   Empty nodes are released immediately instead of merging underfull siblings, so all leaves stay at the same depth.
+   The price is that the node count and the height are bounded by the peak number of free blocks, not the current one:
+   after heavy churn leaves can be left with few keys, but never more nodes than when the free blocks were at their peak. */
+typedef struct gpalloc_index_node {
+	uint16_t leaf;
+	uint16_t count;
+	uint32_t prev;
+	uint32_t next;
+	gpalloc_index_key keys[GPALLOC_INDEX_ORDER];
+	uint32_t children[GPALLOC_INDEX_ORDER + 1];
+} gpalloc_index_node;
+
+static int gpalloc_index_key_less(const gpalloc_index_key a, const gpalloc_index_key b)
 {
+	return a.size < b.size || (a.size == b.size && a.address < b.address);
+}
 
-	/* Blocks must be contiguos to do this */
-	gpalloc_allocation* current = allocator->allocation_array + (index);
-	assert(current->used == false && "Must be free!");
+static gpalloc_index_key gpalloc_index_key_of(const gpalloc_allocation* allocation)
+{
+	gpalloc_index_key key = { .size = allocation->size, .address = (uintptr_t)allocation->address };
+	return key;
+}
 
-	// Try to merge with previous if has
-	if (index > 0)
+/* First key position not less than key. */
+static uint16_t gpalloc_index_node_lower_bound(const gpalloc_index_node* node, const gpalloc_index_key key)
+{
+	uint16_t first = 0;
+	uint16_t count = node->count;
+	while (0 < count)
 	{
-		gpalloc_allocation* previous = allocator->allocation_array + (index - 1);
-
-		if (!previous->used)
+		const uint16_t count2 = count / 2;
+		const uint16_t mid = first + count2;
+		if (gpalloc_index_key_less(node->keys[mid], key))
 		{
-			previous->size += current->size;
-			gpalloc_erase_at(allocator, index--);
-			current = allocator->allocation_array + (index);
+			first = mid + 1;
+			count -= count2 + 1;
+		}
+		else
+		{
+			count = count2;
 		}
 	}
-	// try to merge with next
-	if (index + 1 < allocator->allocation_array_size)
-	{
-		gpalloc_allocation* next = allocator->allocation_array + (index + 1);
+	return first;
+}
 
-		if (!next->used)
+/* First key position greater than key, it's the child to descend into. */
+static uint16_t gpalloc_index_node_upper_bound(const gpalloc_index_node* node, const gpalloc_index_key key)
+{
+	uint16_t first = 0;
+	uint16_t count = node->count;
+	while (0 < count)
+	{
+		const uint16_t count2 = count / 2;
+		const uint16_t mid = first + count2;
+		if (!gpalloc_index_key_less(key, node->keys[mid]))
 		{
-			current->size += next->size;
-			gpalloc_erase_at(allocator, index + 1);
+			first = mid + 1;
+			count -= count2 + 1;
+		}
+		else
+		{
+			count = count2;
 		}
 	}
+	return first;
 }
 
+/* Make room for n new nodes, so an update can't fail halfway. Returns false when out of memory. */
+static bool gpalloc_index_reserve(gpalloc_t* allocator, const uint32_t n)
+{
+	gpalloc_free_index* const index = &allocator->free_index;
+	if (index->nodes_capacity - index->nodes_size >= n)
+		return true;
 
+	uint32_t new_capacity = index->nodes_capacity ? index->nodes_capacity * 2 : 4;
+	while (new_capacity - index->nodes_size < n)
+		new_capacity *= 2;
 
-void* gpalloc_malloc_first_fit_block(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+	gpalloc_index_node* new_nodes = (gpalloc_index_node*)gpalloc_metadata_realloc(allocator, (void*)index->nodes, index->nodes_capacity * sizeof(gpalloc_index_node), new_capacity * sizeof(gpalloc_index_node));
+	if (new_nodes == NULL)
+		return false;
+
+	index->nodes = new_nodes;
+	index->nodes_capacity = new_capacity;
+	return true;
+}
+
+/* Levels of the tree, 0 when empty. */
+static uint32_t gpalloc_index_height(const gpalloc_free_index* index)
 {
-	size_t i;
-	for (i = 0; i < allocator->allocation_array_size; i++)
+	uint32_t height = 0;
+	uint32_t current = index->root;
+	while (current != GPALLOC_INDEX_NULL)
 	{
-		gpalloc_allocation* block = allocator->allocation_array + i;
-		if (block->used)
-			continue;
+		height++;
+		current = index->nodes[current].leaf ? GPALLOC_INDEX_NULL : index->nodes[current].children[0];
+	}
+	return height;
+}
 
-		void* aligned_ptr = gpalloc_align(block->address, alignment);
-		const uintptr_t unaligned_block_end = (uintptr_t)gpalloc_offset_ptr(block->address, block->size);
-		const uintptr_t aligned_block_end = (uintptr_t)gpalloc_offset_ptr(aligned_ptr, bytes);
+/* Nodes must be reserved first with gpalloc_index_reserve. */
+static uint32_t gpalloc_index_new_node(gpalloc_free_index* index, const int leaf)
+{
+	uint32_t node;
+	if (index->free_node != GPALLOC_INDEX_NULL)
+	{
+		node = index->free_node;
+		index->free_node = index->nodes[node].next;
+	}
+	else
+	{
+		assert(index->nodes_size < index->nodes_capacity && "Nodes must be reserved before inserting!");
+		node = index->nodes_size++;
+	}
 
-		// If aligned block overflows the current block skip
-		if (aligned_block_end > unaligned_block_end)
-			continue;
+	gpalloc_index_node* const n = index->nodes + node;
+	n->leaf = (uint16_t)leaf;
+	n->count = 0;
+	n->prev = GPALLOC_INDEX_NULL;
+	n->next = GPALLOC_INDEX_NULL;
+	return node;
+}
+
+static void gpalloc_index_release_node(gpalloc_free_index* index, const uint32_t node)
+{
+	index->nodes[node].next = index->free_node;
+	index->free_node = node;
+}
 
-		const uintptr_t alignment_offset = gpalloc_ptr_diff(block->address, aligned_ptr);
+/* Insert separator key and its right child at pos in the internal node path[depth], splitting up to the root if full. */
+static void gpalloc_index_insert_in_parent(gpalloc_free_index* index, uint32_t* path, uint16_t* path_pos, int depth, gpalloc_index_key key, uint32_t right)
+{
+	while (depth >= 0)
+	{
+		gpalloc_index_node* node = index->nodes + path[depth];
+		const uint16_t pos = path_pos[depth];
 
-		// If already aligned then do this:
-		// Split block in two:
-		// First part is used
-		// Second part is free
-		if (alignment_offset == 0)
+		if (node->count < GPALLOC_INDEX_ORDER)
 		{
-			// Second free block
-			gpalloc_allocation free_block = { .address = (void*)aligned_block_end, .size = block->size - bytes, .used = false };
+			memmove(node->keys + pos + 1, node->keys + pos, (node->count - pos) * sizeof(gpalloc_index_key));
+			memmove(node->children + pos + 2, node->children + pos + 1, (node->count - pos) * sizeof(uint32_t));
+			node->keys[pos] = key;
+			node->children[pos + 1] = right;
+			node->count++;
+			return;
+		}
 
-			// First used block
-			{
-				block->size = bytes;
-				block->used = true;
-			}
+		// Full, split the internal node and push the middle key up
+		gpalloc_index_key keys[GPALLOC_INDEX_ORDER + 1];
+		uint32_t children[GPALLOC_INDEX_ORDER + 2];
+		memcpy(keys, node->keys, pos * sizeof(gpalloc_index_key));
+		keys[pos] = key;
+		memcpy(keys + pos + 1, node->keys + pos, (GPALLOC_INDEX_ORDER - pos) * sizeof(gpalloc_index_key));
+		memcpy(children, node->children, (pos + 1) * sizeof(uint32_t));
+		children[pos + 1] = right;
+		memcpy(children + pos + 2, node->children + pos + 1, (GPALLOC_INDEX_ORDER - pos) * sizeof(uint32_t));
+
+		const uint32_t sibling = gpalloc_index_new_node(index, false);
+		node = index->nodes + path[depth];
+		gpalloc_index_node* const sibling_node = index->nodes + sibling;
+
+		const uint16_t left_count = (GPALLOC_INDEX_ORDER + 1) / 2;
+		const uint16_t right_count = GPALLOC_INDEX_ORDER - left_count;
+		memcpy(node->keys, keys, left_count * sizeof(gpalloc_index_key));
+		memcpy(node->children, children, (left_count + 1) * sizeof(uint32_t));
+		node->count = left_count;
+		memcpy(sibling_node->keys, keys + left_count + 1, right_count * sizeof(gpalloc_index_key));
+		memcpy(sibling_node->children, children + left_count + 1, (right_count + 1) * sizeof(uint32_t));
+		sibling_node->count = right_count;
+
+		key = keys[left_count];
+		right = sibling;
+		depth--;
+	}
 
-			if (free_block.size > 0)
-				gpalloc_insert(allocator, i + 1, free_block);
+	// Root was split, grow the tree by one level
+	const uint32_t root = gpalloc_index_new_node(index, false);
+	gpalloc_index_node* const root_node = index->nodes + root;
+	root_node->keys[0] = key;
+	root_node->children[0] = index->root;
+	root_node->children[1] = right;
+	root_node->count = 1;
+	index->root = root;
+}
 
-			return aligned_ptr;
-		}
+static void gpalloc_index_insert(gpalloc_free_index* index, const gpalloc_index_key key)
+{
+	if (index->root == GPALLOC_INDEX_NULL)
+	{
+		index->root = gpalloc_index_new_node(index, true);
+	}
+
+	uint32_t path[GPALLOC_INDEX_MAX_DEPTH];
+	uint16_t path_pos[GPALLOC_INDEX_MAX_DEPTH];
+	int depth = 0;
+	uint32_t current = index->root;
+	while (!index->nodes[current].leaf)
+	{
+		assert(depth < GPALLOC_INDEX_MAX_DEPTH);
+		path[depth] = current;
+		path_pos[depth] = gpalloc_index_node_upper_bound(index->nodes + current, key);
+		current = index->nodes[current].children[path_pos[depth]];
+		depth++;
+	}
+
+	gpalloc_index_node* leaf = index->nodes + current;
+	const uint16_t pos = gpalloc_index_node_lower_bound(leaf, key);
+	assert((pos == leaf->count || gpalloc_index_key_less(key, leaf->keys[pos])) && "Must not exists two free blocks with same address!");
+	index->count++;
+
+	if (leaf->count < GPALLOC_INDEX_ORDER)
+	{
+		memmove(leaf->keys + pos + 1, leaf->keys + pos, (leaf->count - pos) * sizeof(gpalloc_index_key));
+		leaf->keys[pos] = key;
+		leaf->count++;
+		return;
+	}
+
+	// Full, split the leaf in two and link the new one after it
+	gpalloc_index_key keys[GPALLOC_INDEX_ORDER + 1];
+	memcpy(keys, leaf->keys, pos * sizeof(gpalloc_index_key));
+	keys[pos] = key;
+	memcpy(keys + pos + 1, leaf->keys + pos, (GPALLOC_INDEX_ORDER - pos) * sizeof(gpalloc_index_key));
+
+	const uint32_t sibling = gpalloc_index_new_node(index, true);
+	leaf = index->nodes + current;
+	gpalloc_index_node* const sibling_leaf = index->nodes + sibling;
+
+	const uint16_t left_count = (GPALLOC_INDEX_ORDER + 1) / 2;
+	const uint16_t right_count = GPALLOC_INDEX_ORDER + 1 - left_count;
+	memcpy(leaf->keys, keys, left_count * sizeof(gpalloc_index_key));
+	leaf->count = left_count;
+	memcpy(sibling_leaf->keys, keys + left_count, right_count * sizeof(gpalloc_index_key));
+	sibling_leaf->count = right_count;
+
+	sibling_leaf->prev = current;
+	sibling_leaf->next = leaf->next;
+	if (leaf->next != GPALLOC_INDEX_NULL)
+		index->nodes[leaf->next].prev = sibling;
+	leaf->next = sibling;
+
+	gpalloc_index_insert_in_parent(index, path, path_pos, depth - 1, sibling_leaf->keys[0], sibling);
+}
 
-		// Allocation is not at alignment requirement
-		// Must split into three blocks: | free | used | free |
-		const size_t original_block_size = block->size;
-		const size_t third_block_size = original_block_size - bytes - alignment_offset;
-		gpalloc_allocation third_block = { .address = (void*)aligned_block_end, .size = third_block_size, .used = false };
+static void gpalloc_index_erase(gpalloc_free_index* index, const gpalloc_index_key key)
+{
+	assert(index->root != GPALLOC_INDEX_NULL && "Index must not be empty!");
+
+	uint32_t path[GPALLOC_INDEX_MAX_DEPTH];
+	uint16_t path_pos[GPALLOC_INDEX_MAX_DEPTH];
+	int depth = 0;
+	uint32_t current = index->root;
+	while (!index->nodes[current].leaf)
+	{
+		assert(depth < GPALLOC_INDEX_MAX_DEPTH);
+		path[depth] = current;
+		path_pos[depth] = gpalloc_index_node_upper_bound(index->nodes + current, key);
+		current = index->nodes[current].children[path_pos[depth]];
+		depth++;
+	}
 
-		gpalloc_allocation second_block = { .address = aligned_ptr, .size = bytes, .used = true };
-		assert(second_block.size > 0);
+	gpalloc_index_node* const leaf = index->nodes + current;
+	const uint16_t pos = gpalloc_index_node_lower_bound(leaf, key);
+	assert(pos < leaf->count && !gpalloc_index_key_less(key, leaf->keys[pos]) && "Free block must be in the index!");
+	memmove(leaf->keys + pos, leaf->keys + pos + 1, (leaf->count - pos - 1) * sizeof(gpalloc_index_key));
+	leaf->count--;
+	index->count--;
 
-		// first block
-		block->size = original_block_size - (third_block_size + second_block.size);
-		assert(block->size > 0);
-		assert(block->size + second_block.size + third_block_size == original_block_size);
+	if (leaf->count > 0)
+		return;
 
-		if (third_block_size > 0)
+	// Unlink the empty leaf and remove it from the parents, releasing the parents that become empty
+	if (leaf->prev != GPALLOC_INDEX_NULL)
+		index->nodes[leaf->prev].next = leaf->next;
+	if (leaf->next != GPALLOC_INDEX_NULL)
+		index->nodes[leaf->next].prev = leaf->prev;
+
+	uint32_t empty = current;
+	while (depth > 0)
+	{
+		gpalloc_index_release_node(index, empty);
+		depth--;
+
+		gpalloc_index_node* const parent = index->nodes + path[depth];
+		const uint16_t child = path_pos[depth];
+		if (parent->count == 0)
 		{
-			gpalloc_insert(allocator, i + 1, third_block);
+			// Parent had only this child
+			empty = path[depth];
+			continue;
 		}
-		gpalloc_insert(allocator, i + 1, second_block);
 
-		return aligned_ptr;
+		// Drop the child and the separator on its left, or on its right if it's the first child
+		const uint16_t key_pos = child > 0 ? child - 1 : 0;
+		memmove(parent->keys + key_pos, parent->keys + key_pos + 1, (parent->count - key_pos - 1) * sizeof(gpalloc_index_key));
+		memmove(parent->children + child, parent->children + child + 1, (parent->count - child) * sizeof(uint32_t));
+		parent->count--;
+		empty = GPALLOC_INDEX_NULL;
+		break;
 	}
 
-	return (void*)NULL;
+	if (empty != GPALLOC_INDEX_NULL)
+	{
+		// Whole tree is empty
+		gpalloc_index_release_node(index, empty);
+		index->root = GPALLOC_INDEX_NULL;
+		return;
+	}
+
+	// Shrink the root while it has a single child
+	while (!index->nodes[index->root].leaf && index->nodes[index->root].count == 0)
+	{
+		const uint32_t old_root = index->root;
+		index->root = index->nodes[old_root].children[0];
+		gpalloc_index_release_node(index, old_root);
+	}
 }
 
-#pragma endregion
+/* Position of the first key not less than key, node is GPALLOC_INDEX_NULL when there isn't any. */
+static void gpalloc_index_lower_bound(const gpalloc_free_index* index, const gpalloc_index_key key, uint32_t* node, uint16_t* pos)
+{
+	*node = GPALLOC_INDEX_NULL;
+	*pos = 0;
+	if (index->root == GPALLOC_INDEX_NULL)
+		return;
 
+	uint32_t current = index->root;
+	while (!index->nodes[current].leaf)
+	{
+		current = index->nodes[current].children[gpalloc_index_node_upper_bound(index->nodes + current, key)];
+	}
 
-void gpalloc_initialize(gpalloc_t* allocator, void* buffer, const size_t pool_size) {
-	assert(allocator != NULL);
-	assert(buffer != NULL);
-	assert(pool_size > 0 && "Memory size must be greater than 0");
+	const uint16_t leaf_pos = gpalloc_index_node_lower_bound(index->nodes + current, key);
+	if (leaf_pos < index->nodes[current].count)
+	{
+		*node = current;
+		*pos = leaf_pos;
+	}
+	else if (index->nodes[current].next != GPALLOC_INDEX_NULL)
+	{
+		*node = index->nodes[current].next;
+	}
+}
 
+/* Advance to the next key in order. */
+static void gpalloc_index_next(const gpalloc_free_index* index, uint32_t* node, uint16_t* pos)
+{
+	assert(*node != GPALLOC_INDEX_NULL);
+	if (++(*pos) >= index->nodes[*node].count)
 	{
-		// Initialize
-		gpalloc_t gpa = { .buffer = buffer, .buffer_size = pool_size, .allocation_array_size = 0, .allocation_array_capacity = 0 };
-		pun_cpy(allocator, gpalloc_t, &gpa);
+		*node = index->nodes[*node].next;
+		*pos = 0;
 	}
+}
 
-	// Increase to 10 of slack so we always have some spare space
-	const size_t initial_capacity = 10;
-	gpalloc_grow_array(allocator, initial_capacity);
+/* Biggest key, node is GPALLOC_INDEX_NULL when the index is empty. */
+static void gpalloc_index_last(const gpalloc_free_index* index, uint32_t* node, uint16_t* pos)
+{
+	*node = index->root;
+	*pos = 0;
+	if (*node == GPALLOC_INDEX_NULL)
+		return;
+	while (!index->nodes[*node].leaf)
+		*node = index->nodes[*node].children[index->nodes[*node].count];
+	assert(index->nodes[*node].count > 0 && "Empty nodes are released!");
+	*pos = (uint16_t)(index->nodes[*node].count - 1);
+}
 
-	// Mark free block of whole size
-	gpalloc_allocation allocation = { .address = buffer, .size = pool_size };
-	gpalloc_emplace(allocator, allocation);
+/* Step back to the previous key in order. */
+static void gpalloc_index_prev(const gpalloc_free_index* index, uint32_t* node, uint16_t* pos)
+{
+	assert(*node != GPALLOC_INDEX_NULL);
+	if (*pos > 0)
+	{
+		(*pos)--;
+		return;
+	}
+	*node = index->nodes[*node].prev;
+	*pos = *node != GPALLOC_INDEX_NULL ? (uint16_t)(index->nodes[*node].count - 1) : 0;
 }
 
-void gpalloc_destroy(gpalloc_t* allocator)
+static void gpalloc_index_destroy(gpalloc_t* allocator)
 {
-	assert(allocator != NULL);
-	free(allocator->allocation_array);
-	memset((void*)allocator, 0, sizeof(gpalloc_t));
+	gpalloc_free_index* const index = &allocator->free_index;
+	gpalloc_metadata_realloc(allocator, (void*)index->nodes, index->nodes_capacity * sizeof(gpalloc_index_node), 0);
+	memset((void*)index, 0, sizeof(gpalloc_free_index));
+	index->root = GPALLOC_INDEX_NULL;
+	index->free_node = GPALLOC_INDEX_NULL;
 }
 
-void* gpalloc_malloc(gpalloc_t* allocator, size_t bytes, const size_t alignment) {
+/* Best, worst and hybrid fit search the free index, first and next fit walk the table. */
+static bool gpalloc_indexed(const gpalloc_t* allocator)
+{
+	return allocator->options.policy == GPALLOC_BEST_FIT || allocator->options.policy == GPALLOC_WORST_FIT || allocator->options.policy == GPALLOC_HYBRID_FIT;
+}
 
-	const size_t worstAlignmentSize = bytes + gpalloc_max(alignment, __alignof(gpalloc_allocation)) + sizeof(gpalloc_allocation);
+/* Track a free block in the index if enabled. */
+static void gpalloc_index_add(gpalloc_t* allocator, const gpalloc_allocation* allocation)
+{
+	assert(allocation->used == false && "Only free blocks are indexed!");
+	if (gpalloc_indexed(allocator))
+		gpalloc_index_insert(&allocator->free_index, gpalloc_index_key_of(allocation));
+}
 
-	return gpalloc_malloc_first_fit_block(allocator, bytes, alignment);
+/* Stop tracking a free block in the index if enabled, must be called before changing its size or used flag. */
+static void gpalloc_index_remove(gpalloc_t* allocator, const gpalloc_allocation* allocation)
+{
+	assert(allocation->used == false && "Only free blocks are indexed!");
+	if (gpalloc_indexed(allocator))
+		gpalloc_index_erase(&allocator->free_index, gpalloc_index_key_of(allocation));
 }
 
-void gpalloc_free(gpalloc_t* allocator, void* ptr) {
-	assert(allocator != NULL);
-	assert(ptr != NULL);
+/* Nodes needed by the index updates of a malloc, at most two inserts that can split up to a new root each.
+   When out of memory returns false and nothing has been modified. */
+static bool gpalloc_index_reserve_for_malloc(gpalloc_t* allocator)
+{
+	if (!gpalloc_indexed(allocator))
+		return true;
+	return gpalloc_index_reserve(allocator, 2 * gpalloc_index_height(&allocator->free_index) + 3);
+}
 
-	const size_t index = gpalloc_lower_bound(allocator, ptr);
-	gpalloc_allocation* const allocation = allocator->allocation_array + index;
-	if (allocation->address == ptr)
+/* A free or the initialization inserts one key at most, when there's no memory for it the index is dropped
+   and allocations go back to first fit. */
+static void gpalloc_index_reserve_for_free(gpalloc_t* allocator)
+{
+	if (!gpalloc_indexed(allocator))
+		return;
+	if (!gpalloc_index_reserve(allocator, gpalloc_index_height(&allocator->free_index) + 1))
 	{
-		assert(allocation->used == true && "Must not be already free!");
-		allocation->used = false;
-		gpalloc_coalescence(allocator, index);
+		gpalloc_index_destroy(allocator);
+		allocator->options.policy = GPALLOC_FIRST_FIT;
 	}
 }
 
+#pragma endregion
 
 
+/* See if index-1 and index +1 can be merged with index */
+/* current must not be in the free index yet, the merged block is added to it. */
+void gpalloc_coalescence(gpalloc_t* allocator, size_t index)
+{
 
+	/* Blocks must be contiguos to do this */
+	gpalloc_allocation current = gpalloc_block_get(allocator, index);
+	assert(current.used == false && "Must be free!");
 
+	// Try to merge with previous if has
+	if (index > 0)
+	{
+		const gpalloc_allocation previous = gpalloc_block_get(allocator, index - 1);
 
+		if (!previous.used)
+		{
+			gpalloc_validate((uintptr_t)gpalloc_offset_ptr(previous.address, previous.size) == (uintptr_t)current.address);
+			gpalloc_index_remove(allocator, &previous);
+			current.address = previous.address;
+			current.size += previous.size;
+			gpalloc_erase_at(allocator, index--);
+		}
+	}
+	// try to merge with next
+	if (index + 1 < allocator->allocation_array_size)
+	{
+		const gpalloc_allocation next = gpalloc_block_get(allocator, index + 1);
+
+		if (!next.used)
+		{
+			gpalloc_validate((uintptr_t)gpalloc_offset_ptr(current.address, current.size) == (uintptr_t)next.address);
+			gpalloc_index_remove(allocator, &next);
+			current.size += next.size;
+			gpalloc_erase_at(allocator, index + 1);
+		}
+	}
+
+	gpalloc_block_set(allocator, index, current);
+	gpalloc_index_add(allocator, &current);
+}
+
+
+
+/* Returns the aligned address if the allocation fits in the block, otherwise NULL. */
+static void* gpalloc_block_fit(const gpalloc_allocation* block, const size_t bytes, const size_t alignment)
+{
+	void* aligned_ptr = gpalloc_align(block->address, alignment);
+	const uintptr_t unaligned_block_end = (uintptr_t)gpalloc_offset_ptr(block->address, block->size);
+	const uintptr_t aligned_block_end = (uintptr_t)gpalloc_offset_ptr(aligned_ptr, bytes);
+
+	// If aligned block overflows the current block skip
+	if (aligned_block_end > unaligned_block_end)
+		return NULL;
+
+	return aligned_ptr;
+}
+
+/* Marks as used the aligned part of the free block at index, splitting off the free remainders. */
+static void* gpalloc_split_block(gpalloc_t* allocator, const size_t i, void* aligned_ptr, const size_t bytes)
+{
+	gpalloc_allocation block = gpalloc_block_get(allocator, i);
+	assert(block.used == false && "Must be free!");
+	gpalloc_index_remove(allocator, &block);
+
+	const uintptr_t aligned_block_end = (uintptr_t)gpalloc_offset_ptr(aligned_ptr, bytes);
+	const uintptr_t alignment_offset = gpalloc_ptr_diff(block.address, aligned_ptr);
+
+	// If already aligned then do this:
+	// Split block in two:
+	// First part is used
+	// Second part is free
+	if (alignment_offset == 0)
+	{
+		// Second free block
+		gpalloc_allocation free_block = { .address = (void*)aligned_block_end, .size = block.size - bytes, .used = false };
+
+		// First used block
+		{
+			block.size = bytes;
+			block.used = true;
+			gpalloc_block_set(allocator, i, block);
+		}
+
+		if (free_block.size > 0)
+		{
+			gpalloc_insert(allocator, i + 1, free_block);
+			gpalloc_index_add(allocator, &free_block);
+		}
+
+		return aligned_ptr;
+	}
+
+	// Allocation is not at alignment requirement
+	// Must split into three blocks: | free | used | free |
+	const size_t original_block_size = block.size;
+	const size_t third_block_size = original_block_size - bytes - alignment_offset;
+	gpalloc_allocation third_block = { .address = (void*)aligned_block_end, .size = third_block_size, .used = false };
+
+	gpalloc_allocation second_block = { .address = aligned_ptr, .size = bytes, .used = true };
+	assert(second_block.size > 0);
+
+	// first block
+	block.size = original_block_size - (third_block_size + second_block.size);
+	assert(block.size > 0);
+	assert(block.size + second_block.size + third_block_size == original_block_size);
+	gpalloc_block_set(allocator, i, block);
+	gpalloc_index_add(allocator, &block);
+
+	if (third_block_size > 0)
+	{
+		gpalloc_insert(allocator, i + 1, third_block);
+		gpalloc_index_add(allocator, &third_block);
+	}
+	gpalloc_insert(allocator, i + 1, second_block);
+
+	return aligned_ptr;
+}
+
+#if GPALLOC_COMPACT_TABLE
+
+/* First free block from index i where size bytes fit at an address aligned to alignment_mask + 1, allocation_array_size
+   if none. Same test as gpalloc_block_fit on the low 32 bits of the addresses, enough for alignments up to 2^31.
+   Reads only the offsets, the sizes and the bitmap. */
+static size_t gpalloc_find_free_scalar(const gpalloc_t* allocator, size_t i, const uint32_t size, const uint32_t alignment_mask)
+{
+	const size_t count = allocator->allocation_array_size;
+	const uint32_t base = (uint32_t)(uintptr_t)allocator->buffer;
+	while (i < count)
+	{
+		// Zeros are shifted in at the top, so no bits left means the rest of the word is used
+		const uint64_t free_bits = ~allocator->block_used[i / 64] >> (i % 64);
+		if (free_bits == 0)
+		{
+			i = (i / 64 + 1) * 64;
+			continue;
+		}
+		if (free_bits & 1)
+		{
+			const uint32_t padding = (0u - (base + allocator->block_offsets[i])) & alignment_mask;
+			if (allocator->block_sizes[i] >= padding && allocator->block_sizes[i] - padding >= size)
+				return i;
+		}
+		i++;
+	}
+	return count;
+}
+
+#if GPALLOC_SIMD_LANES > 1
+
+static unsigned int gpalloc_ctz(const unsigned int mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+/* Same as gpalloc_find_free_scalar, GPALLOC_SIMD_LANES blocks tested at once. */
+static size_t gpalloc_find_free(const gpalloc_t* allocator, size_t i, const uint32_t size, const uint32_t alignment_mask)
+{
+	const size_t count = allocator->allocation_array_size;
+	const unsigned int lanes_mask = (1u << GPALLOC_SIMD_LANES) - 1;
+	assert(size > 0);
+
+	// Scalar up to a multiple of the lanes, then the used bits of a step are in one bitmap word
+	if (i % GPALLOC_SIMD_LANES)
+	{
+		const size_t aligned = i + GPALLOC_SIMD_LANES - i % GPALLOC_SIMD_LANES;
+		const size_t found = gpalloc_find_free_scalar(allocator, i, size, alignment_mask);
+		if (found < aligned || aligned >= count)
+			return found;
+		i = aligned;
+	}
+
+	// No unsigned compare before AVX-512, flipping the sign bit of both sides makes the signed one equivalent.
+	// A block fits when padding <= block size and block size - padding > size - 1.
+#if GPALLOC_SIMD_LANES == 8
+	const __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+	const __m256i threshold = _mm256_set1_epi32((int)((size - 1) ^ 0x80000000u));
+	const __m256i base = _mm256_set1_epi32((int)(uint32_t)(uintptr_t)allocator->buffer);
+	const __m256i mask = _mm256_set1_epi32((int)alignment_mask);
+	const __m256i zero = _mm256_setzero_si256();
+#else
+	const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+	const __m128i threshold = _mm_set1_epi32((int)((size - 1) ^ 0x80000000u));
+	const __m128i base = _mm_set1_epi32((int)(uint32_t)(uintptr_t)allocator->buffer);
+	const __m128i mask = _mm_set1_epi32((int)alignment_mask);
+	const __m128i zero = _mm_setzero_si128();
+#endif
+	for (; i + GPALLOC_SIMD_LANES <= count; i += GPALLOC_SIMD_LANES)
+	{
+		const unsigned int used = (unsigned int)(allocator->block_used[i / 64] >> (i % 64)) & lanes_mask;
+		if (used == lanes_mask)
+			continue;
+
+#if GPALLOC_SIMD_LANES == 8
+		const __m256i offsets = _mm256_loadu_si256((const __m256i*)(allocator->block_offsets + i));
+		const __m256i sizes = _mm256_loadu_si256((const __m256i*)(allocator->block_sizes + i));
+		const __m256i padding = _mm256_and_si256(_mm256_sub_epi32(zero, _mm256_add_epi32(base, offsets)), mask);
+		const __m256i too_small = _mm256_cmpgt_epi32(_mm256_xor_si256(padding, sign), _mm256_xor_si256(sizes, sign));
+		const __m256i greater = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_sub_epi32(sizes, padding), sign), threshold);
+		const unsigned int fits = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(too_small, greater)));
+#else
+		const __m128i offsets = _mm_loadu_si128((const __m128i*)(allocator->block_offsets + i));
+		const __m128i sizes = _mm_loadu_si128((const __m128i*)(allocator->block_sizes + i));
+		const __m128i padding = _mm_and_si128(_mm_sub_epi32(zero, _mm_add_epi32(base, offsets)), mask);
+		const __m128i too_small = _mm_cmpgt_epi32(_mm_xor_si128(padding, sign), _mm_xor_si128(sizes, sign));
+		const __m128i greater = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(sizes, padding), sign), threshold);
+		const unsigned int fits = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(too_small, greater)));
+#endif
+		const unsigned int candidates = fits & ~used & lanes_mask;
+		if (candidates)
+			return i + gpalloc_ctz(candidates);
+	}
+
+	return gpalloc_find_free_scalar(allocator, i, size, alignment_mask);
+}
+
+#else
+
+static size_t gpalloc_find_free(const gpalloc_t* allocator, size_t i, const uint32_t size, const uint32_t alignment_mask)
+{
+	return gpalloc_find_free_scalar(allocator, i, size, alignment_mask);
+}
+
+#endif
+
+#endif
+
+/* First free block of [begin, end) that fits, NULL when none. */
+static void* gpalloc_malloc_fit_range(gpalloc_t* allocator, const size_t begin, const size_t end, const size_t bytes, const size_t alignment)
+{
+	size_t i;
+#if GPALLOC_COMPACT_TABLE
+	// The search tests the alignment too, the first block found is the one to split
+	if (bytes > 0 && bytes <= UINT32_MAX && alignment > 0 && alignment <= 0x80000000u && (alignment & (alignment - 1)) == 0)
+	{
+		i = gpalloc_find_free(allocator, begin, (uint32_t)bytes, (uint32_t)(alignment - 1));
+		if (i >= end)
+			return (void*)NULL;
+
+		const gpalloc_allocation block = gpalloc_block_get(allocator, i);
+		void* aligned_ptr = gpalloc_block_fit(&block, bytes, alignment);
+		assert(aligned_ptr != NULL && "Search and fit must agree!");
+		return gpalloc_split_block(allocator, i, aligned_ptr, bytes);
+	}
+#endif
+	for (i = begin; i < end; i++)
+	{
+		const gpalloc_allocation block = gpalloc_block_get(allocator, i);
+		if (block.used)
+			continue;
+
+		void* aligned_ptr = gpalloc_block_fit(&block, bytes, alignment);
+		if (aligned_ptr == NULL)
+			continue;
+
+		return gpalloc_split_block(allocator, i, aligned_ptr, bytes);
+	}
+
+	return (void*)NULL;
+}
+
+void* gpalloc_malloc_first_fit_block(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	return gpalloc_malloc_fit_range(allocator, 0, allocator->allocation_array_size, bytes, alignment);
+}
+
+/* First fit from the block after the previous allocation, wrapping around to the start of the buffer. */
+static void* gpalloc_malloc_next_fit_block(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	const size_t start = gpalloc_lower_bound(allocator, gpalloc_offset_ptr(allocator->buffer, allocator->next_fit_cursor));
+	void* ptr = gpalloc_malloc_fit_range(allocator, start, allocator->allocation_array_size, bytes, alignment);
+	if (ptr == NULL)
+		ptr = gpalloc_malloc_fit_range(allocator, 0, start, bytes, alignment);
+	if (ptr != NULL)
+		allocator->next_fit_cursor = gpalloc_ptr_diff(allocator->buffer, ptr) + bytes;
+	return ptr;
+}
+
+/* Splits the free block of the index at the aligned address. */
+static void* gpalloc_malloc_indexed_block(gpalloc_t* allocator, const gpalloc_allocation* block, void* aligned_ptr, const size_t bytes)
+{
+	const size_t i = gpalloc_lower_bound(allocator, block->address);
+	assert(i < allocator->allocation_array_size && gpalloc_block_address(allocator, i) == (uintptr_t)block->address && "Index is out of sync with the allocation array!");
+	return gpalloc_split_block(allocator, i, aligned_ptr, bytes);
+}
+
+/* Best fit walking only the free index from the blocks of at least the requested size. A block that needs alignment
+   padding leaves a free sliver in front of the allocation that is smaller than the alignment and rarely reusable, so
+   the padding counts twice in the waste: waste = size - bytes + padding. Blocks come in size order and the waste is
+   at least size - bytes, the walk stops once that alone can't beat the best, or after
+   GPALLOC_BEST_FIT_CANDIDATES fitting blocks. */
+static void* gpalloc_malloc_best_fit_block(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	const gpalloc_free_index* const index = &allocator->free_index;
+	const gpalloc_index_key key = { .size = bytes, .address = 0 };
+
+	gpalloc_allocation best = { 0 };
+	void* best_ptr = NULL;
+	size_t best_waste = SIZE_MAX;
+	size_t candidates = 0;
+	uint32_t node;
+	uint16_t pos;
+	for (gpalloc_index_lower_bound(index, key, &node, &pos); node != GPALLOC_INDEX_NULL; gpalloc_index_next(index, &node, &pos))
+	{
+		const gpalloc_index_key candidate = index->nodes[node].keys[pos];
+		const gpalloc_allocation block = { .address = (void*)candidate.address, .size = candidate.size, .used = false };
+		if (block.size - bytes >= best_waste)
+			break;
+
+		// Blocks bigger than bytes may still not fit due to the alignment padding
+		void* aligned_ptr = gpalloc_block_fit(&block, bytes, alignment);
+		if (aligned_ptr == NULL)
+			continue;
+
+		const size_t waste = block.size - bytes + gpalloc_ptr_diff(block.address, aligned_ptr);
+		if (waste < best_waste)
+		{
+			best = block;
+			best_ptr = aligned_ptr;
+			best_waste = waste;
+		}
+		if (++candidates >= GPALLOC_BEST_FIT_CANDIDATES)
+			break;
+	}
+
+	if (best_ptr == NULL)
+		return (void*)NULL;
+	return gpalloc_malloc_indexed_block(allocator, &best, best_ptr, bytes);
+}
+
+/* Biggest free block that fits, the remainder stays as big as possible. */
+static void* gpalloc_malloc_worst_fit_block(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	const gpalloc_free_index* const index = &allocator->free_index;
+
+	uint32_t node;
+	uint16_t pos;
+	for (gpalloc_index_last(index, &node, &pos); node != GPALLOC_INDEX_NULL; gpalloc_index_prev(index, &node, &pos))
+	{
+		const gpalloc_index_key candidate = index->nodes[node].keys[pos];
+		const gpalloc_allocation block = { .address = (void*)candidate.address, .size = candidate.size, .used = false };
+		if (block.size < bytes)
+			break;
+
+		// Only the alignment padding can make a big enough block not fit, the walk goes on with smaller ones
+		void* aligned_ptr = gpalloc_block_fit(&block, bytes, alignment);
+		if (aligned_ptr != NULL)
+			return gpalloc_malloc_indexed_block(allocator, &block, aligned_ptr, bytes);
+	}
+
+	return (void*)NULL;
+}
+
+#pragma endregion
+
+
+#pragma endregion
+
+
+/* Slot of the handle table, ptr is NULL and next_free links the free slots when released. */
+typedef struct gpalloc_handle_entry {
+	void* ptr;
+	uint32_t generation;
+	uint32_t next_free;
+} gpalloc_handle_entry;
+
+#pragma region Deferred coalescing
+
+/* Free block remembered for reuse at the same size, size 0 is an empty way. The block is trusted only while the
+   table still has a free block of that size at that offset. */
+typedef struct gpalloc_reuse_entry {
+	size_t size;
+	size_t offset;
+} gpalloc_reuse_entry;
+
+static gpalloc_reuse_entry* gpalloc_reuse_bucket(gpalloc_t* allocator, const size_t size)
+{
+	const size_t hash = (size_t)(((uint64_t)size * 0x9E3779B97F4A7C15ull) >> 32);
+	return allocator->reuse_cache + (hash % GPALLOC_REUSE_BUCKETS) * GPALLOC_REUSE_WAYS;
+}
+
+/* Remembers a freed block, newest first. A full bucket forgets the oldest, the block itself stays free. */
+static void gpalloc_reuse_push(gpalloc_t* allocator, const gpalloc_allocation* block)
+{
+	gpalloc_reuse_entry* const bucket = gpalloc_reuse_bucket(allocator, block->size);
+	memmove(bucket + 1, bucket, (GPALLOC_REUSE_WAYS - 1) * sizeof(gpalloc_reuse_entry));
+	bucket[0].size = block->size;
+	bucket[0].offset = gpalloc_ptr_diff(allocator->buffer, block->address);
+}
+
+/* Takes a remembered free block of exactly bytes at the alignment, no split nor table shift. NULL on a miss. */
+static void* gpalloc_reuse_pop(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	gpalloc_reuse_entry* const bucket = gpalloc_reuse_bucket(allocator, bytes);
+	size_t way;
+	for (way = 0; way < GPALLOC_REUSE_WAYS; way++)
+	{
+		if (bucket[way].size != bytes)
+			continue;
+
+		void* const ptr = gpalloc_offset_ptr(allocator->buffer, bucket[way].offset);
+		if (gpalloc_align(ptr, alignment) != ptr)
+			continue;
+
+		// Taken or merged since, forget it
+		bucket[way].size = 0;
+		const size_t index = gpalloc_lower_bound(allocator, ptr);
+		if (index >= allocator->allocation_array_size || gpalloc_block_address(allocator, index) != (uintptr_t)ptr)
+			continue;
+		gpalloc_allocation block = gpalloc_block_get(allocator, index);
+		if (block.used || block.size != bytes)
+			continue;
+
+		gpalloc_index_remove(allocator, &block);
+		block.used = true;
+		gpalloc_block_set(allocator, index, block);
+		return ptr;
+	}
+	return (void*)NULL;
+}
+
+size_t gpalloc_collect(gpalloc_t* allocator)
+{
+	assert(allocator != NULL);
+	if (allocator->deferred_frees == 0)
+		return 0;
+
+	// One pass, runs of free blocks are folded into the first one and the kept blocks slide down in place
+	size_t merged = 0;
+	size_t write = 0;
+	size_t read;
+	for (read = 0; read < allocator->allocation_array_size; read++)
+	{
+		const gpalloc_allocation block = gpalloc_block_get(allocator, read);
+		if (write > 0 && !block.used)
+		{
+			gpalloc_allocation previous = gpalloc_block_get(allocator, write - 1);
+			if (!previous.used)
+			{
+				gpalloc_validate((uintptr_t)gpalloc_offset_ptr(previous.address, previous.size) == (uintptr_t)block.address);
+				gpalloc_index_remove(allocator, &previous);
+				gpalloc_index_remove(allocator, &block);
+				gpalloc_map_count(allocator, (uintptr_t)block.address, (uint32_t)-1);
+				previous.size += block.size;
+				gpalloc_block_store(allocator, write - 1, previous);
+				gpalloc_index_reserve_for_free(allocator);
+				gpalloc_index_add(allocator, &previous);
+				merged++;
+				continue;
+			}
+		}
+		if (write != read)
+			gpalloc_block_store(allocator, write, block);
+		write++;
+	}
+	allocator->allocation_array_size = write;
+	gpalloc_clear_out_of_size(allocator);
+
+	// Offsets in the cache may point inside merged blocks now
+	memset(allocator->reuse_cache, 0, GPALLOC_REUSE_BUCKETS * GPALLOC_REUSE_WAYS * sizeof(gpalloc_reuse_entry));
+	allocator->deferred_frees = 0;
+	gpalloc_validate_sweep(allocator);
+	return merged;
+}
+
+#pragma endregion
+
+void gpalloc_initialize(gpalloc_t* allocator, void* buffer, const size_t pool_size) {
+	const int initialized = gpalloc_initialize_ex(allocator, buffer, pool_size, NULL);
+	assert(initialized && "Out of memory for the metadata!");
+	((void)initialized);
+}
+
+int gpalloc_initialize_ex(gpalloc_t* allocator, void* buffer, const size_t pool_size, const gpalloc_options* options) {
+	assert(allocator != NULL);
+	assert(buffer != NULL);
+	assert(pool_size > 0 && "Memory size must be greater than 0");
+
+	{
+		// Initialize
+		gpalloc_t gpa = { .buffer = buffer, .buffer_size = pool_size, .allocation_array_size = 0, .allocation_array_capacity = 0 };
+		if (options != NULL)
+			gpa.options = *options;
+		gpa.free_index.root = GPALLOC_INDEX_NULL;
+		gpa.free_index.free_node = GPALLOC_INDEX_NULL;
+		gpa.handles_free = GPALLOC_INDEX_NULL;
+		pun_cpy(allocator, gpalloc_t, &gpa);
+	}
+
+#if GPALLOC_COMPACT_TABLE
+	if (pool_size > UINT32_MAX)
+		return 0;
+#endif
+
+	// Increase to 10 of slack so we always have some spare space
+	const size_t initial_capacity = 10;
+	if (!gpalloc_grow_array(allocator, initial_capacity))
+	{
+		// Without blocks every malloc fails
+		return 0;
+	}
+
+	if (allocator->options.address_map_page != 0)
+	{
+		const size_t page_size = allocator->options.address_map_page;
+		assert((page_size & (page_size - 1)) == 0 && "Address map page must be a power of two!");
+		allocator->address_map_pages = (pool_size + page_size - 1) / page_size;
+		while (((size_t)1 << allocator->address_map_shift) < page_size)
+			allocator->address_map_shift++;
+		allocator->address_map = (uint32_t*)gpalloc_metadata_realloc(allocator, NULL, 0, (allocator->address_map_pages + 1) * sizeof(uint32_t));
+		if (allocator->address_map == NULL)
+		{
+			allocator->address_map_pages = 0;
+			return 0;
+		}
+		memset(allocator->address_map, 0, (allocator->address_map_pages + 1) * sizeof(uint32_t));
+	}
+
+	if (allocator->options.deferred_coalescing)
+	{
+		const size_t cache_bytes = GPALLOC_REUSE_BUCKETS * GPALLOC_REUSE_WAYS * sizeof(gpalloc_reuse_entry);
+		allocator->reuse_cache = (gpalloc_reuse_entry*)gpalloc_metadata_realloc(allocator, NULL, 0, cache_bytes);
+		if (allocator->reuse_cache == NULL)
+			return 0;
+		memset(allocator->reuse_cache, 0, cache_bytes);
+	}
+
+	// Mark free block of whole size
+	gpalloc_allocation allocation = { .address = buffer, .size = pool_size };
+	gpalloc_emplace(allocator, allocation);
+	gpalloc_index_reserve_for_free(allocator);
+	gpalloc_index_add(allocator, &allocation);
+	return 1;
+}
+
+void gpalloc_destroy(gpalloc_t* allocator)
+{
+	assert(allocator != NULL);
+#if GPALLOC_COMPACT_TABLE
+	gpalloc_metadata_realloc(allocator, (void*)allocator->block_offsets, allocator->allocation_array_capacity * sizeof(uint32_t), 0);
+	gpalloc_metadata_realloc(allocator, (void*)allocator->block_sizes, allocator->allocation_array_capacity * sizeof(uint32_t), 0);
+	gpalloc_metadata_realloc(allocator, (void*)allocator->block_used, gpalloc_used_words(allocator->allocation_array_capacity) * sizeof(uint64_t), 0);
+#else
+	gpalloc_metadata_realloc(allocator, (void*)allocator->allocation_array, allocator->allocation_array_capacity * sizeof(gpalloc_allocation), 0);
+#endif
+	gpalloc_index_destroy(allocator);
+	gpalloc_metadata_realloc(allocator, allocator->address_map, allocator->address_map ? (allocator->address_map_pages + 1) * sizeof(uint32_t) : 0, 0);
+	gpalloc_metadata_realloc(allocator, allocator->reuse_cache, allocator->reuse_cache ? GPALLOC_REUSE_BUCKETS * GPALLOC_REUSE_WAYS * sizeof(gpalloc_reuse_entry) : 0, 0);
+	gpalloc_metadata_realloc(allocator, allocator->handles, allocator->handles_capacity * sizeof(gpalloc_handle_entry), 0);
+	memset((void*)allocator, 0, sizeof(gpalloc_t));
+}
+
+/* Search of the placement policy, metadata must be reserved. */
+static void* gpalloc_malloc_policy(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	switch (allocator->options.policy)
+	{
+	case GPALLOC_BEST_FIT:
+		return gpalloc_malloc_best_fit_block(allocator, bytes, alignment);
+	case GPALLOC_NEXT_FIT:
+		return gpalloc_malloc_next_fit_block(allocator, bytes, alignment);
+	case GPALLOC_WORST_FIT:
+		return gpalloc_malloc_worst_fit_block(allocator, bytes, alignment);
+	case GPALLOC_HYBRID_FIT:
+		// Small blocks are placed next to each other in allocation order, big ones where they waste the least
+		if (bytes <= GPALLOC_HYBRID_SMALL_SIZE)
+			return gpalloc_malloc_next_fit_block(allocator, bytes, alignment);
+		return gpalloc_malloc_best_fit_block(allocator, bytes, alignment);
+	default:
+		return gpalloc_malloc_first_fit_block(allocator, bytes, alignment);
+	}
+}
+
+void* gpalloc_malloc(gpalloc_t* allocator, size_t bytes, const size_t alignment) {
+
+	const size_t worstAlignmentSize = bytes + gpalloc_max(alignment, __alignof(gpalloc_allocation)) + sizeof(gpalloc_allocation);
+
+	// Nothing to allocate from after a failed initialization
+	if (allocator->allocation_array_size == 0)
+		return (void*)NULL;
+
+	// Same size as a deferred free, taken back without touching the table layout
+	if (allocator->reuse_cache != NULL)
+	{
+		void* reused = gpalloc_reuse_pop(allocator, bytes, alignment);
+		if (reused != NULL)
+		{
+			gpalloc_validate_sweep(allocator);
+			return reused;
+		}
+	}
+
+	// A split inserts up to two blocks, reserve everything first so running out of metadata memory fails cleanly
+	if (!gpalloc_grow_array(allocator, allocator->allocation_array_size + 2) || !gpalloc_index_reserve_for_malloc(allocator))
+		return (void*)NULL;
+
+	void* ptr = gpalloc_malloc_policy(allocator, bytes, alignment);
+	// A failure can be fragmentation only, merging the deferred frees may make room
+	if (ptr == NULL && gpalloc_collect(allocator) > 0 && gpalloc_index_reserve_for_malloc(allocator))
+		ptr = gpalloc_malloc_policy(allocator, bytes, alignment);
+
+	gpalloc_validate(ptr == NULL || ((uintptr_t)ptr >= (uintptr_t)allocator->buffer && (uintptr_t)ptr + bytes <= (uintptr_t)allocator->buffer + allocator->buffer_size));
+	gpalloc_validate_sweep(allocator);
+	return ptr;
+}
+
+void gpalloc_free(gpalloc_t* allocator, void* ptr) {
+	assert(allocator != NULL);
+	assert(ptr != NULL);
+	gpalloc_validate((uintptr_t)ptr >= (uintptr_t)allocator->buffer && (uintptr_t)ptr < (uintptr_t)allocator->buffer + allocator->buffer_size);
+
+	// Frees the cache can't remember gain nothing unmerged, past them the table is compacted once it grew by an eighth,
+	// so the pass costs O(1) per free amortized and the searches don't crawl through fragments
+	if (allocator->deferred_frees >= GPALLOC_REUSE_BUCKETS * GPALLOC_REUSE_WAYS && allocator->deferred_frees >= allocator->allocation_array_size / 8)
+		gpalloc_collect(allocator);
+
+	const size_t index = gpalloc_lower_bound(allocator, ptr);
+	if (index < allocator->allocation_array_size && gpalloc_block_address(allocator, index) == (uintptr_t)ptr)
+	{
+		gpalloc_allocation allocation = gpalloc_block_get(allocator, index);
+		assert(allocation.used == true && "Must not be already free!");
+		gpalloc_validate(allocation.used);
+		gpalloc_index_reserve_for_free(allocator);
+		allocation.used = false;
+		gpalloc_block_set(allocator, index, allocation);
+		if (allocator->reuse_cache != NULL)
+		{
+			// Left unmerged until gpalloc_collect
+			gpalloc_index_add(allocator, &allocation);
+			gpalloc_reuse_push(allocator, &allocation);
+			allocator->deferred_frees++;
+		}
+		else
+		{
+			gpalloc_coalescence(allocator, index);
+		}
+	}
+	gpalloc_validate_sweep(allocator);
+}
+
+size_t gpalloc_get_allocation_size(gpalloc_t* allocator, void* ptr)
+{
+	assert(allocator != NULL);
+	assert(ptr != NULL);
+	gpalloc_validate((uintptr_t)ptr >= (uintptr_t)allocator->buffer && (uintptr_t)ptr < (uintptr_t)allocator->buffer + allocator->buffer_size);
+
+	const size_t index = gpalloc_lower_bound(allocator, ptr);
+	assert(index < allocator->allocation_array_size && gpalloc_block_address(allocator, index) == (uintptr_t)ptr && "Pointer must be an allocation!");
+	const gpalloc_allocation block = gpalloc_block_get(allocator, index);
+	assert(block.used == true && "Must not be already free!");
+	return block.size;
+}
+
+void* gpalloc_realloc(gpalloc_t* allocator, void* ptr, const size_t bytes, const size_t alignment) {
+	assert(allocator != NULL);
+	if (ptr == NULL)
+		return gpalloc_malloc(allocator, bytes, alignment);
+	if (bytes == 0)
+	{
+		gpalloc_free(allocator, ptr);
+		return (void*)NULL;
+	}
+	gpalloc_validate((uintptr_t)ptr >= (uintptr_t)allocator->buffer && (uintptr_t)ptr < (uintptr_t)allocator->buffer + allocator->buffer_size);
+
+	const size_t index = gpalloc_lower_bound(allocator, ptr);
+	assert(index < allocator->allocation_array_size && gpalloc_block_address(allocator, index) == (uintptr_t)ptr && "Pointer must be an allocation!");
+	gpalloc_allocation block = gpalloc_block_get(allocator, index);
+	assert(block.used == true && "Must not be already free!");
+	const size_t size = block.size;
+
+	// In place only when the current address still satisfies the alignment and the metadata updates can't fail
+	if (gpalloc_align(ptr, alignment) == ptr && gpalloc_grow_array(allocator, allocator->allocation_array_size + 1) && gpalloc_index_reserve_for_malloc(allocator))
+	{
+		const int has_next = index + 1 < allocator->allocation_array_size;
+		gpalloc_allocation next = has_next ? gpalloc_block_get(allocator, index + 1) : block;
+
+		if (bytes <= size)
+		{
+			// Shrink, the tail joins the next free block or becomes one
+			const size_t tail = size - bytes;
+			block.size = bytes;
+			gpalloc_block_set(allocator, index, block);
+			if (tail > 0 && has_next && !next.used)
+			{
+				gpalloc_index_remove(allocator, &next);
+				next.address = gpalloc_subtract_ptr(next.address, tail);
+				next.size += tail;
+				gpalloc_block_set(allocator, index + 1, next);
+				gpalloc_index_add(allocator, &next);
+			}
+			else if (tail > 0)
+			{
+				gpalloc_allocation free_block = { .address = gpalloc_offset_ptr(ptr, bytes), .size = tail, .used = false };
+				gpalloc_insert(allocator, index + 1, free_block);
+				gpalloc_index_add(allocator, &free_block);
+			}
+			gpalloc_validate_sweep(allocator);
+			return ptr;
+		}
+
+		if (has_next && !next.used && next.size >= bytes - size)
+		{
+			// Grow into the next free block, what's left of it stays free
+			const size_t needed = bytes - size;
+			gpalloc_index_remove(allocator, &next);
+			block.size = bytes;
+			gpalloc_block_set(allocator, index, block);
+			if (next.size == needed)
+			{
+				gpalloc_erase_at(allocator, index + 1);
+			}
+			else
+			{
+				next.address = gpalloc_offset_ptr(next.address, needed);
+				next.size -= needed;
+				gpalloc_block_set(allocator, index + 1, next);
+				gpalloc_index_add(allocator, &next);
+			}
+			gpalloc_validate_sweep(allocator);
+			return ptr;
+		}
+	}
+
+	// Move, on failure the original allocation is untouched
+	void* moved = gpalloc_malloc(allocator, bytes, alignment);
+	if (moved == NULL)
+		return (void*)NULL;
+	memcpy(moved, ptr, size < bytes ? size : bytes);
+	gpalloc_free(allocator, ptr);
+	return moved;
+}
+
+/* Alignment of the address, capped to GPALLOC_DEFRAGMENT_ALIGNMENT. */
+static size_t gpalloc_defragment_alignment(const void* ptr)
+{
+	const uintptr_t address = (uintptr_t)ptr;
+	const uintptr_t lowest_bit = address & (~address + 1);
+	return lowest_bit == 0 || lowest_bit > GPALLOC_DEFRAGMENT_ALIGNMENT ? GPALLOC_DEFRAGMENT_ALIGNMENT : (size_t)lowest_bit;
+}
+
+/* Returns non zero when the used block at ptr can be moved. */
+typedef int (*gpalloc_movable_fn)(void* user, const void* ptr);
+
+/* The pass of gpalloc_defragment, movable NULL moves every used block. */
+static int gpalloc_defragment_pass(gpalloc_t* allocator, const size_t budget, gpalloc_move_fn move, gpalloc_movable_fn movable, void* user)
+{
+	assert(allocator != NULL);
+	assert(move != NULL);
+
+	// The pass slides blocks into single holes
+	gpalloc_collect(allocator);
+
+	size_t moved = 0;
+	size_t i = gpalloc_lower_bound(allocator, gpalloc_offset_ptr(allocator->buffer, allocator->defragment_cursor));
+	while (i + 1 < allocator->allocation_array_size)
+	{
+		const gpalloc_allocation hole = gpalloc_block_get(allocator, i);
+		const gpalloc_allocation block = gpalloc_block_get(allocator, i + 1);
+		if (hole.used || !block.used)
+		{
+			i++;
+			continue;
+		}
+
+		// Lowest address that keeps the alignment, at most the current one since that is aligned too
+		void* target = gpalloc_align(hole.address, gpalloc_defragment_alignment(block.address));
+		if (target == block.address || (budget != 0 && block.size > budget) || (movable != NULL && !movable(user, block.address)))
+		{
+			i++;
+			continue;
+		}
+		if (budget != 0 && moved + block.size > budget)
+		{
+			allocator->defragment_cursor = gpalloc_ptr_diff(allocator->buffer, hole.address);
+			gpalloc_validate_sweep(allocator);
+			return 0;
+		}
+
+		// Up to three blocks take the place of two, | padding | block | tail | where the tail merges with the next
+		if (!gpalloc_grow_array(allocator, allocator->allocation_array_size + 1) || !gpalloc_index_reserve_for_malloc(allocator))
+		{
+			allocator->defragment_cursor = gpalloc_ptr_diff(allocator->buffer, hole.address);
+			return 0;
+		}
+
+		move(user, block.address, target, block.size);
+		moved += block.size;
+
+		gpalloc_index_remove(allocator, &hole);
+		const size_t padding = gpalloc_ptr_diff(hole.address, target);
+		const gpalloc_allocation moved_block = { .address = target, .size = block.size, .used = true };
+		const gpalloc_allocation tail = { .address = gpalloc_offset_ptr(target, block.size), .size = hole.size - padding, .used = false };
+		if (padding > 0)
+		{
+			const gpalloc_allocation padding_block = { .address = hole.address, .size = padding, .used = false };
+			gpalloc_block_set(allocator, i, padding_block);
+			gpalloc_index_add(allocator, &padding_block);
+			gpalloc_block_set(allocator, i + 1, moved_block);
+			gpalloc_insert(allocator, i + 2, tail);
+			i += 2;
+		}
+		else
+		{
+			gpalloc_block_set(allocator, i, moved_block);
+			gpalloc_block_set(allocator, i + 1, tail);
+			i += 1;
+		}
+		gpalloc_coalescence(allocator, i);
+	}
+
+	allocator->defragment_cursor = 0;
+	gpalloc_validate_sweep(allocator);
+	return 1;
+}
+
+int gpalloc_defragment(gpalloc_t* allocator, const size_t budget, gpalloc_move_fn move, void* user)
+{
+	return gpalloc_defragment_pass(allocator, budget, move, NULL, user);
+}
+
+#pragma region Handles
+
+static uint32_t gpalloc_handle_index(const gpalloc_handle handle)
+{
+	return (uint32_t)(handle & 0xFFFFFFFFu);
+}
+
+static uint32_t gpalloc_handle_generation(const gpalloc_handle handle)
+{
+	return (uint32_t)(handle >> 32);
+}
+
+gpalloc_handle gpalloc_halloc(gpalloc_t* allocator, const size_t bytes, const size_t alignment)
+{
+	assert(allocator != NULL);
+
+	// The slot first, a failed malloc just leaves it for the next handle
+	if (allocator->handles_free == GPALLOC_INDEX_NULL && allocator->handles_size == allocator->handles_capacity)
+	{
+		if (allocator->handles_capacity >= GPALLOC_INDEX_NULL / 2)
+			return GPALLOC_NULL_HANDLE;
+		const uint32_t new_capacity = allocator->handles_capacity ? allocator->handles_capacity * 2 : 16;
+		gpalloc_handle_entry* new_handles = (gpalloc_handle_entry*)gpalloc_metadata_realloc(allocator, allocator->handles, allocator->handles_capacity * sizeof(gpalloc_handle_entry), new_capacity * sizeof(gpalloc_handle_entry));
+		if (!new_handles)
+			return GPALLOC_NULL_HANDLE;
+		allocator->handles = new_handles;
+		allocator->handles_capacity = new_capacity;
+	}
+
+	void* ptr = gpalloc_malloc(allocator, bytes, alignment);
+	if (ptr == NULL)
+		return GPALLOC_NULL_HANDLE;
+
+	uint32_t index;
+	if (allocator->handles_free != GPALLOC_INDEX_NULL)
+	{
+		index = allocator->handles_free;
+		allocator->handles_free = allocator->handles[index].next_free;
+	}
+	else
+	{
+		index = allocator->handles_size++;
+		allocator->handles[index].generation = 1;
+	}
+	allocator->handles[index].ptr = ptr;
+	allocator->handles[index].next_free = GPALLOC_INDEX_NULL;
+	return ((gpalloc_handle)allocator->handles[index].generation << 32) | index;
+}
+
+void* gpalloc_resolve(const gpalloc_t* allocator, const gpalloc_handle handle)
+{
+	assert(allocator != NULL);
+	const uint32_t index = gpalloc_handle_index(handle);
+	if (index >= allocator->handles_size || allocator->handles[index].generation != gpalloc_handle_generation(handle))
+		return (void*)NULL;
+	return allocator->handles[index].ptr;
+}
+
+void gpalloc_hfree(gpalloc_t* allocator, const gpalloc_handle handle)
+{
+	void* ptr = gpalloc_resolve(allocator, handle);
+	assert(ptr != NULL && "Handle was already released!");
+	if (ptr == NULL)
+		return;
+
+	gpalloc_free(allocator, ptr);
+	gpalloc_handle_entry* entry = &allocator->handles[gpalloc_handle_index(handle)];
+	entry->ptr = NULL;
+	// Stale copies of the handle never match again, 0 is skipped so no handle is null
+	entry->generation = entry->generation + 1 ? entry->generation + 1 : 1;
+	entry->next_free = allocator->handles_free;
+	allocator->handles_free = gpalloc_handle_index(handle);
+}
+
+/* Live handles ordered by address, the compaction finds the entry of a block with a binary search. */
+typedef struct {
+	uintptr_t address;
+	uint32_t index;
+} gpalloc_handle_ref;
+
+typedef struct {
+	gpalloc_t* allocator;
+	gpalloc_handle_ref* refs;
+	size_t count;
+} gpalloc_hcompact_state;
+
+static int gpalloc_handle_ref_compare(const void* a, const void* b)
+{
+	const uintptr_t address_a = ((const gpalloc_handle_ref*)a)->address;
+	const uintptr_t address_b = ((const gpalloc_handle_ref*)b)->address;
+	return (address_a > address_b) - (address_a < address_b);
+}
+
+static gpalloc_handle_ref* gpalloc_hcompact_find(const gpalloc_hcompact_state* state, const void* ptr)
+{
+	size_t count = state->count;
+	size_t first = 0;
+	while (0 < count)
+	{
+		const size_t count2 = count / 2;
+		const size_t mid = first + count2;
+		if (state->refs[mid].address < (uintptr_t)ptr)
+		{
+			first = mid + 1;
+			count -= count2 + 1;
+		}
+		else
+		{
+			count = count2;
+		}
+	}
+	return first < state->count && state->refs[first].address == (uintptr_t)ptr ? &state->refs[first] : NULL;
+}
+
+static int gpalloc_hcompact_movable(void* user, const void* ptr)
+{
+	return gpalloc_hcompact_find((const gpalloc_hcompact_state*)user, ptr) != NULL;
+}
+
+/* Blocks only slide down over free space, the refs stay ordered. */
+static void gpalloc_hcompact_move(void* user, void* from, void* to, size_t size)
+{
+	gpalloc_hcompact_state* state = (gpalloc_hcompact_state*)user;
+	gpalloc_handle_ref* ref = gpalloc_hcompact_find(state, from);
+	assert(ref != NULL && "Only handle allocations are moved!");
+	memmove(to, from, size);
+	ref->address = (uintptr_t)to;
+	state->allocator->handles[ref->index].ptr = to;
+}
+
+int gpalloc_hcompact(gpalloc_t* allocator, const size_t budget)
+{
+	assert(allocator != NULL);
+
+	gpalloc_hcompact_state state = { .allocator = allocator, .refs = NULL, .count = 0 };
+	const size_t refs_bytes = allocator->handles_size * sizeof(gpalloc_handle_ref);
+	if (refs_bytes > 0)
+	{
+		state.refs = (gpalloc_handle_ref*)gpalloc_metadata_realloc(allocator, NULL, 0, refs_bytes);
+		if (!state.refs)
+			return 0;
+	}
+
+	uint32_t i;
+	for (i = 0; i < allocator->handles_size; i++)
+	{
+		if (allocator->handles[i].ptr == NULL)
+			continue;
+		state.refs[state.count].address = (uintptr_t)allocator->handles[i].ptr;
+		state.refs[state.count].index = i;
+		state.count++;
+	}
+	if (state.count > 1)
+		qsort(state.refs, state.count, sizeof(gpalloc_handle_ref), gpalloc_handle_ref_compare);
+
+	const int done = gpalloc_defragment_pass(allocator, budget, gpalloc_hcompact_move, gpalloc_hcompact_movable, &state);
+	gpalloc_metadata_realloc(allocator, state.refs, refs_bytes, 0);
+	return done;
+}
+
+#pragma endregion
+
+int gpalloc_verify(gpalloc_t* allocator)
+{
+	assert(allocator != NULL);
+	if (allocator->allocation_array_size == 0 && "Must have at least one block!")
+		return 0;
+	if (gpalloc_block_address(allocator, 0) != (uintptr_t)allocator->buffer && "First block must start at the buffer!")
+		return 0;
+
+	size_t free_blocks = 0;
+	size_t blocks_sum = 0;
+	size_t i;
+	for (i = 0; i < allocator->allocation_array_size; i++)
+	{
+		const gpalloc_allocation block = gpalloc_block_get(allocator, i);
+		if (block.size == 0 && "Must not have blocks of size 0!")
+			return 0;
+		if (block.size > allocator->buffer_size - blocks_sum && "Blocks can't be bigger than the buffer!")
+			return 0;
+		blocks_sum += block.size;
+
+		if (i + 1 < allocator->allocation_array_size)
+		{
+			const gpalloc_allocation next = gpalloc_block_get(allocator, i + 1);
+			// Implies ordered addresses without duplicates
+			if ((uintptr_t)gpalloc_offset_ptr(block.address, block.size) != (uintptr_t)next.address && "Blocks must be contiguous!")
+				return 0;
+			if (!block.used && !next.used && allocator->deferred_frees == 0 && "Free blocks must be merged!")
+				return 0;
+		}
+
+		if (block.used)
+			continue;
+		free_blocks++;
+
+		if (gpalloc_indexed(allocator))
+		{
+			uint32_t node;
+			uint16_t pos;
+			const gpalloc_index_key key = gpalloc_index_key_of(&block);
+			gpalloc_index_lower_bound(&allocator->free_index, key, &node, &pos);
+			if (node == GPALLOC_INDEX_NULL && "Free block must be in the index!")
+				return 0;
+			const gpalloc_index_key found = allocator->free_index.nodes[node].keys[pos];
+			if ((found.size != key.size || found.address != key.address) && "Free block must be in the index!")
+				return 0;
+		}
+	}
+	if (blocks_sum != allocator->buffer_size && "Blocks must cover the whole buffer!")
+		return 0;
+
+	if (gpalloc_indexed(allocator) && free_blocks != allocator->free_index.count && "Index must contain only free blocks!")
+		return 0;
+
+	if (allocator->address_map != NULL)
+	{
+		size_t page;
+		for (page = 0; page < allocator->address_map_pages; page++)
+		{
+			void* const page_start = gpalloc_offset_ptr(allocator->buffer, page << allocator->address_map_shift);
+			if (gpalloc_map_prefix(allocator, page) != gpalloc_lower_bound_in(allocator, page_start, 0, allocator->allocation_array_size) && "Address map must count the blocks before each page!")
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+#pragma region Heap
+
+/* A gpalloc over one backing region. */
+typedef struct gpalloc_heap_region {
+	gpalloc_t allocator;
+	/* Live allocations and their bytes, the region is empty at 0. */
+	size_t live;
+	size_t used_bytes;
+	/* Chained by the heap, 0 for the initial buffer of the caller. */
+	int owned;
+} gpalloc_heap_region;
+
+static void* gpalloc_heap_region_realloc(gpalloc_heap* heap, void* ptr, const size_t old_size, const size_t new_size)
+{
+	if (heap->options.region_realloc != NULL)
+		return heap->options.region_realloc(heap->options.region_user, ptr, old_size, new_size);
+#if GPALLOC_HEAP_MMAP
+	if (new_size == 0)
+	{
+		munmap(ptr, old_size);
+		return NULL;
+	}
+	assert(ptr == NULL && "Regions are never resized!");
+	ptr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+#else
+	if (new_size == 0)
+	{
+		free(ptr);
+		return NULL;
+	}
+	return realloc(ptr, new_size);
+#endif
+}
+
+/* The region array is metadata, it goes through the backing allocator of the options. */
+static void* gpalloc_heap_metadata_realloc(gpalloc_heap* heap, void* ptr, const size_t old_size, const size_t new_size)
+{
+	if (heap->options.allocator.metadata_realloc != NULL)
+		return heap->options.allocator.metadata_realloc(heap->options.allocator.metadata_user, ptr, old_size, new_size);
+	if (new_size == 0)
+	{
+		free(ptr);
+		return NULL;
+	}
+	return realloc(ptr, new_size);
+}
+
+/* Index of the region that contains ptr, regions_size when none does. */
+static size_t gpalloc_heap_find(const gpalloc_heap* heap, const void* ptr)
+{
+	const uintptr_t address = (uintptr_t)ptr;
+	size_t first = 0;
+	size_t count = heap->regions_size;
+	// Last region starting at or before the address
+	while (count > 0)
+	{
+		const size_t half = count / 2;
+		if ((uintptr_t)heap->regions[first + half].allocator.buffer <= address)
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	if (first == 0)
+		return heap->regions_size;
+	const gpalloc_t* const allocator = &heap->regions[first - 1].allocator;
+	return address - (uintptr_t)allocator->buffer < allocator->buffer_size ? first - 1 : heap->regions_size;
+}
+
+/* Adds a region in address order, returns its index or regions_size when out of memory. */
+static size_t gpalloc_heap_add_region(gpalloc_heap* heap, void* buffer, const size_t size, const int owned)
+{
+	if (heap->regions_size == heap->regions_capacity)
+	{
+		const size_t capacity = heap->regions_capacity ? heap->regions_capacity * 2 : 4;
+		gpalloc_heap_region* regions = (gpalloc_heap_region*)gpalloc_heap_metadata_realloc(heap, heap->regions, heap->regions_capacity * sizeof(gpalloc_heap_region), capacity * sizeof(gpalloc_heap_region));
+		if (regions == NULL)
+			return heap->regions_size;
+		heap->regions = regions;
+		heap->regions_capacity = capacity;
+	}
+
+	gpalloc_heap_region region;
+	memset((void*)&region, 0, sizeof(region));
+	region.owned = owned;
+	if (!gpalloc_initialize_ex(&region.allocator, buffer, size, &heap->options.allocator))
+	{
+		gpalloc_destroy(&region.allocator);
+		return heap->regions_size;
+	}
+
+	size_t index = heap->regions_size;
+	while (index > 0 && (uintptr_t)heap->regions[index - 1].allocator.buffer > (uintptr_t)buffer)
+		index--;
+	memmove(heap->regions + index + 1, heap->regions + index, (heap->regions_size - index) * sizeof(gpalloc_heap_region));
+	pun_cpy(&heap->regions[index], gpalloc_heap_region, &region);
+	heap->regions_size++;
+	if (heap->current >= index && heap->current < heap->regions_size - 1)
+		heap->current++;
+	return index;
+}
+
+/* Destroys the allocator of the region and gives its memory back. */
+static void gpalloc_heap_release_region(gpalloc_heap* heap, const size_t index)
+{
+	gpalloc_heap_region* const region = heap->regions + index;
+	assert(region->owned && region->live == 0);
+	void* const buffer = region->allocator.buffer;
+	const size_t size = region->allocator.buffer_size;
+	gpalloc_destroy(&region->allocator);
+	gpalloc_heap_region_realloc(heap, buffer, size, 0);
+
+	memmove(heap->regions + index, heap->regions + index + 1, (heap->regions_size - index - 1) * sizeof(gpalloc_heap_region));
+	heap->regions_size--;
+	if (heap->current > index)
+		heap->current--;
+	if (heap->current >= heap->regions_size)
+		heap->current = 0;
+}
+
+int gpalloc_heap_initialize(gpalloc_heap* heap, void* buffer, const size_t size, const gpalloc_heap_options* options)
+{
+	assert(heap != NULL);
+	memset((void*)heap, 0, sizeof(gpalloc_heap));
+	if (options != NULL)
+		heap->options = *options;
+	heap->next_region_size = heap->options.region_size ? heap->options.region_size : size;
+	if (heap->next_region_size == 0)
+		heap->next_region_size = GPALLOC_HEAP_GRANULARITY;
+
+	if (buffer == NULL)
+		return 1;
+	return gpalloc_heap_add_region(heap, buffer, size, 0) < heap->regions_size;
+}
+
+void gpalloc_heap_destroy(gpalloc_heap* heap)
+{
+	assert(heap != NULL);
+	size_t i;
+	for (i = 0; i < heap->regions_size; i++)
+	{
+		gpalloc_heap_region* const region = heap->regions + i;
+		void* const buffer = region->allocator.buffer;
+		const size_t size = region->allocator.buffer_size;
+		gpalloc_destroy(&region->allocator);
+		if (region->owned)
+			gpalloc_heap_region_realloc(heap, buffer, size, 0);
+	}
+	gpalloc_heap_metadata_realloc(heap, heap->regions, heap->regions_capacity * sizeof(gpalloc_heap_region), 0);
+	memset((void*)heap, 0, sizeof(gpalloc_heap));
+}
+
+/* Allocation from one region, with its bookkeeping. */
+static void* gpalloc_heap_region_malloc(gpalloc_heap_region* region, const size_t bytes, const size_t alignment)
+{
+	// Cheap reject, not enough free bytes at all
+	if (region->allocator.buffer_size - region->used_bytes < bytes)
+		return (void*)NULL;
+	void* ptr = gpalloc_malloc(&region->allocator, bytes, alignment);
+	if (ptr != NULL)
+	{
+		region->live++;
+		region->used_bytes += bytes;
+	}
+	return ptr;
+}
+
+void* gpalloc_heap_malloc(gpalloc_heap* heap, const size_t bytes, const size_t alignment)
+{
+	assert(heap != NULL);
+	void* ptr;
+	size_t i;
+
+	// The region of the last allocation first, then the others in address order
+	if (heap->current < heap->regions_size)
+	{
+		ptr = gpalloc_heap_region_malloc(heap->regions + heap->current, bytes, alignment);
+		if (ptr != NULL)
+			return ptr;
+	}
+	for (i = 0; i < heap->regions_size; i++)
+	{
+		if (i == heap->current)
+			continue;
+		ptr = gpalloc_heap_region_malloc(heap->regions + i, bytes, alignment);
+		if (ptr != NULL)
+		{
+			heap->current = i;
+			return ptr;
+		}
+	}
+
+	// Chain a region, big enough for the request with its worst alignment padding
+	const size_t needed = bytes + (alignment > 1 ? alignment - 1 : 0);
+	if (needed < bytes)
+		return (void*)NULL;
+	size_t size = needed > heap->next_region_size ? needed : heap->next_region_size;
+	if (size > SIZE_MAX - GPALLOC_HEAP_GRANULARITY)
+		return (void*)NULL;
+	size = (size + GPALLOC_HEAP_GRANULARITY - 1) / GPALLOC_HEAP_GRANULARITY * GPALLOC_HEAP_GRANULARITY;
+
+	void* buffer = gpalloc_heap_region_realloc(heap, NULL, 0, size);
+	if (buffer == NULL)
+		return (void*)NULL;
+	const size_t index = gpalloc_heap_add_region(heap, buffer, size, 1);
+	if (index == heap->regions_size)
+	{
+		gpalloc_heap_region_realloc(heap, buffer, size, 0);
+		return (void*)NULL;
+	}
+	if (heap->next_region_size <= GPALLOC_HEAP_MAX_REGION_SIZE / 2)
+		heap->next_region_size *= 2;
+
+	heap->current = index;
+	return gpalloc_heap_region_malloc(heap->regions + index, bytes, alignment);
+}
+
+/* Bookkeeping of a release from the region at index, the previous empty region goes back when another empties. */
+static void gpalloc_heap_region_released(gpalloc_heap* heap, size_t index, const size_t bytes)
+{
+	gpalloc_heap_region* const region = heap->regions + index;
+	assert(region->live > 0 && region->used_bytes >= bytes);
+	region->live--;
+	region->used_bytes -= bytes;
+	if (region->live > 0 || !region->owned)
+		return;
+
+	// Keeping one empty region avoids mapping and unmapping on every crossing of a region boundary
+	size_t i;
+	for (i = 0; i < heap->regions_size; i++)
+	{
+		if (i != index && heap->regions[i].owned && heap->regions[i].live == 0)
+		{
+			gpalloc_heap_release_region(heap, i);
+			break;
+		}
+	}
+}
+
+void gpalloc_heap_free(gpalloc_heap* heap, void* ptr)
+{
+	assert(heap != NULL);
+	assert(ptr != NULL);
+	const size_t index = gpalloc_heap_find(heap, ptr);
+	assert(index < heap->regions_size && "Pointer must be from the heap!");
+	if (index == heap->regions_size)
+		return;
+
+	gpalloc_t* const allocator = &heap->regions[index].allocator;
+	const size_t bytes = gpalloc_get_allocation_size(allocator, ptr);
+	gpalloc_free(allocator, ptr);
+	gpalloc_heap_region_released(heap, index, bytes);
+}
+
+void* gpalloc_heap_realloc(gpalloc_heap* heap, void* ptr, const size_t bytes, const size_t alignment)
+{
+	assert(heap != NULL);
+	if (ptr == NULL)
+		return gpalloc_heap_malloc(heap, bytes, alignment);
+	if (bytes == 0)
+	{
+		gpalloc_heap_free(heap, ptr);
+		return (void*)NULL;
+	}
+
+	const size_t index = gpalloc_heap_find(heap, ptr);
+	assert(index < heap->regions_size && "Pointer must be from the heap!");
+	gpalloc_heap_region* const region = heap->regions + index;
+	const size_t size = gpalloc_get_allocation_size(&region->allocator, ptr);
+
+	// In its region first, in place or moved there
+	void* moved = gpalloc_realloc(&region->allocator, ptr, bytes, alignment);
+	if (moved != NULL)
+	{
+		region->used_bytes = region->used_bytes - size + bytes;
+		return moved;
+	}
+
+	// Another region, on failure the original allocation is untouched
+	moved = gpalloc_heap_malloc(heap, bytes, alignment);
+	if (moved == NULL)
+		return (void*)NULL;
+	memcpy(moved, ptr, size < bytes ? size : bytes);
+	// The new allocation may have chained a region before this one
+	gpalloc_heap_free(heap, ptr);
+	return moved;
+}
+
+size_t gpalloc_heap_get_allocation_size(gpalloc_heap* heap, void* ptr)
+{
+	assert(heap != NULL);
+	const size_t index = gpalloc_heap_find(heap, ptr);
+	assert(index < heap->regions_size && "Pointer must be from the heap!");
+	return gpalloc_get_allocation_size(&heap->regions[index].allocator, ptr);
+}
+
+size_t gpalloc_heap_trim(gpalloc_heap* heap)
+{
+	assert(heap != NULL);
+	size_t released = 0;
+	size_t i = heap->regions_size;
+	while (i-- > 0)
+	{
+		if (heap->regions[i].owned && heap->regions[i].live == 0)
+		{
+			released += heap->regions[i].allocator.buffer_size;
+			gpalloc_heap_release_region(heap, i);
+		}
+	}
+	return released;
+}
+
+#pragma endregion
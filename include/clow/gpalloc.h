@@ -7,6 +7,9 @@
 // 
 // DESCRIPTION: A General purpose allocator with aligned allocations with first fit algorithm with binary search on heap allocated array of blocks.
 // Free after free detection assert.
+// The placement policy is chosen at initialization, see gpalloc_policy. Best, worst and hybrid fit keep a size
+// ordered B+tree index of the free blocks so the search only walks free blocks. Splitting and merging blocks still
+// shift the allocation array tail.
 // 
 // LICENSE: BSD-2
 // Copyright (c) 2025, Kirichenko Stanislav
@@ -36,9 +39,49 @@
 //
 // MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
 // 19 JAN 2025 ~ Kirichenko Stanislav ~ First version.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Free blocks size index.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Validation levels.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Realloc in place.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Metadata backing allocator.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Compact table layout with SIMD first fit.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Incremental defragmentation.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Relocatable handle allocations.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Address map for the pointer lookups.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Placement policies.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Deferred coalescing.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Growable heap of chained regions.
 //
 // USAGE ////////////////////////////////////////////////////////////////////////////////////
 //
+// The metadata can come from a preallocated block instead of the C library, any allocator with realloc semantics
+// works, here a freelist over a fixed buffer:
+// void* metadata(void* user, void* ptr, size_t old_size, size_t new_size)
+// {
+//     if (new_size == 0) { freelist_free((freelist_t*)user, ptr); return NULL; }
+//     return freelist_realloc((freelist_t*)user, ptr, new_size);
+// }
+// gpalloc_options options = { .metadata_realloc = metadata, .metadata_user = &metadata_freelist };
+// if (!gpalloc_initialize_ex(&allocator, buffer, size, &options)) { ... }
+//
+// Defragmentation moves the allocations, their owner gets a callback for each one:
+// void move(void* user, void* from, void* to, size_t size)
+// {
+//     memmove(to, from, size);
+//     remap_references((world*)user, from, to);
+// }
+// Once per frame, at most 1 MiB copied:
+// gpalloc_defragment(&allocator, 1 << 20, move, &world);
+//
+// Or the allocator moves the blocks itself when they are only reached through handles:
+// gpalloc_handle mesh = gpalloc_halloc(&allocator, size, 16);
+// upload((vertex*)gpalloc_resolve(&allocator, mesh));
+// gpalloc_hcompact(&allocator, 1 << 20);
+//
+// A heap grows past its first buffer with regions from mmap, or a callback, and gives them back once empty:
+// gpalloc_heap heap;
+// gpalloc_heap_initialize(&heap, buffer, common_case_size, NULL);
+// void* ptr = gpalloc_heap_malloc(&heap, size, 16);
+// gpalloc_heap_free(&heap, ptr);
 //
 // //////////////////////////////////////////////////////////////////////////////////////////
 
@@ -46,24 +89,201 @@
 #ifndef INCLUDED_GPALLOC
 #define INCLUDED_GPALLOC
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Validation level, define it before including to override:
+   0 no checks at all, the default with NDEBUG.
+   1 cheap O(1) invariants on every operation, the default without NDEBUG.
+   2 like 1 plus a full gpalloc_verify sweep every GPALLOC_VALIDATION_INTERVAL operations. */
+#ifndef GPALLOC_VALIDATION
+#ifdef NDEBUG
+#define GPALLOC_VALIDATION 0
+#else
+#define GPALLOC_VALIDATION 1
+#endif
+#endif
+
+/* Operations between two full sweeps with GPALLOC_VALIDATION 2, the O(n) sweep is amortized over them. */
+#ifndef GPALLOC_VALIDATION_INTERVAL
+#define GPALLOC_VALIDATION_INTERVAL 256
+#endif
+
+/* Biggest alignment gpalloc_defragment keeps when moving a block, the allocation alignment isn't stored so a block
+   keeps the alignment of its current address up to this power of two. */
+#ifndef GPALLOC_DEFRAGMENT_ALIGNMENT
+#define GPALLOC_DEFRAGMENT_ALIGNMENT 256
+#endif
+
+/* Fitting blocks best fit compares at most, in size order, before taking the one with the least waste. */
+#ifndef GPALLOC_BEST_FIT_CANDIDATES
+#define GPALLOC_BEST_FIT_CANDIDATES 8
+#endif
+
+/* Biggest request GPALLOC_HYBRID_FIT places with next fit, bigger ones use best fit. */
+#ifndef GPALLOC_HYBRID_SMALL_SIZE
+#define GPALLOC_HYBRID_SMALL_SIZE 256
+#endif
+
+/* Size of the quick reuse cache of options.deferred_coalescing, buckets hashed by size of ways freed blocks each. */
+#ifndef GPALLOC_REUSE_BUCKETS
+#define GPALLOC_REUSE_BUCKETS 64
+#endif
+#ifndef GPALLOC_REUSE_WAYS
+#define GPALLOC_REUSE_WAYS 4
+#endif
+
+/* Granularity of the regions gpalloc_heap chains, their sizes are rounded up to it. */
+#ifndef GPALLOC_HEAP_GRANULARITY
+#define GPALLOC_HEAP_GRANULARITY ((size_t)64 * 1024)
+#endif
+
+/* Every new region of a gpalloc_heap doubles the size of the previous one up to this, bigger requests still get a
+   region of their own size. */
+#ifndef GPALLOC_HEAP_MAX_REGION_SIZE
+#define GPALLOC_HEAP_MAX_REGION_SIZE ((size_t)1 << 30)
+#endif
+
+/* Layout of the blocks table, define it before including to override:
+   0 array of gpalloc_allocation, 16 bytes per block on 64 bit targets.
+   1 compact struct of arrays, 32 bit offsets from the buffer, 32 bit sizes and a used bitmap, a bit over 8 bytes per block.
+     First fit only reads the sizes and the bitmap, compared with AVX2 or SSE2 when the target has them, define
+     GPALLOC_NO_SIMD for the scalar search. Pools must be smaller than 4 GiB. */
+#ifndef GPALLOC_COMPACT_TABLE
+#define GPALLOC_COMPACT_TABLE 0
+#endif
+
 typedef struct {
 	void* address;
 	size_t size : sizeof(size_t) * 8 - 1;  // All bits except the most significant one
 	size_t used : 1;                       // 1-bit flag for "used" (MSB)
 } gpalloc_allocation;
 
+/* Backing allocator for the metadata. ptr NULL allocates, new_size 0 releases ptr (which can be NULL) and returns NULL,
+   otherwise resizes as realloc. Returning NULL means out of memory, ptr is left untouched and the operation that needed
+   the memory fails. */
+typedef void* (*gpalloc_metadata_realloc_fn)(void* user, void* ptr, size_t old_size, size_t new_size);
+
+/* Moves an allocation for gpalloc_defragment, the owner copies size bytes from from to to with memmove (they can
+   overlap) and updates its references. */
+typedef void (*gpalloc_move_fn)(void* user, void* from, void* to, size_t size);
+
+/* Where gpalloc_malloc places an allocation. */
+typedef enum {
+	/* Lowest address free block that fits, the default. Scans the table from the start of the buffer. */
+	GPALLOC_FIRST_FIT = 0,
+	/* Free block with the least waste, the alignment padding in front counts twice. Searches the free index. */
+	GPALLOC_BEST_FIT = 1,
+	/* First fit from where the previous allocation ended, wrapping around. Spreads the allocations over the buffer
+	   instead of piling the small ones at the start. */
+	GPALLOC_NEXT_FIT = 2,
+	/* Biggest free block, the remainders stay big. Searches the free index. */
+	GPALLOC_WORST_FIT = 3,
+	/* Next fit up to GPALLOC_HYBRID_SMALL_SIZE bytes, best fit above. Keeps the free index. */
+	GPALLOC_HYBRID_FIT = 4
+} gpalloc_policy;
+
+/* Options for gpalloc_initialize_ex, zero initialized options are the gpalloc_initialize defaults. */
+typedef struct {
+	/* Placement policy. The policies with a free index fall back to first fit if its nodes can't be allocated. */
+	gpalloc_policy policy;
+	/* Page size in bytes of the address map, a power of two, 0 disables it. The map counts the blocks starting in
+	   each page, so finding the block of a pointer only searches the blocks in its page instead of the whole table.
+	   Costs 4 bytes per page, updates and lookups are O(log pages). */
+	size_t address_map_page;
+	/* gpalloc_free leaves the block unmerged and remembers it by size, a gpalloc_malloc of the same size and a
+	   compatible alignment takes it back without splitting or shifting the table. Adjacent free blocks are merged
+	   by gpalloc_collect, called explicitly, when an allocation fails, before defragmenting and by gpalloc_free once
+	   the pending frees outnumber both the cache and an eighth of the table. */
+	int deferred_coalescing;
+	/* Memory for the allocation array and the index nodes, NULL uses the C library. */
+	gpalloc_metadata_realloc_fn metadata_realloc;
+	void* metadata_user;
+} gpalloc_options;
+
+/* Handle of a relocatable allocation, the generation in the high 32 bits and the table index in the low 32 bits.
+   Generations start at 1 so a valid handle is never GPALLOC_NULL_HANDLE. */
+typedef uint64_t gpalloc_handle;
+#define GPALLOC_NULL_HANDLE ((gpalloc_handle)0)
+
+/* Size ordered B+tree over the free blocks, keyed by size then address.
+   Nodes live in a growable array and are referenced by index so they survive reallocation. */
+typedef struct {
+	struct gpalloc_index_node* nodes;
+	uint32_t nodes_size;
+	uint32_t nodes_capacity;
+	/* Root node or GPALLOC_INDEX_NULL when empty. */
+	uint32_t root;
+	/* Linked list of released nodes to recycle. */
+	uint32_t free_node;
+	/* Number of free blocks in the index. */
+	size_t count;
+} gpalloc_free_index;
+
 /* Defines the freelist allocator. free_block is a linked list of free blocks or null if there aren't free blocks. */
 typedef struct {
 	void* buffer;
 	size_t buffer_size;
 	/* The addresses must be ordered for binary search*/
+#if GPALLOC_COMPACT_TABLE
+	uint32_t* block_offsets;
+	uint32_t* block_sizes;
+	/* Bit i % 64 of word i / 64 is set when block i is used. */
+	uint64_t* block_used;
+#else
 	gpalloc_allocation* allocation_array;
+#endif
 	size_t allocation_array_size;
 	size_t allocation_array_capacity;
+	gpalloc_options options;
+	gpalloc_free_index free_index;
+	/* Dense table of the handle allocations, a free slot keeps the index of the next free one. */
+	struct gpalloc_handle_entry* handles;
+	uint32_t handles_size;
+	uint32_t handles_capacity;
+	uint32_t handles_free;
+	/* Fenwick tree of the number of blocks starting in each page, address_map_pages + 1 entries with the first
+	   unused. NULL without options.address_map_page. */
+	uint32_t* address_map;
+	size_t address_map_pages;
+	unsigned int address_map_shift;
+	/* Quick reuse cache of the deferred frees, NULL without options.deferred_coalescing. */
+	struct gpalloc_reuse_entry* reuse_cache;
+	/* Frees since the last gpalloc_collect, their blocks may be next to other free blocks. */
+	size_t deferred_frees;
+	/* Offset from the buffer where the next fit search starts. */
+	size_t next_fit_cursor;
+	/* Offset from the buffer where the next gpalloc_defragment continues its pass. */
+	size_t defragment_cursor;
+	/* Operations since the last full sweep, used only with GPALLOC_VALIDATION 2. */
+	size_t validation_counter;
 } gpalloc;
 
+/* Options for gpalloc_heap_initialize, zero initialized options are the defaults. */
+typedef struct {
+	/* Options of the allocator of every region. */
+	gpalloc_options allocator;
+	/* Backing regions, called with ptr NULL to get one of new_size bytes and with new_size 0 to release ptr of
+	   old_size bytes. NULL maps them with mmap, or takes them from the C library where there is no mmap. */
+	gpalloc_metadata_realloc_fn region_realloc;
+	void* region_user;
+	/* Size of the first chained region, 0 is the size of the initial buffer. */
+	size_t region_size;
+} gpalloc_heap_options;
+
+/* Growable heap, a gpalloc per region. The regions are kept sorted by address so a pointer finds its region with a
+   binary search, sizes grow geometrically so there are few of them. */
+typedef struct {
+	struct gpalloc_heap_region* regions;
+	size_t regions_size;
+	size_t regions_capacity;
+	gpalloc_heap_options options;
+	/* Size of the next chained region. */
+	size_t next_region_size;
+	/* Region of the last allocation, tried first. */
+	size_t current;
+} gpalloc_heap;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -73,6 +293,10 @@ extern "C" {
 	/* Initialize the allocator. */
 	void gpalloc_initialize(gpalloc_t* allocator, void* buffer, const size_t poolSize);
 
+	/* Initialize the allocator with options, options can be NULL for defaults. Returns 0 when the metadata can't be
+	   allocated, the allocator is then empty and every gpalloc_malloc fails, gpalloc_destroy is still required. */
+	int gpalloc_initialize_ex(gpalloc_t* allocator, void* buffer, const size_t poolSize, const gpalloc_options* options);
+
 	/* Deinitialize the allocator. */
 	void gpalloc_destroy(gpalloc_t* allocator);
 
@@ -82,6 +306,67 @@ extern "C" {
 	/* Release memory back to the allocator. */
 	void gpalloc_free(gpalloc_t* allocator, void* ptr);
 
+	/* Merges the adjacent free blocks left by the deferred frees in one pass over the table and empties the reuse
+	   cache. Returns the number of merges, 0 without options.deferred_coalescing. */
+	size_t gpalloc_collect(gpalloc_t* allocator);
+
+	/* Returns the size of the allocation at ptr, the bytes requested for it. */
+	size_t gpalloc_get_allocation_size(gpalloc_t* allocator, void* ptr);
+
+	/* Resizes an allocation, in place when shrinking or when the next block is free and big enough, otherwise moves it.
+	   ptr NULL behaves as gpalloc_malloc and bytes 0 as gpalloc_free. Returns NULL on failure, ptr is still valid then. */
+	void* gpalloc_realloc(gpalloc_t* allocator, void* ptr, const size_t bytes, const size_t alignment);
+
+	/* Slides used blocks down into the free block before them, so the free space gathers at the end of the buffer.
+	   move is called for every block before the table changes. Incremental, a call moves at most budget bytes (0 is
+	   no limit) and the next call continues where it stopped, blocks bigger than the budget stay in place.
+	   Returns 1 when the pass reached the end of the buffer, the next call starts a new pass, 0 when the budget ran
+	   out or the metadata couldn't grow. */
+	int gpalloc_defragment(gpalloc_t* allocator, const size_t budget, gpalloc_move_fn move, void* user);
+
+	/* Allocates a relocatable block, the address comes from gpalloc_resolve and is only valid until the next
+	   gpalloc_hcompact. Returns GPALLOC_NULL_HANDLE when the block or the handle slot can't be allocated. */
+	gpalloc_handle gpalloc_halloc(gpalloc_t* allocator, const size_t bytes, const size_t alignment);
+
+	/* Current address of a handle allocation, one indexed load. NULL for a released or never allocated handle. */
+	void* gpalloc_resolve(const gpalloc_t* allocator, const gpalloc_handle handle);
+
+	/* Release a handle allocation, the handle and its copies resolve to NULL from now on. */
+	void gpalloc_hfree(gpalloc_t* allocator, const gpalloc_handle handle);
+
+	/* gpalloc_defragment of the handle allocations only, the allocator moves them itself and the raw allocations
+	   stay in place. Same budget and return value. Returns 0 without moving when the scratch metadata can't be
+	   allocated. */
+	int gpalloc_hcompact(gpalloc_t* allocator, const size_t budget);
+
+	/* Initialize a heap over buffer, which stays owned by the caller and is never released. buffer NULL starts
+	   without regions, the first allocation chains one. options can be NULL for defaults. Returns 0 when the
+	   metadata can't be allocated, gpalloc_heap_destroy is still required. */
+	int gpalloc_heap_initialize(gpalloc_heap* heap, void* buffer, const size_t size, const gpalloc_heap_options* options);
+
+	/* Releases every chained region and the metadata. */
+	void gpalloc_heap_destroy(gpalloc_heap* heap);
+
+	/* Allocates from the regions, chains a new one when none has room. NULL when the region can't be obtained. */
+	void* gpalloc_heap_malloc(gpalloc_heap* heap, const size_t bytes, const size_t alignment);
+
+	/* Release memory back to its region. A chained region left empty is kept while it's the only empty one, the
+	   previous empty one is released. */
+	void gpalloc_heap_free(gpalloc_heap* heap, void* ptr);
+
+	/* gpalloc_realloc in the region of ptr, moving to another region when it has no room. */
+	void* gpalloc_heap_realloc(gpalloc_heap* heap, void* ptr, const size_t bytes, const size_t alignment);
+
+	/* Returns the size of the allocation at ptr. */
+	size_t gpalloc_heap_get_allocation_size(gpalloc_heap* heap, void* ptr);
+
+	/* Releases every empty chained region, returns the bytes given back. */
+	size_t gpalloc_heap_trim(gpalloc_heap* heap);
+
+	/* Full sweep of the metadata, blocks must be ordered, contiguous, cover the whole buffer, free blocks merged
+	   and the free index in sync. O(n log n), available at any validation level. Success is 1 while 0 is error. */
+	int gpalloc_verify(gpalloc_t* allocator);
+
 #if defined(__cplusplus)
 };
 #endif
@@ -0,0 +1,246 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: pool.c
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+#include "clow/pool.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define POOL_TAG_SHIFT 32
+#define POOL_INDEX_MASK 0xFFFFFFFFu
+#define POOL_MAX_BLOCKS ((size_t)0xFFFFFFFEu)
+
+/* Atomics over plain integers keep the header ANSI C, acquire and release orders are enough for the stack. */
+#if defined(_MSC_VER) && !defined(__clang__)
+
+static uint64_t pool_load_head(volatile uint64_t* head)
+{
+	// 64-bit aligned volatile reads are atomic and have acquire semantics on MSVC targets
+	return *head;
+}
+
+static int pool_cas_head(volatile uint64_t* head, uint64_t* expected, uint64_t desired)
+{
+	const uint64_t previous = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)head, (__int64)desired, (__int64)*expected);
+	if (previous == *expected)
+		return 1;
+	*expected = previous;
+	return 0;
+}
+
+static uint32_t pool_load_next(const void* block)
+{
+	return *(const volatile uint32_t*)block;
+}
+
+static void pool_store_next(void* block, uint32_t next)
+{
+	*(volatile uint32_t*)block = next;
+}
+
+#elif defined(__GNUC__) || defined(__clang__)
+
+static uint64_t pool_load_head(volatile uint64_t* head)
+{
+	return __atomic_load_n(head, __ATOMIC_ACQUIRE);
+}
+
+static int pool_cas_head(volatile uint64_t* head, uint64_t* expected, uint64_t desired)
+{
+	return __atomic_compare_exchange_n(head, expected, desired, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/* The next index of a block popped by another thread meanwhile can be read racing with its new owner,
+   the value is then discarded because the tag changed. */
+static uint32_t pool_load_next(const void* block)
+{
+	return __atomic_load_n((const uint32_t*)block, __ATOMIC_RELAXED);
+}
+
+static void pool_store_next(void* block, uint32_t next)
+{
+	__atomic_store_n((uint32_t*)block, next, __ATOMIC_RELAXED);
+}
+
+#else
+#error "pool needs 64-bit compare and swap, add the intrinsics of this compiler"
+#endif
+
+static void* pool_block_at(pool* const allocator, uint32_t index)
+{
+	return (void*)(((uintptr_t)allocator->blocks) + (size_t)index * allocator->block_size);
+}
+
+static uint64_t pool_pack(uint64_t tag, uint32_t top)
+{
+	return (tag << POOL_TAG_SHIFT) | top;
+}
+
+size_t pool_min_block_size(void) {
+	return sizeof(uint32_t);
+}
+
+static size_t pool_round_block_size(size_t block_size) {
+	if (block_size < pool_min_block_size())
+		block_size = pool_min_block_size();
+	return (block_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+}
+
+size_t pool_buffer_size(size_t block_size, size_t count) {
+	return pool_round_block_size(block_size) * count + sizeof(void*) - 1;
+}
+
+void pool_initialize(pool_t* allocator, void* buffer, size_t buffer_size, size_t block_size) {
+	uintptr_t first;
+	assert(allocator != NULL);
+	assert(buffer != NULL);
+
+	allocator->buffer = buffer;
+	allocator->buffer_size = buffer_size;
+	allocator->block_size = pool_round_block_size(block_size);
+
+	// Blocks are word aligned, skip the unaligned start of the buffer
+	first = ((uintptr_t)buffer + sizeof(void*) - 1) & ~(uintptr_t)(sizeof(void*) - 1);
+	allocator->blocks = (void*)first;
+	allocator->block_count = 0;
+	if (first - (uintptr_t)buffer < buffer_size)
+		allocator->block_count = (buffer_size - (size_t)(first - (uintptr_t)buffer)) / allocator->block_size;
+	if (allocator->block_count > POOL_MAX_BLOCKS)
+		allocator->block_count = POOL_MAX_BLOCKS;
+
+	pool_reset(allocator);
+}
+
+void pool_reset(pool_t* allocator) {
+	size_t i;
+	assert(allocator != NULL);
+
+	// Link every block to the following one, the last one ends the stack
+	for (i = 0; i < allocator->block_count; i++)
+		pool_store_next(pool_block_at(allocator, (uint32_t)i), i + 1 < allocator->block_count ? (uint32_t)(i + 2) : 0u);
+
+	allocator->head = pool_pack(0, allocator->block_count ? 1u : 0u);
+	assert(pool_verify_corruption(allocator) == 1);
+}
+
+void* pool_alloc(pool_t* allocator) {
+	uint64_t head;
+	uint64_t next_head;
+	uint32_t top;
+	void* block;
+	assert(allocator != NULL);
+
+	head = pool_load_head(&allocator->head);
+	for (;;)
+	{
+		top = (uint32_t)(head & POOL_INDEX_MASK);
+		if (top == 0)
+		{
+			//Requesting more blocks than available
+			return NULL;
+		}
+		block = pool_block_at(allocator, top - 1);
+		next_head = pool_pack((head >> POOL_TAG_SHIFT) + 1, pool_load_next(block));
+		if (pool_cas_head(&allocator->head, &head, next_head))
+			return block;
+	}
+}
+
+int pool_range_check(pool_t* allocator, void* ptr) {
+	return (uintptr_t)ptr >= (uintptr_t)allocator->blocks
+		&& (uintptr_t)ptr < (uintptr_t)allocator->blocks + allocator->block_count * allocator->block_size;
+}
+
+void pool_free(pool_t* allocator, void* ptr) {
+	uint64_t head;
+	uint64_t next_head;
+	uint32_t index;
+	assert(allocator != NULL);
+
+	if (!ptr)
+		return;
+
+	// Do nothing if pointer is outside the blocks range
+	if (!pool_range_check(allocator, ptr))
+		return;
+	assert(((uintptr_t)ptr - (uintptr_t)allocator->blocks) % allocator->block_size == 0 && "Pointer must be the start of a block!");
+
+	index = (uint32_t)(((uintptr_t)ptr - (uintptr_t)allocator->blocks) / allocator->block_size) + 1;
+	head = pool_load_head(&allocator->head);
+	do
+	{
+		assert((uint32_t)(head & POOL_INDEX_MASK) != index && "Block already on top of the stack, pointer was already released");
+		pool_store_next(ptr, (uint32_t)(head & POOL_INDEX_MASK));
+		next_head = pool_pack((head >> POOL_TAG_SHIFT) + 1, index);
+	} while (!pool_cas_head(&allocator->head, &head, next_head));
+}
+
+size_t pool_count_free(pool_t* allocator) {
+	size_t count;
+	uint32_t top;
+	assert(allocator != NULL);
+
+	count = 0;
+	top = (uint32_t)(allocator->head & POOL_INDEX_MASK);
+	while (top != 0 && count <= allocator->block_count)
+	{
+		top = pool_load_next(pool_block_at(allocator, top - 1));
+		count++;
+	}
+	return count;
+}
+
+int pool_verify_corruption(pool_t* allocator) {
+	size_t count;
+	uint32_t top;
+	assert(allocator != NULL);
+
+	count = 0;
+	top = (uint32_t)(allocator->head & POOL_INDEX_MASK);
+	while (top != 0)
+	{
+		// This could mean that externally a released block has been written after the free.
+		if (top > allocator->block_count && "Next index outside the pool!")
+			return 0;
+		if (++count > allocator->block_count && "Cycle in the free stack, a block was released twice!")
+			return 0;
+		top = pool_load_next(pool_block_at(allocator, top - 1));
+	}
+	return 1;
+}
@@ -0,0 +1,125 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: pool.h
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// DESCRIPTION: A lock-free pool of fixed size blocks over an externally allocated buffer,
+// the sibling of freelist for objects of a single size (particles, components, jobs).
+// Free blocks form an intrusive Treiber stack, each free block keeps the index of the next one
+// in its first bytes. The head packs the top block index with a version tag in a single 64-bit
+// word, every push and pop bumps the tag so a compare-and-swap over a stale head fails (no ABA).
+// Any number of threads can pool_alloc and pool_free concurrently, the others functions are not
+// thread safe. Up to 2^32 - 2 blocks.
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ First version.
+//
+// USAGE ////////////////////////////////////////////////////////////////////////////////////
+//
+// We want 100 blocks of 48 bytes
+// void* mem;
+// size_t size;
+// size = pool_buffer_size(48, 100);
+// mem = malloc(size);
+//
+// Initialize the pool now
+// pool_t pool;
+// pool_initialize(&pool, mem, size, 48);
+//
+// From any thread
+// void* element;
+// element = pool_alloc(&pool);
+// pool_free(&pool, element);
+//
+// Once done with the pool free the buffer
+// free(mem);
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INCLUDED_POOL
+#define INCLUDED_POOL
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines the pool allocator. */
+typedef struct {
+	void* buffer;
+	size_t buffer_size;
+	/* First block, the buffer start aligned to the word size. */
+	void* blocks;
+	size_t block_size;
+	size_t block_count;
+	/* Version tag in the high 32 bits, top block index + 1 in the low 32 bits, 0 when empty.
+	   Only accessed atomically. */
+	volatile uint64_t head;
+} pool;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+	typedef pool pool_t;
+
+	/* Minimum block size, the size of the next index. Block sizes are rounded up to the word size. */
+	size_t pool_min_block_size(void);
+
+	/* Buffer size needed for count blocks of block_size bytes, including the worst alignment padding. */
+	size_t pool_buffer_size(size_t block_size, size_t count);
+
+	/* Initialize the pool, all the blocks that fit in the buffer are free. */
+	void pool_initialize(pool_t* allocator, void* buffer, size_t buffer_size, size_t block_size);
+
+	/* Makes all the blocks free again, not thread safe. */
+	void pool_reset(pool_t* allocator);
+
+	/* Allocates a block, NULL when the pool is exhausted. Lock-free. */
+	void* pool_alloc(pool_t* allocator);
+
+	/* Release a block back to the pool. Lock-free. */
+	void pool_free(pool_t* allocator, void* ptr);
+
+	/* Check if a pointer is in the blocks range. */
+	int pool_range_check(pool_t* allocator, void* ptr);
+
+	/* Counts the free blocks walking the stack, not thread safe. */
+	size_t pool_count_free(pool_t* allocator);
+
+	/* Sanity check, to verify if the pool metadata still has sense, not thread safe. Success is 1 while 0 is error. */
+	int pool_verify_corruption(pool_t* allocator);
+
+#if defined(__cplusplus)
+};
+#endif
+
+
+#endif /*INCLUDED_POOL*/
@@ -0,0 +1,198 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: ring.c
+//
+// AUTHOR: Kirichenko Stanislav
+//
+// DATE: 16 OCT 2026
+//
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+#include "clow/ring.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/* Where count elements aligned go after head, with the elements consumed including the skipped end.
+   RING_INVALID_OFFSET when they don't fit between head and tail. */
+static size_t
+ring_fit(const size_t capacity, const size_t head, const size_t tail, const int empty, const size_t count,
+         const size_t alignment, size_t* consumed)
+{
+    const size_t aligned = (head + (alignment - 1)) & ~(alignment - 1);
+
+    if (count == 0 || count > capacity)
+        return RING_INVALID_OFFSET;
+
+    if (empty || head > tail)
+    {
+        // Free are [head, capacity) and [0, tail)
+        if (aligned >= head && aligned <= capacity && count <= capacity - aligned)
+        {
+            *consumed = aligned - head + count;
+            return aligned;
+        }
+        // Never straddle the end, skip it and start over
+        if (count <= (empty ? capacity : tail))
+        {
+            *consumed = capacity - head + count;
+            return 0;
+        }
+    }
+    else if (head < tail)
+    {
+        if (aligned >= head && aligned <= tail && count <= tail - aligned)
+        {
+            *consumed = aligned - head + count;
+            return aligned;
+        }
+    }
+    return RING_INVALID_OFFSET;
+}
+
+void
+ring_initialize(ring_allocator* allocator, const size_t capacity)
+{
+    assert(allocator != NULL);
+    assert(capacity > 0);
+    allocator->capacity    = capacity;
+    allocator->head        = 0;
+    allocator->tail        = 0;
+    allocator->allocated   = 0;
+    allocator->retired     = 0;
+    allocator->fence_first = 0;
+    allocator->fence_count = 0;
+}
+
+size_t
+ring_alloc(ring_allocator* allocator, const size_t count, const size_t alignment)
+{
+    size_t consumed = 0;
+    size_t offset;
+    assert(allocator != NULL);
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+    offset = ring_fit(allocator->capacity, allocator->head, allocator->tail, ring_used(allocator) == 0, count,
+                      alignment ? alignment : 1, &consumed);
+    if (offset == RING_INVALID_OFFSET)
+        return RING_INVALID_OFFSET;
+
+    allocator->head = offset + count;
+    allocator->allocated += consumed;
+    assert(ring_used(allocator) <= allocator->capacity);
+    return offset;
+}
+
+int
+ring_fence(ring_allocator* allocator, const uint64_t fence)
+{
+    ring_fence_record* record;
+    assert(allocator != NULL);
+
+    // Nothing new to release with this fence
+    if (allocator->fence_count > 0)
+    {
+        const ring_fence_record* last = &allocator->fences[(allocator->fence_first + allocator->fence_count - 1) % RING_MAX_FENCES];
+        assert(fence > last->fence && "Fence ids must increase!");
+        if (last->allocated == allocator->allocated)
+            return 1;
+    }
+    else if (allocator->retired == allocator->allocated)
+    {
+        return 1;
+    }
+
+    if (allocator->fence_count == RING_MAX_FENCES)
+        return 0;
+
+    record            = &allocator->fences[(allocator->fence_first + allocator->fence_count) % RING_MAX_FENCES];
+    record->fence     = fence;
+    record->head      = allocator->head;
+    record->allocated = allocator->allocated;
+    allocator->fence_count++;
+    return 1;
+}
+
+void
+ring_retire(ring_allocator* allocator, const uint64_t completed_fence)
+{
+    assert(allocator != NULL);
+
+    while (allocator->fence_count > 0 && allocator->fences[allocator->fence_first].fence <= completed_fence)
+    {
+        const ring_fence_record* record = &allocator->fences[allocator->fence_first];
+        allocator->tail    = record->head;
+        allocator->retired = record->allocated;
+        allocator->fence_first = (allocator->fence_first + 1) % RING_MAX_FENCES;
+        allocator->fence_count--;
+    }
+
+    // Start over from the beginning once empty, the next ranges won't need to skip the end
+    if (allocator->retired == allocator->allocated)
+    {
+        allocator->head = 0;
+        allocator->tail = 0;
+    }
+}
+
+size_t
+ring_used(const ring_allocator* allocator)
+{
+    assert(allocator != NULL);
+    return (size_t)(allocator->allocated - allocator->retired);
+}
+
+ring_wait
+ring_wait_fence(const ring_allocator* allocator, const size_t count, const size_t alignment, uint64_t* fence)
+{
+    size_t consumed;
+    size_t i;
+    assert(allocator != NULL);
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+    if (ring_fit(allocator->capacity, allocator->head, allocator->tail, ring_used(allocator) == 0, count,
+                 alignment ? alignment : 1, &consumed) != RING_INVALID_OFFSET)
+        return RING_WAIT_NONE;
+
+    // Replay the retirements in order until it fits, at most RING_MAX_FENCES steps
+    for (i = 0; i < allocator->fence_count; i++)
+    {
+        const ring_fence_record* record = &allocator->fences[(allocator->fence_first + i) % RING_MAX_FENCES];
+        const int empty = record->allocated == allocator->allocated;
+        const size_t tail = empty ? 0 : record->head;
+        const size_t head = empty ? 0 : allocator->head;
+
+        if (ring_fit(allocator->capacity, head, tail, empty, count, alignment ? alignment : 1, &consumed) != RING_INVALID_OFFSET)
+        {
+            if (fence)
+                *fence = record->fence;
+            return RING_WAIT_FENCE;
+        }
+    }
+    return RING_WAIT_NEVER;
+}
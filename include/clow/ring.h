@@ -0,0 +1,139 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: ring.h
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// DESCRIPTION: A index based ring allocator for streaming data (uploads, staging).
+// Ranges are carved in order from a contiguous index space and released in FIFO order by
+// fence: ring_fence tags everything allocated since the previous fence with an increasing id,
+// and ring_retire releases all the ranges of the completed fences. A range never straddles the
+// end of the space, the unused end is skipped and released with the range that follows it.
+// There is no fragmentation, ring_wait_fence tells which fence gives room for a request.
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ First version.
+//
+// USAGE ////////////////////////////////////////////////////////////////////////////////////
+//
+// ring_allocator ring;
+// ring_initialize(&ring, staging_buffer_size);
+//
+// Loader thread, before reading the next asset
+// uint64_t fence;
+// if (ring_wait_fence(&ring, asset_size, 16, &fence) == RING_WAIT_FENCE)
+//     wait_gpu_fence(fence);
+// size_t offset = ring_alloc(&ring, asset_size, 16);
+// read_file(staging_buffer + offset, asset_size);
+// ring_fence(&ring, submitted_fence_id);
+//
+// Once the gpu completed a fence
+// ring_retire(&ring, completed_fence_id);
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INCLUDED_RING
+#define INCLUDED_RING
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returned by ring_alloc when there is no room. */
+#define RING_INVALID_OFFSET ((size_t)-1)
+
+/* Fences not retired yet, frames or submissions in flight. */
+#ifndef RING_MAX_FENCES
+#define RING_MAX_FENCES 64
+#endif
+
+/* ring_wait_fence results. */
+typedef enum {
+	/* The request fits now. */
+	RING_WAIT_NONE = 0,
+	/* The request fits once the returned fence is retired. */
+	RING_WAIT_FENCE = 1,
+	/* Retiring every fence is not enough, the request is bigger than the space or waits on unfenced ranges. */
+	RING_WAIT_NEVER = 2
+} ring_wait;
+
+/* Ranges allocated before a fence, released together. */
+typedef struct {
+	uint64_t fence;
+	/* Head when the fence was placed, the tail once retired. */
+	size_t head;
+	/* Value of allocated when the fence was placed. */
+	uint64_t allocated;
+} ring_fence_record;
+
+/* Defines the ring allocator, all the ranges in flight are between tail and head. */
+typedef struct {
+	size_t capacity;
+	size_t head;
+	size_t tail;
+	/* Running totals of allocated and released elements, skipped ends included. In flight is the difference. */
+	uint64_t allocated;
+	uint64_t retired;
+	/* Fences in order, a circular queue. */
+	ring_fence_record fences[RING_MAX_FENCES];
+	size_t fence_first;
+	size_t fence_count;
+} ring_allocator;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+	/* Initialize the allocator over capacity elements. */
+	void ring_initialize(ring_allocator* allocator, const size_t capacity);
+
+	/* Allocates count contiguous elements at an offset multiple of alignment (a power of two, 0 is 1).
+	   RING_INVALID_OFFSET when there is no room. */
+	size_t ring_alloc(ring_allocator* allocator, const size_t count, const size_t alignment);
+
+	/* Tags the ranges allocated since the previous fence, fence ids must increase. Returns 0 when RING_MAX_FENCES
+	   fences are in flight, the ranges are then tagged by the next successful call. */
+	int ring_fence(ring_allocator* allocator, const uint64_t fence);
+
+	/* Releases the ranges of all the fences up to completed_fence included. */
+	void ring_retire(ring_allocator* allocator, const uint64_t completed_fence);
+
+	/* Elements in flight, skipped ends included. */
+	size_t ring_used(const ring_allocator* allocator);
+
+	/* Which fence must be retired before count elements can be allocated, set in fence for RING_WAIT_FENCE. */
+	ring_wait ring_wait_fence(const ring_allocator* allocator, const size_t count, const size_t alignment, uint64_t* fence);
+
+#if defined(__cplusplus)
+};
+#endif
+
+
+#endif /*INCLUDED_RING*/
@@ -41,8 +41,317 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define SLICE_INDEX_NULL 0xFFFFFFFFu
+
+/* A free slice in the size index, the key is count then offset. Priorities keep the treap balanced in expectation. */
+typedef struct slice_index_node {
+    slice_offset_t count;
+    slice_offset_t offset;
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+} slice_index_node;
+
+static int
+slice_index_less(const size_t count_a, const size_t offset_a, const size_t count_b, const size_t offset_b)
+{
+    return count_a < count_b || (count_a == count_b && offset_a < offset_b);
+}
+
+/* Offsets are unique so a hash of them is a deterministic pseudo random priority. */
+static uint32_t
+slice_index_priority(const size_t offset)
+{
+    uint64_t x = (uint64_t)offset * 0x9E3779B97F4A7C15ull;
+    x ^= x >> 29;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 32;
+    return (uint32_t)x;
+}
+
+/* All the metadata memory goes through here, the callback of the options or the C library. new_size 0 releases. */
+static void*
+slice_metadata_call(const slice_metadata_realloc_fn metadata_realloc, void* user, void* ptr, const size_t old_size, const size_t new_size)
+{
+    if (metadata_realloc != NULL)
+        return metadata_realloc(user, ptr, old_size, new_size);
+    if (new_size == 0)
+        {
+            free(ptr);
+            return NULL;
+        }
+    return realloc(ptr, new_size);
+}
+
+static void*
+slice_metadata_realloc(slice_allocator* allocator, void* ptr, const size_t old_size, const size_t new_size)
+{
+    return slice_metadata_call(allocator->metadata_realloc, allocator->metadata_user, ptr, old_size, new_size);
+}
+
+/* Make room for n new nodes, so an update can't fail halfway. */
+static bool
+slice_index_reserve(slice_allocator* allocator, const uint32_t n)
+{
+    if (allocator->index_nodes_capacity - allocator->index_nodes_size >= n)
+        return true;
+
+    uint32_t new_capacity = allocator->index_nodes_capacity ? allocator->index_nodes_capacity * 2 : 8;
+    while (new_capacity - allocator->index_nodes_size < n)
+        new_capacity *= 2;
+
+    slice_index_node* new_nodes = (slice_index_node*)slice_metadata_realloc(allocator, allocator->index_nodes, allocator->index_nodes_capacity * sizeof(slice_index_node), new_capacity * sizeof(slice_index_node));
+    if (!new_nodes)
+        return false;
+    allocator->index_nodes          = new_nodes;
+    allocator->index_nodes_capacity = new_capacity;
+    return true;
+}
+
+/* Split subtree t in keys less than key and keys not less than key. */
+static void
+slice_index_split(slice_index_node* nodes, const uint32_t t, const size_t count, const size_t offset, uint32_t* left, uint32_t* right)
+{
+    if (t == SLICE_INDEX_NULL)
+        {
+            *left  = SLICE_INDEX_NULL;
+            *right = SLICE_INDEX_NULL;
+            return;
+        }
+
+    if (slice_index_less(nodes[t].count, nodes[t].offset, count, offset))
+        {
+            slice_index_split(nodes, nodes[t].right, count, offset, &nodes[t].right, right);
+            *left = t;
+        }
+    else
+        {
+            slice_index_split(nodes, nodes[t].left, count, offset, left, &nodes[t].left);
+            *right = t;
+        }
+}
+
+/* Merge two subtrees where all keys of a are less than keys of b. */
+static uint32_t
+slice_index_merge(slice_index_node* nodes, const uint32_t a, const uint32_t b)
+{
+    if (a == SLICE_INDEX_NULL)
+        return b;
+    if (b == SLICE_INDEX_NULL)
+        return a;
+
+    if (nodes[a].priority > nodes[b].priority)
+        {
+            nodes[a].right = slice_index_merge(nodes, nodes[a].right, b);
+            return a;
+        }
+    nodes[b].left = slice_index_merge(nodes, a, nodes[b].left);
+    return b;
+}
+
+/* Track a free slice, a node must have been reserved. */
+static void
+slice_index_add(slice_allocator* allocator, const slice_t slice)
+{
+    if (allocator->policy != SLICE_POLICY_BEST_FIT)
+        return;
+
+    uint32_t node;
+    if (allocator->index_free_node != SLICE_INDEX_NULL)
+        {
+            node                       = allocator->index_free_node;
+            allocator->index_free_node = allocator->index_nodes[node].left;
+        }
+    else
+        {
+            assert(allocator->index_nodes_size < allocator->index_nodes_capacity && "Nodes must be reserved before adding!");
+            node = allocator->index_nodes_size++;
+        }
+
+    slice_index_node* nodes = allocator->index_nodes;
+    nodes[node].count       = slice.count;
+    nodes[node].offset      = slice.offset;
+    nodes[node].priority    = slice_index_priority(slice.offset);
+
+    // Descend while the priorities are higher, then the new node takes the place of the subtree
+    uint32_t* link = &allocator->index_root;
+    while (*link != SLICE_INDEX_NULL && nodes[*link].priority > nodes[node].priority)
+        {
+            link = slice_index_less(slice.count, slice.offset, nodes[*link].count, nodes[*link].offset) ? &nodes[*link].left : &nodes[*link].right;
+        }
+    slice_index_split(nodes, *link, slice.count, slice.offset, &nodes[node].left, &nodes[node].right);
+    *link = node;
+}
+
+/* Stop tracking a free slice, must be called before changing it. */
+static void
+slice_index_remove(slice_allocator* allocator, const slice_t slice)
+{
+    if (allocator->policy != SLICE_POLICY_BEST_FIT)
+        return;
+
+    slice_index_node* nodes = allocator->index_nodes;
+    uint32_t*         link  = &allocator->index_root;
+    while (*link != SLICE_INDEX_NULL)
+        {
+            const uint32_t node = *link;
+            if (nodes[node].count == slice.count && nodes[node].offset == slice.offset)
+                {
+                    *link                      = slice_index_merge(nodes, nodes[node].left, nodes[node].right);
+                    nodes[node].left           = allocator->index_free_node;
+                    allocator->index_free_node = node;
+                    return;
+                }
+            link = slice_index_less(slice.count, slice.offset, nodes[node].count, nodes[node].offset) ? &nodes[node].left : &nodes[node].right;
+        }
+    assert(false && "Free slice must be in the index!");
+}
+
+/* Smallest free slice with at least count elements, SLICE_INDEX_NULL if none. */
+static uint32_t
+slice_index_lower_bound(const slice_allocator* allocator, const size_t count)
+{
+    uint32_t best    = SLICE_INDEX_NULL;
+    uint32_t current = allocator->index_root;
+    while (current != SLICE_INDEX_NULL)
+        {
+            if (allocator->index_nodes[current].count >= count)
+                {
+                    best    = current;
+                    current = allocator->index_nodes[current].left;
+                }
+            else
+                {
+                    current = allocator->index_nodes[current].right;
+                }
+        }
+    return best;
+}
+
+static void
+slice_index_destroy(slice_allocator* allocator)
+{
+    slice_metadata_realloc(allocator, allocator->index_nodes, allocator->index_nodes_capacity * sizeof(slice_index_node), 0);
+    allocator->index_nodes          = NULL;
+    allocator->index_nodes_size     = 0;
+    allocator->index_nodes_capacity = 0;
+    allocator->index_root           = SLICE_INDEX_NULL;
+    allocator->index_free_node      = SLICE_INDEX_NULL;
+}
+
+/* Make sure the next free can track its slice, otherwise drop the index and go back to first fit. */
+static void
+slice_index_reserve_for_free(slice_allocator* allocator)
+{
+    if (allocator->policy == SLICE_POLICY_BEST_FIT && !slice_index_reserve(allocator, 1))
+        {
+            slice_index_destroy(allocator);
+            allocator->policy = SLICE_POLICY_FIRST_FIT;
+        }
+}
+
+/* Grow the free slices array to hold at least capacity slices. */
+static bool
+slice_reserve_slices(slice_allocator* allocator, const size_t capacity)
+{
+    if (capacity <= allocator->free_slices_array_capacity)
+        return true;
+
+    size_t new_capacity = allocator->free_slices_array_capacity ? allocator->free_slices_array_capacity * 2 : 8;
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+
+    slice_t* new_array = (slice_t*)slice_metadata_realloc(allocator, allocator->free_slices, allocator->free_slices_array_capacity * sizeof(slice_t), new_capacity * sizeof(slice_t));
+    if (!new_array)
+        return false;
+    allocator->free_slices                = new_array;
+    allocator->free_slices_array_capacity = new_capacity;
+    return true;
+}
+
+/* Free slices are separated by allocated ones, so there's at most one more free slice than allocated slices.
+   Reserving for that before count allocations means that freeing whole slices never needs metadata memory. */
+static bool
+slice_reserve_for_alloc(slice_allocator* allocator, const size_t count)
+{
+    const size_t slices = allocator->allocated_slices + count + 1;
+    if (!slice_reserve_slices(allocator, slices))
+        return false;
+    if (allocator->policy == SLICE_POLICY_BEST_FIT && slices > allocator->index_nodes_size)
+        return slice_index_reserve(allocator, (uint32_t)(slices - allocator->index_nodes_size));
+    return true;
+}
+
+/* First free slice with offset not less than offset, binary search. */
+static size_t
+slice_lower_bound(const slice_allocator* allocator, const size_t offset)
+{
+    size_t count = allocator->free_slices_array_size;
+    size_t first = 0;
+    while (0 < count)
+        {
+            const size_t count2 = count / 2;
+            const size_t mid    = first + count2;
+            if (allocator->free_slices[mid].offset < offset)
+                {
+                    first = mid + 1;
+                    count -= count2 + 1;
+                }
+            else
+                {
+                    count = count2;
+                }
+        }
+    return first;
+}
+
+/* Allocate count elements from the beginning of the free slice at index i. */
+static slice_t
+slice_carve(slice_allocator* allocator, const size_t i, const size_t count)
+{
+    slice_t* current_slice = &allocator->free_slices[i];
+    assert(current_slice->count >= count);
+    slice_index_remove(allocator, *current_slice);
+
+    if (current_slice->count == count)
+        {
+            // Exact match, remove the slice from the free list
+            slice_t allocated_slice = *current_slice;
+            // Shift remaining slices down
+            memmove(&allocator->free_slices[i], &allocator->free_slices[i + 1], (allocator->free_slices_array_size - i - 1) * sizeof(slice_t));
+            allocator->free_slices_array_size--;
+            return allocated_slice;
+        }
+
+    // Allocate from the beginning of the slice
+    slice_t allocated_slice = { .offset = current_slice->offset, .count = (slice_offset_t)count };
+    current_slice->offset   = (slice_offset_t)(current_slice->offset + count);
+    current_slice->count    = (slice_offset_t)(current_slice->count - count);
+    slice_index_add(allocator, *current_slice);
+    return allocated_slice;
+}
+
 void
 slice_initialize(slice_allocator* allocator, const size_t maxNumOfElements)
+{
+    slice_initialize_with_policy(allocator, maxNumOfElements, SLICE_POLICY_FIRST_FIT);
+}
+
+void
+slice_initialize_with_policy(slice_allocator* allocator, const size_t maxNumOfElements, const slice_policy policy)
+{
+    const slice_options options     = { .policy = policy };
+    const int           initialized = slice_initialize_ex(allocator, maxNumOfElements, &options);
+    assert(initialized && "Out of memory for the metadata!");
+    ((void)initialized);
+}
+
+int
+slice_initialize_ex(slice_allocator* allocator, const size_t maxNumOfElements, const slice_options* options)
 {
     // Must be zero initialized
     assert(allocator != NULL);
@@ -50,28 +359,47 @@ slice_initialize(slice_allocator* allocator, const size_t maxNumOfElements)
     assert(allocator->free_slices == NULL);
     assert(allocator->free_slices_array_size == 0);
 
-    allocator->max_elements = maxNumOfElements;
-    allocator->free_slices  = (slice_t*)malloc(sizeof(slice_t));
-    assert(allocator->free_slices != NULL);
-    if (allocator->free_slices != NULL)
-        ;
-    {
-        allocator->free_slices_array_size     = 1;
-        allocator->free_slices_array_capacity = 1;
+    allocator->index_root      = SLICE_INDEX_NULL;
+    allocator->index_free_node = SLICE_INDEX_NULL;
+    if (maxNumOfElements > SLICE_MAX_ELEMENTS)
+        {
+            // Doesn't fit the offsets, empty like a failed metadata allocation
+            return 0;
+        }
+
+    allocator->max_elements    = maxNumOfElements;
+    if (options != NULL)
+        {
+            allocator->policy           = options->policy;
+            allocator->metadata_realloc = options->metadata_realloc;
+            allocator->metadata_user    = options->metadata_user;
+        }
+
+    if (!slice_reserve_slices(allocator, 1))
+        {
+            // Without free slices every allocation fails
+            return 0;
+        }
+    allocator->free_slices_array_size = 1;
+    allocator->free_slices[0].offset  = 0;
+    allocator->free_slices[0].count   = (slice_offset_t)maxNumOfElements;
 
-        allocator->free_slices[0].offset = 0;
-        allocator->free_slices[0].count  = maxNumOfElements;
-    }
+    slice_index_reserve_for_free(allocator);
+    slice_index_add(allocator, allocator->free_slices[0]);
+    return 1;
 }
 
 void
 slice_destroy(slice_allocator* allocator)
 {
     assert(allocator != NULL);
-    free(allocator->free_slices);
-    allocator->free_slices            = NULL;
-    allocator->free_slices_array_size = 0;
-    allocator->max_elements           = 0;
+    slice_metadata_realloc(allocator, allocator->free_slices, allocator->free_slices_array_capacity * sizeof(slice_t), 0);
+    slice_index_destroy(allocator);
+    allocator->free_slices                = NULL;
+    allocator->free_slices_array_size     = 0;
+    allocator->free_slices_array_capacity = 0;
+    allocator->allocated_slices           = 0;
+    allocator->max_elements               = 0;
 }
 
 slice_t
@@ -79,32 +407,33 @@ slice_alloc(slice_allocator* allocator, const size_t count)
 {
     assert(allocator != NULL);
     assert(count > 0);
-    if (allocator->free_slices == NULL)
+    if (allocator->free_slices == NULL || !slice_reserve_for_alloc(allocator, 1))
         {
             slice_t invalid = { .offset = 0, .count = 0 };
             return invalid;
         }
 
-    // Find the first slice that fits
-    for (size_t i = 0; i < allocator->free_slices_array_size; ++i)
+    if (allocator->policy == SLICE_POLICY_BEST_FIT)
         {
-            slice_t* current_slice = &allocator->free_slices[i];
-            if (current_slice->count == count)
+            const uint32_t node = slice_index_lower_bound(allocator, count);
+            if (node != SLICE_INDEX_NULL)
                 {
-                    // Exact match, remove the slice from the free list
-                    slice_t allocated_slice = *current_slice;
-                    // Shift remaining slices down
-                    memmove(&allocator->free_slices[i], &allocator->free_slices[i + 1], (allocator->free_slices_array_size - i - 1) * sizeof(slice_t));
-                    allocator->free_slices_array_size--;
-                    return allocated_slice;
+                    const size_t i = slice_lower_bound(allocator, allocator->index_nodes[node].offset);
+                    assert(i < allocator->free_slices_array_size && allocator->free_slices[i].offset == allocator->index_nodes[node].offset && "Index is out of sync!");
+                    allocator->allocated_slices++;
+                    return slice_carve(allocator, i, count);
                 }
-            else if (current_slice->count > count)
+        }
+    else
+        {
+            // Find the first slice that fits
+            for (size_t i = 0; i < allocator->free_slices_array_size; ++i)
                 {
-                    // Allocate from the beginning of the slice
-                    slice_t allocated_slice = { .offset = current_slice->offset, .count = count };
-                    current_slice->offset += count;
-                    current_slice->count -= count;
-                    return allocated_slice;
+                    if (allocator->free_slices[i].count >= count)
+                        {
+                            allocator->allocated_slices++;
+                            return slice_carve(allocator, i, count);
+                        }
                 }
         }
 
@@ -112,58 +441,289 @@ slice_alloc(slice_allocator* allocator, const size_t count)
     return invalid;
 }
 
-void
-slice_free(slice_allocator* allocator, const slice_t slice)
+/* Give a range back to the free slices, merging with the neighbours. */
+static void
+slice_release(slice_allocator* allocator, const slice_t slice)
 {
     assert(allocator != NULL);
     assert(slice.count > 0);
 
-    size_t insert_index = 0;
-    while (insert_index < allocator->free_slices_array_size && allocator->free_slices[insert_index].offset < slice.offset)
-        {
-            insert_index++;
-        }
+    slice_index_reserve_for_free(allocator);
+
+    const size_t insert_index = slice_lower_bound(allocator, slice.offset);
+    assert((insert_index == allocator->free_slices_array_size || allocator->free_slices[insert_index].offset >= slice.offset + slice.count) && "Slice was already released!");
 
     // Try merge with previous
     if (insert_index > 0 && allocator->free_slices[insert_index - 1].offset + allocator->free_slices[insert_index - 1].count == slice.offset)
         {
-            allocator->free_slices[insert_index - 1].count += slice.count;
+            slice_index_remove(allocator, allocator->free_slices[insert_index - 1]);
+            allocator->free_slices[insert_index - 1].count = (slice_offset_t)(allocator->free_slices[insert_index - 1].count + slice.count);
 
             // Also try merge with next
             if (insert_index < allocator->free_slices_array_size && slice.offset + slice.count == allocator->free_slices[insert_index].offset)
                 {
-                    allocator->free_slices[insert_index - 1].count += allocator->free_slices[insert_index].count;
+                    slice_index_remove(allocator, allocator->free_slices[insert_index]);
+                    allocator->free_slices[insert_index - 1].count = (slice_offset_t)(allocator->free_slices[insert_index - 1].count + allocator->free_slices[insert_index].count);
 
                     memmove(&allocator->free_slices[insert_index], &allocator->free_slices[insert_index + 1], (allocator->free_slices_array_size - insert_index - 1) * sizeof(slice_t));
 
                     allocator->free_slices_array_size--;
                 }
+            slice_index_add(allocator, allocator->free_slices[insert_index - 1]);
             return;
         }
 
     // Try merge with next only
     if (insert_index < allocator->free_slices_array_size && slice.offset + slice.count == allocator->free_slices[insert_index].offset)
         {
+            slice_index_remove(allocator, allocator->free_slices[insert_index]);
             allocator->free_slices[insert_index].offset = slice.offset;
-            allocator->free_slices[insert_index].count += slice.count;
+            allocator->free_slices[insert_index].count  = (slice_offset_t)(allocator->free_slices[insert_index].count + slice.count);
+            slice_index_add(allocator, allocator->free_slices[insert_index]);
             return;
         }
 
-    // Otherwise insert new slice
-    if (allocator->free_slices_array_size == allocator->free_slices_array_capacity)
-        {
-            size_t   new_capacity = allocator->free_slices_array_capacity ? allocator->free_slices_array_capacity * 2 : 8;
-            slice_t* new_array    = (slice_t*)realloc(allocator->free_slices, new_capacity * sizeof(slice_t));
-            if (!new_array)
-                return; // OOM
-            allocator->free_slices                = new_array;
-            allocator->free_slices_array_capacity = new_capacity;
-        }
+    // Otherwise insert new slice, the room was reserved by the allocation unless a slice is released in parts
+    if (!slice_reserve_slices(allocator, allocator->free_slices_array_size + 1))
+        return; // OOM
 
     memmove(&allocator->free_slices[insert_index + 1], &allocator->free_slices[insert_index], (allocator->free_slices_array_size - insert_index) * sizeof(slice_t));
 
     allocator->free_slices[insert_index] = slice;
     allocator->free_slices_array_size++;
+    slice_index_add(allocator, slice);
+}
+
+void
+slice_free(slice_allocator* allocator, const slice_t slice)
+{
+    slice_release(allocator, slice);
+    if (allocator->allocated_slices > 0)
+        allocator->allocated_slices--;
+}
+
+slice_t
+slice_realloc(slice_allocator* allocator, const slice_t slice, const size_t count)
+{
+    assert(allocator != NULL);
+    if (slice.count == 0)
+        return slice_alloc(allocator, count);
+    if (count == 0)
+        {
+            slice_free(allocator, slice);
+            slice_t invalid = { .offset = 0, .count = 0 };
+            return invalid;
+        }
+
+    if (count <= slice.count)
+        {
+            // Shrink, the tail merges with the free neighbours
+            if (count < slice.count)
+                {
+                    slice_t tail = { .offset = (slice_offset_t)(slice.offset + count), .count = (slice_offset_t)(slice.count - count) };
+                    slice_release(allocator, tail);
+                }
+            slice_t shrunk = { .offset = slice.offset, .count = (slice_offset_t)count };
+            return shrunk;
+        }
+
+    // Grow into the free slice right after, if any
+    const size_t end  = slice.offset + slice.count;
+    const size_t more = count - slice.count;
+    const size_t i    = slice_lower_bound(allocator, end);
+    if (i < allocator->free_slices_array_size && allocator->free_slices[i].offset == end && allocator->free_slices[i].count >= more)
+        {
+            slice_carve(allocator, i, more);
+            slice_t grown = { .offset = slice.offset, .count = (slice_offset_t)count };
+            return grown;
+        }
+
+    // Move, the old slice stays allocated on failure and is released only once the new one exists
+    slice_t moved = slice_alloc(allocator, count);
+    if (moved.count != 0)
+        slice_free(allocator, slice);
+    return moved;
+}
+
+int
+slice_grow(slice_allocator* allocator, const size_t new_max_elements)
+{
+    assert(allocator != NULL);
+    assert(new_max_elements >= allocator->max_elements && "Use slice_shrink_to_fit to shrink!");
+    if (new_max_elements > SLICE_MAX_ELEMENTS || allocator->free_slices == NULL)
+        return 0;
+    if (new_max_elements == allocator->max_elements)
+        return 1;
+
+    const size_t more = new_max_elements - allocator->max_elements;
+    const size_t last = allocator->free_slices_array_size;
+    if (last > 0 && allocator->free_slices[last - 1].offset + allocator->free_slices[last - 1].count == allocator->max_elements)
+        {
+            // The trailing free slice gets longer
+            slice_index_reserve_for_free(allocator);
+            slice_index_remove(allocator, allocator->free_slices[last - 1]);
+            allocator->free_slices[last - 1].count = (slice_offset_t)(allocator->free_slices[last - 1].count + more);
+            slice_index_add(allocator, allocator->free_slices[last - 1]);
+        }
+    else
+        {
+            // The space ends with an allocated slice, a new free slice goes at the end. Still at most one more free
+            // slice than allocated ones, so the reservation for the frees holds.
+            if (!slice_reserve_slices(allocator, last + 1) || (allocator->policy == SLICE_POLICY_BEST_FIT && !slice_index_reserve(allocator, 1)))
+                return 0;
+            const slice_t tail = { .offset = (slice_offset_t)allocator->max_elements, .count = (slice_offset_t)more };
+            allocator->free_slices[last] = tail;
+            allocator->free_slices_array_size++;
+            slice_index_add(allocator, tail);
+        }
+    allocator->max_elements = new_max_elements;
+    return 1;
+}
+
+size_t
+slice_shrink_to_fit(slice_allocator* allocator)
+{
+    assert(allocator != NULL);
+    const size_t last = allocator->free_slices_array_size;
+    if (last > 0 && allocator->free_slices[last - 1].offset + allocator->free_slices[last - 1].count == allocator->max_elements)
+        {
+            slice_index_remove(allocator, allocator->free_slices[last - 1]);
+            allocator->max_elements = allocator->free_slices[last - 1].offset;
+            allocator->free_slices_array_size--;
+        }
+    return allocator->max_elements;
+}
+
+size_t
+slice_alloc_many(slice_allocator* allocator, const size_t* counts, slice_t* slices, const size_t n)
+{
+    assert(allocator != NULL);
+    assert(counts != NULL || n == 0);
+    assert(slices != NULL || n == 0);
+
+    size_t allocated = 0;
+    size_t k         = 0;
+    if (allocator->policy == SLICE_POLICY_FIRST_FIT && allocator->free_slices != NULL && slice_reserve_for_alloc(allocator, n))
+        {
+            // One pass, every request is carved from the first free slice at or after the previous one. Exact fits leave
+            // empty slices that are removed at the end instead of a memmove each.
+            size_t i = 0;
+            for (; k < n; ++k)
+                {
+                    assert(counts[k] > 0);
+                    while (i < allocator->free_slices_array_size && allocator->free_slices[i].count < counts[k])
+                        ++i;
+                    if (i == allocator->free_slices_array_size)
+                        break;
+
+                    slice_t* current_slice = &allocator->free_slices[i];
+                    slices[k].offset       = current_slice->offset;
+                    slices[k].count        = (slice_offset_t)counts[k];
+                    current_slice->offset  = (slice_offset_t)(current_slice->offset + counts[k]);
+                    current_slice->count   = (slice_offset_t)(current_slice->count - counts[k]);
+                    allocator->allocated_slices++;
+                    allocated++;
+                }
+
+            size_t kept = 0;
+            for (i = 0; i < allocator->free_slices_array_size; ++i)
+                {
+                    if (allocator->free_slices[i].count != 0)
+                        allocator->free_slices[kept++] = allocator->free_slices[i];
+                }
+            allocator->free_slices_array_size = kept;
+        }
+
+    // Best fit, or the requests left by the pass that may fit before it
+    for (; k < n; ++k)
+        {
+            slices[k] = slice_alloc(allocator, counts[k]);
+            allocated += slices[k].count != 0;
+        }
+    return allocated;
+}
+
+static int
+slice_offset_compare(const void* a, const void* b)
+{
+    const slice_offset_t offset_a = ((const slice_t*)a)->offset;
+    const slice_offset_t offset_b = ((const slice_t*)b)->offset;
+    return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+void
+slice_free_many(slice_allocator* allocator, const slice_t* slices, const size_t n)
+{
+    assert(allocator != NULL);
+    assert(slices != NULL || n == 0);
+    if (n == 0)
+        return;
+
+    const size_t old_size = allocator->free_slices_array_size;
+    slice_t*     sorted   = (slice_t*)slice_metadata_realloc(allocator, NULL, 0, n * sizeof(slice_t));
+    if (!sorted || !slice_reserve_slices(allocator, old_size + n))
+        {
+            // No memory for the batch, one by one never needs any
+            slice_metadata_realloc(allocator, sorted, n * sizeof(slice_t), 0);
+            for (size_t i = 0; i < n; ++i)
+                slice_free(allocator, slices[i]);
+            return;
+        }
+    memcpy(sorted, slices, n * sizeof(slice_t));
+    qsort(sorted, n, sizeof(slice_t), slice_offset_compare);
+
+    // Merge from the back into the end of the array, the write position never passes the unread free slices.
+    // out is the lowest slice written so far, the next one either extends it down or goes right before it.
+    slice_t* free_slices = allocator->free_slices;
+    size_t   a           = n;
+    size_t   b           = old_size;
+    size_t   out         = old_size + n;
+    while (a > 0 || b > 0)
+        {
+            slice_t next;
+            if (b == 0 || (a > 0 && sorted[a - 1].offset > free_slices[b - 1].offset))
+                {
+                    next = sorted[--a];
+                    assert(next.count > 0);
+                }
+            else
+                {
+                    next = free_slices[--b];
+                }
+
+            if (out < old_size + n)
+                {
+                    assert(next.offset + next.count <= free_slices[out].offset && "Slice was already released!");
+                    if (next.offset + next.count == free_slices[out].offset)
+                        {
+                            free_slices[out].offset = next.offset;
+                            free_slices[out].count  = (slice_offset_t)(free_slices[out].count + next.count);
+                            continue;
+                        }
+                }
+            free_slices[--out] = next;
+        }
+    slice_metadata_realloc(allocator, sorted, n * sizeof(slice_t), 0);
+
+    allocator->free_slices_array_size = old_size + n - out;
+    memmove(free_slices, free_slices + out, allocator->free_slices_array_size * sizeof(slice_t));
+    allocator->allocated_slices = allocator->allocated_slices > n ? allocator->allocated_slices - n : 0;
+
+    // Most of the free slices changed, the size index is rebuilt
+    if (allocator->policy == SLICE_POLICY_BEST_FIT)
+        {
+            allocator->index_nodes_size = 0;
+            allocator->index_root       = SLICE_INDEX_NULL;
+            allocator->index_free_node  = SLICE_INDEX_NULL;
+            if (!slice_index_reserve(allocator, (uint32_t)allocator->free_slices_array_size))
+                {
+                    slice_index_destroy(allocator);
+                    allocator->policy = SLICE_POLICY_FIRST_FIT;
+                    return;
+                }
+            for (size_t i = 0; i < allocator->free_slices_array_size; ++i)
+                slice_index_add(allocator, free_slices[i]);
+        }
 }
 
 size_t
@@ -177,3 +737,379 @@ slice_compute_unused_count(const slice_allocator* allocator)
         }
     return total;
 }
+
+/* Buddy mode ////////////////////////////////////////////////////////////////////////////// */
+
+/* Smallest order with 2^order >= n. */
+static uint32_t
+slice_buddy_order_of(const size_t n)
+{
+    uint32_t order = 0;
+    while (((size_t)1 << order) < n)
+        order++;
+    return order;
+}
+
+static size_t
+slice_buddy_tree_bytes(const slice_buddy_allocator* allocator)
+{
+    return allocator->tree ? ((size_t)2 << allocator->levels) : 0;
+}
+
+/* Recompute node from its children, order is the order of node. Two whole free children make a whole free node. */
+static void
+slice_buddy_combine(slice_buddy_allocator* allocator, const size_t node, const uint32_t order)
+{
+    const uint8_t left  = allocator->tree[node * 2];
+    const uint8_t right = allocator->tree[node * 2 + 1];
+    if (left == order && right == order)
+        allocator->tree[node] = (uint8_t)(order + 1);
+    else
+        allocator->tree[node] = left > right ? left : right;
+}
+
+void
+slice_buddy_initialize(slice_buddy_allocator* allocator, const size_t maxNumOfElements, const size_t min_count)
+{
+    const int initialized = slice_buddy_initialize_ex(allocator, maxNumOfElements, min_count, NULL);
+    assert(initialized && "Out of memory for the metadata!");
+    ((void)initialized);
+}
+
+int
+slice_buddy_initialize_ex(slice_buddy_allocator* allocator, const size_t maxNumOfElements, const size_t min_count, const slice_options* options)
+{
+    // Must be zero initialized
+    assert(allocator != NULL);
+    assert(maxNumOfElements > 0);
+    assert(allocator->tree == NULL);
+
+    if (options != NULL)
+        {
+            allocator->metadata_realloc = options->metadata_realloc;
+            allocator->metadata_user    = options->metadata_user;
+        }
+    allocator->min_count = (size_t)1 << slice_buddy_order_of(min_count ? min_count : 1);
+    if (maxNumOfElements > SLICE_MAX_ELEMENTS || maxNumOfElements < allocator->min_count)
+        {
+            // Doesn't fit the offsets or not a single block, empty like a failed metadata allocation
+            return 0;
+        }
+
+    const size_t leaves = maxNumOfElements / allocator->min_count;
+    allocator->levels   = slice_buddy_order_of(leaves);
+    uint8_t* tree       = (uint8_t*)slice_metadata_call(allocator->metadata_realloc, allocator->metadata_user, NULL, 0, (size_t)2 << allocator->levels);
+    if (!tree)
+        return 0;
+    allocator->tree         = tree;
+    allocator->max_elements = maxNumOfElements;
+
+    // Leaves past the space are never free, the inner nodes are built bottom up
+    const size_t first_leaf = (size_t)1 << allocator->levels;
+    for (size_t i = 0; i < first_leaf; ++i)
+        tree[first_leaf + i] = i < leaves ? 1 : 0;
+    tree[0] = 0;
+    for (uint32_t order = 1; order <= allocator->levels; ++order)
+        {
+            const size_t first = (size_t)1 << (allocator->levels - order);
+            for (size_t node = first; node < first * 2; ++node)
+                slice_buddy_combine(allocator, node, order);
+        }
+    return 1;
+}
+
+void
+slice_buddy_destroy(slice_buddy_allocator* allocator)
+{
+    assert(allocator != NULL);
+    slice_metadata_call(allocator->metadata_realloc, allocator->metadata_user, allocator->tree, slice_buddy_tree_bytes(allocator), 0);
+    allocator->tree         = NULL;
+    allocator->levels       = 0;
+    allocator->max_elements = 0;
+}
+
+slice_t
+slice_buddy_alloc(slice_buddy_allocator* allocator, const size_t count)
+{
+    assert(allocator != NULL);
+    assert(count > 0);
+
+    slice_t invalid = { .offset = 0, .count = 0 };
+    if (allocator->tree == NULL)
+        return invalid;
+
+    const uint32_t order = slice_buddy_order_of((count + allocator->min_count - 1) / allocator->min_count);
+    if (order > allocator->levels || allocator->tree[1] < order + 1)
+        return invalid;
+
+    // Descend to a whole free block of the order, left first so the lowest offsets are used
+    size_t   node       = 1;
+    uint32_t node_order = allocator->levels;
+    while (node_order > order)
+        {
+            node = allocator->tree[node * 2] >= order + 1 ? node * 2 : node * 2 + 1;
+            node_order--;
+        }
+    assert(allocator->tree[node] == order + 1 && "Tree is out of sync!");
+    allocator->tree[node] = 0;
+
+    const size_t offset = ((node - ((size_t)1 << (allocator->levels - order))) << order) * allocator->min_count;
+    for (node /= 2, node_order++; node > 0; node /= 2, node_order++)
+        slice_buddy_combine(allocator, node, node_order);
+
+    slice_t allocated_slice = { .offset = (slice_offset_t)offset, .count = (slice_offset_t)count };
+    return allocated_slice;
+}
+
+void
+slice_buddy_free(slice_buddy_allocator* allocator, const slice_t slice)
+{
+    assert(allocator != NULL);
+    assert(slice.count > 0);
+
+    const uint32_t order = slice_buddy_order_of((slice.count + allocator->min_count - 1) / allocator->min_count);
+    const size_t   leaf  = slice.offset / allocator->min_count;
+    assert(slice.offset % (allocator->min_count << order) == 0 && "Not a slice of this allocator!");
+
+    size_t node = ((size_t)1 << (allocator->levels - order)) + (leaf >> order);
+    assert(allocator->tree[node] == 0 && "Slice was already released!");
+    allocator->tree[node] = (uint8_t)(order + 1);
+
+    uint32_t node_order = order + 1;
+    for (node /= 2; node > 0; node /= 2, node_order++)
+        slice_buddy_combine(allocator, node, node_order);
+}
+
+/* Elements of the free blocks under node. */
+static size_t
+slice_buddy_unused_below(const slice_buddy_allocator* allocator, const size_t node, const uint32_t order)
+{
+    if (allocator->tree[node] == order + 1)
+        return allocator->min_count << order;
+    if (allocator->tree[node] == 0 || order == 0)
+        return 0;
+    return slice_buddy_unused_below(allocator, node * 2, order - 1) + slice_buddy_unused_below(allocator, node * 2 + 1, order - 1);
+}
+
+size_t
+slice_buddy_compute_unused_count(const slice_buddy_allocator* allocator)
+{
+    assert(allocator != NULL);
+    if (allocator->tree == NULL)
+        return 0;
+    return slice_buddy_unused_below(allocator, 1, allocator->levels);
+}
+
+/* Concurrent mode ///////////////////////////////////////////////////////////////////////// */
+
+/* Atomics over plain integers keep the header ANSI C, the claims are acquire and the releases are release. */
+#if defined(_MSC_VER) && !defined(__clang__)
+
+static uint64_t
+slice_concurrent_load(const volatile uint64_t* word)
+{
+    // 64-bit aligned volatile reads are atomic and have acquire semantics on MSVC targets
+    return *word;
+}
+
+static int
+slice_concurrent_cas(volatile uint64_t* word, uint64_t* expected, const uint64_t desired)
+{
+    const uint64_t previous = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word, (__int64)desired, (__int64)*expected);
+    if (previous == *expected)
+        return 1;
+    *expected = previous;
+    return 0;
+}
+
+static uint64_t
+slice_concurrent_fetch_and(volatile uint64_t* word, const uint64_t mask)
+{
+    return (uint64_t)_InterlockedAnd64((volatile __int64*)word, (__int64)mask);
+}
+
+static uint32_t
+slice_concurrent_ctz(const uint64_t x)
+{
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+}
+
+static uint32_t
+slice_concurrent_popcount(const uint64_t x)
+{
+    return (uint32_t)__popcnt64(x);
+}
+
+#elif defined(__GNUC__) || defined(__clang__)
+
+static uint64_t
+slice_concurrent_load(const volatile uint64_t* word)
+{
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static int
+slice_concurrent_cas(volatile uint64_t* word, uint64_t* expected, const uint64_t desired)
+{
+    return __atomic_compare_exchange_n(word, expected, desired, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static uint64_t
+slice_concurrent_fetch_and(volatile uint64_t* word, const uint64_t mask)
+{
+    return __atomic_fetch_and(word, mask, __ATOMIC_RELEASE);
+}
+
+static uint32_t
+slice_concurrent_ctz(const uint64_t x)
+{
+    return (uint32_t)__builtin_ctzll(x);
+}
+
+static uint32_t
+slice_concurrent_popcount(const uint64_t x)
+{
+    return (uint32_t)__builtin_popcountll(x);
+}
+
+#else
+#error "slice concurrent mode needs 64-bit compare and swap, add the intrinsics of this compiler"
+#endif
+
+/* Bits of the free runs of count elements, bit i is set when the elements i to i + count - 1 of the word are free.
+   Runs are and-ed with themselves shifted, doubling the covered length, zeros shifted in at the top end the runs. */
+static uint64_t
+slice_concurrent_runs(const uint64_t used, const size_t count)
+{
+    uint64_t runs   = ~used;
+    size_t   length = 1;
+    while (length < count && runs != 0)
+        {
+            const size_t step = length < count - length ? length : count - length;
+            runs &= runs >> step;
+            length += step;
+        }
+    return runs;
+}
+
+static uint64_t
+slice_concurrent_mask(const size_t count, const uint32_t bit)
+{
+    return (count == 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1)) << bit;
+}
+
+void
+slice_concurrent_initialize(slice_concurrent_allocator* allocator, const size_t maxNumOfElements)
+{
+    const int initialized = slice_concurrent_initialize_ex(allocator, maxNumOfElements, NULL);
+    assert(initialized && "Out of memory for the metadata!");
+    ((void)initialized);
+}
+
+int
+slice_concurrent_initialize_ex(slice_concurrent_allocator* allocator, const size_t maxNumOfElements, const slice_options* options)
+{
+    // Must be zero initialized
+    assert(allocator != NULL);
+    assert(maxNumOfElements > 0);
+    assert(allocator->words == NULL);
+
+    if (options != NULL)
+        {
+            allocator->metadata_realloc = options->metadata_realloc;
+            allocator->metadata_user    = options->metadata_user;
+        }
+    if (maxNumOfElements > SLICE_MAX_ELEMENTS)
+        return 0;
+
+    const size_t word_count = (maxNumOfElements + 63) / 64;
+    uint64_t*    words      = (uint64_t*)slice_metadata_call(allocator->metadata_realloc, allocator->metadata_user, NULL, 0, word_count * sizeof(uint64_t));
+    if (!words)
+        return 0;
+
+    // The elements past the space are used forever
+    memset(words, 0, word_count * sizeof(uint64_t));
+    if (maxNumOfElements % 64)
+        words[word_count - 1] = ~(uint64_t)0 << (maxNumOfElements % 64);
+
+    allocator->words        = words;
+    allocator->word_count   = word_count;
+    allocator->max_elements = maxNumOfElements;
+    return 1;
+}
+
+void
+slice_concurrent_destroy(slice_concurrent_allocator* allocator)
+{
+    assert(allocator != NULL);
+    slice_metadata_call(allocator->metadata_realloc, allocator->metadata_user, (void*)allocator->words, allocator->word_count * sizeof(uint64_t), 0);
+    allocator->words        = NULL;
+    allocator->word_count   = 0;
+    allocator->max_elements = 0;
+}
+
+void
+slice_concurrent_cursor_initialize(slice_concurrent_cursor* cursor, slice_concurrent_allocator* allocator, const size_t seed)
+{
+    assert(cursor != NULL && allocator != NULL);
+    cursor->allocator = allocator;
+    cursor->hint      = allocator->word_count ? (size_t)(((uint64_t)seed * 0x9E3779B97F4A7C15ull) >> 32) % allocator->word_count : 0;
+}
+
+slice_t
+slice_concurrent_alloc(slice_concurrent_cursor* cursor, const size_t count)
+{
+    assert(cursor != NULL);
+    assert(count > 0 && count <= SLICE_CONCURRENT_MAX_COUNT);
+
+    slice_concurrent_allocator* allocator = cursor->allocator;
+    const size_t                words     = allocator->word_count;
+    for (size_t visited = 0; visited < words; ++visited)
+        {
+            const size_t w    = (cursor->hint + visited) % words;
+            uint64_t     used = slice_concurrent_load(&allocator->words[w]);
+            while (slice_concurrent_popcount(~used) >= count)
+                {
+                    const uint64_t runs = slice_concurrent_runs(used, count);
+                    if (runs == 0)
+                        break;
+
+                    // A failed swap reloads the word, the runs are searched again in the new value
+                    const uint32_t bit = slice_concurrent_ctz(runs);
+                    if (slice_concurrent_cas(&allocator->words[w], &used, used | slice_concurrent_mask(count, bit)))
+                        {
+                            cursor->hint            = w;
+                            slice_t allocated_slice = { .offset = (slice_offset_t)(w * 64 + bit), .count = (slice_offset_t)count };
+                            return allocated_slice;
+                        }
+                }
+        }
+
+    slice_t invalid = { .offset = 0, .count = 0 };
+    return invalid;
+}
+
+void
+slice_concurrent_free(slice_concurrent_allocator* allocator, const slice_t slice)
+{
+    assert(allocator != NULL);
+    assert(slice.count > 0 && slice.count <= SLICE_CONCURRENT_MAX_COUNT);
+    assert(slice.offset / 64 == (slice.offset + slice.count - 1) / 64 && "Not a slice of this allocator!");
+
+    const uint64_t mask     = slice_concurrent_mask(slice.count, (uint32_t)(slice.offset % 64));
+    const uint64_t previous = slice_concurrent_fetch_and(&allocator->words[slice.offset / 64], ~mask);
+    assert((previous & mask) == mask && "Slice was already released!");
+    ((void)previous);
+}
+
+size_t
+slice_concurrent_compute_unused_count(const slice_concurrent_allocator* allocator)
+{
+    assert(allocator != NULL);
+    size_t total = 0;
+    for (size_t w = 0; w < allocator->word_count; ++w)
+        total += slice_concurrent_popcount(~slice_concurrent_load(&allocator->words[w]));
+    return total;
+}
@@ -7,6 +7,9 @@
 // 
 // DESCRIPTION: A index based slice allocator.
 // Free after free detection assert.
+// Placement is first fit by default, best fit uses a size ordered treap over the free slices.
+// Buddy mode (slice_buddy_*) hands out power of two blocks from a tree of one byte per node, O(log n) alloc and free.
+// Concurrent mode (slice_concurrent_*) is lock-free over a bitmap of 64-bit words, for up to 64 elements per slice.
 // 
 // LICENSE: BSD-2
 // Copyright (c) 2025, Kirichenko Stanislav
@@ -36,6 +39,14 @@
 //
 // MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
 // 3 OCT 2025 ~ Kirichenko Stanislav ~ First version.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Best fit policy with size index, binary search on free.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Realloc in place.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Metadata backing allocator.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ 32 and 16 bit offsets.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Buddy mode.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Batched alloc and free.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Growable space.
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ Lock-free concurrent mode.
 //
 // USAGE ////////////////////////////////////////////////////////////////////////////////////
 //
@@ -46,13 +57,57 @@
 #ifndef INCLUDED_SLICE
 #define INCLUDED_SLICE
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Width of the offsets and counts in the slices and the size index, define it before including to override:
+   0 size_t.
+   32 uint32_t, 8 bytes per free slice instead of 16 on 64 bit targets.
+   16 uint16_t, 4 bytes per free slice.
+   The elements are limited to SLICE_MAX_ELEMENTS, slice_initialize_ex fails above it. */
+#ifndef SLICE_OFFSET_BITS
+#define SLICE_OFFSET_BITS 0
+#endif
+
+#if SLICE_OFFSET_BITS == 32
+typedef uint32_t slice_offset_t;
+#define SLICE_MAX_ELEMENTS ((size_t)UINT32_MAX)
+#elif SLICE_OFFSET_BITS == 16
+typedef uint16_t slice_offset_t;
+#define SLICE_MAX_ELEMENTS ((size_t)UINT16_MAX)
+#elif SLICE_OFFSET_BITS == 0
+typedef size_t slice_offset_t;
+#define SLICE_MAX_ELEMENTS SIZE_MAX
+#else
+#error "SLICE_OFFSET_BITS must be 0, 32 or 16!"
+#endif
+
 typedef struct {
-	size_t offset;
-	size_t count;
+	slice_offset_t offset;
+	slice_offset_t count;
 } slice_t;
 
+/* Where new slices are carved from. */
+typedef enum {
+	/* Lowest offset free slice that fits, linear scan. */
+	SLICE_POLICY_FIRST_FIT = 0,
+	/* Smallest free slice that fits, O(log n) search in the size index. */
+	SLICE_POLICY_BEST_FIT = 1
+} slice_policy;
+
+/* Backing allocator for the metadata. ptr NULL allocates, new_size 0 releases ptr (which can be NULL) and returns NULL,
+   otherwise resizes as realloc. Returning NULL means out of memory, ptr is left untouched and the operation that needed
+   the memory fails. */
+typedef void* (*slice_metadata_realloc_fn)(void* user, void* ptr, size_t old_size, size_t new_size);
+
+/* Options for slice_initialize_ex, zero initialized options are the slice_initialize defaults. */
+typedef struct {
+	slice_policy policy;
+	/* Memory for the free slices and the index nodes, NULL uses the C library. */
+	slice_metadata_realloc_fn metadata_realloc;
+	void* metadata_user;
+} slice_options;
+
 /* Defines the slice index allocator. free_slices is a sorted array of free slices or null if there aren't free blocks. */
 typedef struct {
 	/* The max number of elements to allocate*/
@@ -61,8 +116,55 @@ typedef struct {
 	slice_t* free_slices;
 	size_t free_slices_array_size;
 	size_t free_slices_array_capacity;
+	slice_policy policy;
+	/* Size ordered treap over free_slices, keyed by count then offset. Only kept with SLICE_POLICY_BEST_FIT.
+	   Nodes are referenced by index so they survive reallocation. */
+	struct slice_index_node* index_nodes;
+	uint32_t index_nodes_size;
+	uint32_t index_nodes_capacity;
+	uint32_t index_root;
+	uint32_t index_free_node;
+	/* Live slices, the free slices array is kept big enough for the frees. */
+	size_t allocated_slices;
+	slice_metadata_realloc_fn metadata_realloc;
+	void* metadata_user;
 } slice_allocator;
 
+/* Buddy allocator over the same element space. The space is cut in blocks of min_count elements, a slice takes the
+   power of two number of blocks that holds it, aligned on its size. tree is a heap ordered binary tree, node 1 is the
+   root and the children of n are 2n and 2n + 1, every node keeps the order + 1 of the biggest free block below it,
+   0 when there is none. */
+typedef struct {
+	size_t max_elements;
+	/* Elements per leaf, a power of two. */
+	size_t min_count;
+	/* Depth of the leaves, the root block is 2^levels leaves. */
+	uint32_t levels;
+	uint8_t* tree;
+	slice_metadata_realloc_fn metadata_realloc;
+	void* metadata_user;
+} slice_buddy_allocator;
+
+/* Largest count of slice_concurrent_alloc, a slice never crosses a bitmap word. */
+#define SLICE_CONCURRENT_MAX_COUNT 64
+
+/* Lock-free allocator over the same element space, a bit per element, set when used. Slices are claimed with a
+   compare-and-swap on the word that holds them and released with an atomic and. */
+typedef struct {
+	size_t max_elements;
+	size_t word_count;
+	/* Only accessed atomically. */
+	volatile uint64_t* words;
+	slice_metadata_realloc_fn metadata_realloc;
+	void* metadata_user;
+} slice_concurrent_allocator;
+
+/* Per thread search start, threads starting in different words rarely contend on the same one. */
+typedef struct {
+	slice_concurrent_allocator* allocator;
+	size_t hint;
+} slice_concurrent_cursor;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -70,18 +172,92 @@ extern "C" {
 	/* Initialize the allocator. */
 	void slice_initialize(slice_allocator* allocator, const size_t maxNumOfElements);
 
+	/* Initialize the allocator with a placement policy. */
+	void slice_initialize_with_policy(slice_allocator* allocator, const size_t maxNumOfElements, const slice_policy policy);
+
+	/* Initialize the allocator with options, options can be NULL for defaults. Returns 0 when the metadata can't be
+	   allocated or maxNumOfElements is above SLICE_MAX_ELEMENTS, the allocator is then empty and every slice_alloc fails,
+	   slice_destroy is still required. */
+	int slice_initialize_ex(slice_allocator* allocator, const size_t maxNumOfElements, const slice_options* options);
+
 	/* Deinitialize the allocator. */
 	void slice_destroy(slice_allocator* allocator);
 
-	/* Allocates slice from the allocator if has any. */
+	/* Allocates slice from the allocator if has any. Also fails when the metadata for the matching free can't be reserved,
+	   so freeing a whole slice never allocates. */
 	slice_t slice_alloc(slice_allocator* allocator, const size_t count);
 
 	/* Release memory back to the allocator. */
 	void slice_free(slice_allocator* allocator, const slice_t slice);
 
+	/* Resizes a slice, in place when shrinking or when the free slice right after it is big enough, otherwise moves it
+	   and the caller copies the elements. Count 0 frees. Returns an empty slice on failure, the old one is still valid then. */
+	slice_t slice_realloc(slice_allocator* allocator, const slice_t slice, const size_t count);
+
+	/* Grows the space to new_max_elements, the new elements extend the trailing free slice or make a new one at the end.
+	   Returns 0 above SLICE_MAX_ELEMENTS or when the metadata can't grow, the space is unchanged then. */
+	int slice_grow(slice_allocator* allocator, const size_t new_max_elements);
+
+	/* Drops the trailing free slice, the space ends right after the highest allocated slice. Returns the new
+	   max_elements, 0 when nothing was allocated. slice_grow makes the space bigger again. */
+	size_t slice_shrink_to_fit(slice_allocator* allocator);
+
+	/* Allocates n slices of counts[i] elements into slices[i], empty for the ones that don't fit. First fit carves them
+	   in one pass over the free slices, a request that doesn't fit after the previous one falls back to slice_alloc.
+	   Returns the number of allocated slices. */
+	size_t slice_alloc_many(slice_allocator* allocator, const size_t* counts, slice_t* slices, const size_t n);
+
+	/* Releases n slices, in any order. They are sorted in a scratch copy from the metadata allocator and merged with
+	   the free slices in one pass, falls back to slice_free one by one when that memory isn't there. */
+	void slice_free_many(slice_allocator* allocator, const slice_t* slices, const size_t n);
+
 	/* Loops through all the free slices and returns the sum of the count */
 	size_t slice_compute_unused_count(const slice_allocator* allocator);
 
+	/* Initialize the buddy allocator, min_count is rounded up to a power of two. Only the whole blocks before
+	   maxNumOfElements are used. */
+	void slice_buddy_initialize(slice_buddy_allocator* allocator, const size_t maxNumOfElements, const size_t min_count);
+
+	/* Initialize the buddy allocator with options, only the metadata callback is used. Returns 0 when the tree can't be
+	   allocated, every slice_buddy_alloc fails then, slice_buddy_destroy is still required. */
+	int slice_buddy_initialize_ex(slice_buddy_allocator* allocator, const size_t maxNumOfElements, const size_t min_count, const slice_options* options);
+
+	/* Deinitialize the buddy allocator. */
+	void slice_buddy_destroy(slice_buddy_allocator* allocator);
+
+	/* Allocates count elements, the slice has the requested count but holds a whole block. Returns an empty slice
+	   when no block is free. */
+	slice_t slice_buddy_alloc(slice_buddy_allocator* allocator, const size_t count);
+
+	/* Release a slice from slice_buddy_alloc, merging the buddies. */
+	void slice_buddy_free(slice_buddy_allocator* allocator, const slice_t slice);
+
+	/* Elements in the free blocks. */
+	size_t slice_buddy_compute_unused_count(const slice_buddy_allocator* allocator);
+
+	/* Initialize the concurrent allocator, not thread safe. */
+	void slice_concurrent_initialize(slice_concurrent_allocator* allocator, const size_t maxNumOfElements);
+
+	/* Initialize the concurrent allocator with options, only the metadata callback is used. Returns 0 when the bitmap
+	   can't be allocated, every slice_concurrent_alloc fails then, slice_concurrent_destroy is still required. */
+	int slice_concurrent_initialize_ex(slice_concurrent_allocator* allocator, const size_t maxNumOfElements, const slice_options* options);
+
+	/* Deinitialize the concurrent allocator, not thread safe. */
+	void slice_concurrent_destroy(slice_concurrent_allocator* allocator);
+
+	/* Cursor of a thread, seed spreads the threads over the bitmap (a thread index for instance). */
+	void slice_concurrent_cursor_initialize(slice_concurrent_cursor* cursor, slice_concurrent_allocator* allocator, const size_t seed);
+
+	/* Allocates count consecutive elements, at most SLICE_CONCURRENT_MAX_COUNT, searching from the cursor. Returns an
+	   empty slice when no word has the room. Lock-free. */
+	slice_t slice_concurrent_alloc(slice_concurrent_cursor* cursor, const size_t count);
+
+	/* Release a slice from slice_concurrent_alloc. Lock-free. */
+	void slice_concurrent_free(slice_concurrent_allocator* allocator, const slice_t slice);
+
+	/* Counts the free elements, only a snapshot while other threads allocate. */
+	size_t slice_concurrent_compute_unused_count(const slice_concurrent_allocator* allocator);
+
 #if defined(__cplusplus)
 };
 #endif
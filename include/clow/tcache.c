@@ -0,0 +1,247 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: tcache.c
+//
+// AUTHOR: Kirichenko Stanislav
+//
+// DATE: 16 OCT 2026
+//
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+#include "clow/tcache.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if TCACHE_BIN_LIMIT < TCACHE_BATCH
+#error "TCACHE_BIN_LIMIT must be at least TCACHE_BATCH"
+#endif
+
+static void tcache_lock(tcache* const cache)
+{
+#if defined(_WIN32)
+	AcquireSRWLockExclusive((PSRWLOCK)&cache->lock);
+#else
+	pthread_mutex_lock(&cache->lock);
+#endif
+	++cache->lock_count;
+}
+
+static void tcache_unlock(tcache* const cache)
+{
+#if defined(_WIN32)
+	ReleaseSRWLockExclusive((PSRWLOCK)&cache->lock);
+#else
+	pthread_mutex_unlock(&cache->lock);
+#endif
+}
+
+static void tcache_initialize(tcache* const cache, freelist_t* freelist, gpalloc_t* gpalloc)
+{
+	assert(cache != NULL);
+	cache->freelist = freelist;
+	cache->gpalloc = gpalloc;
+	cache->lock_count = 0;
+#if defined(_WIN32)
+	InitializeSRWLock((PSRWLOCK)&cache->lock);
+#else
+	pthread_mutex_init(&cache->lock, NULL);
+#endif
+}
+
+/* Class index of a request, -1 when too big to be cached. */
+static int tcache_class_of(size_t bytes)
+{
+	int c;
+	if (bytes > TCACHE_MAX_SIZE)
+		return -1;
+	c = 0;
+	while (((size_t)1 << (c + TCACHE_MIN_SIZE_LOG2)) < bytes)
+		++c;
+	return c;
+}
+
+static size_t tcache_class_size(int c)
+{
+	return (size_t)1 << (c + TCACHE_MIN_SIZE_LOG2);
+}
+
+/* Backend calls, the lock must be held. */
+static void* tcache_backend_malloc(tcache* const cache, size_t bytes)
+{
+	if (cache->freelist)
+	{
+		if (bytes < freelist_min_alloc_block())
+			bytes = freelist_min_alloc_block();
+		return freelist_malloc(cache->freelist, bytes);
+	}
+	return gpalloc_malloc(cache->gpalloc, bytes, TCACHE_ALIGNMENT);
+}
+
+static void tcache_backend_free(tcache* const cache, void* ptr)
+{
+	if (cache->freelist)
+		freelist_free(cache->freelist, ptr);
+	else
+		gpalloc_free(cache->gpalloc, ptr);
+}
+
+static void tcache_bin_push(tcache_bin* const bin, void* ptr)
+{
+	memcpy(ptr, &bin->head, sizeof(void*));
+	bin->head = ptr;
+	++bin->count;
+}
+
+static void* tcache_bin_pop(tcache_bin* const bin)
+{
+	void* ptr = bin->head;
+	assert(ptr != NULL && bin->count > 0);
+	memcpy(&bin->head, ptr, sizeof(void*));
+	--bin->count;
+	return ptr;
+}
+
+/* Releases up to count blocks of the bin, the lock must be held. */
+static void tcache_bin_flush(tcache* const cache, tcache_bin* const bin, size_t count)
+{
+	while (count-- > 0 && bin->count > 0)
+		tcache_backend_free(cache, tcache_bin_pop(bin));
+}
+
+void tcache_initialize_freelist(tcache_t* cache, freelist_t* backend)
+{
+	assert(backend != NULL);
+	tcache_initialize(cache, backend, NULL);
+}
+
+void tcache_initialize_gpalloc(tcache_t* cache, gpalloc_t* backend)
+{
+	assert(backend != NULL);
+	tcache_initialize(cache, NULL, backend);
+}
+
+void tcache_destroy(tcache_t* cache)
+{
+	assert(cache != NULL);
+#if !defined(_WIN32)
+	pthread_mutex_destroy(&cache->lock);
+#endif
+	cache->freelist = NULL;
+	cache->gpalloc = NULL;
+}
+
+void tcache_thread_attach(tcache_thread_t* thread, tcache_t* cache)
+{
+	assert(thread != NULL);
+	assert(cache != NULL);
+	memset(thread, 0, sizeof(*thread));
+	thread->cache = cache;
+}
+
+void tcache_thread_detach(tcache_thread_t* thread)
+{
+	int c;
+	assert(thread != NULL && thread->cache != NULL);
+
+	tcache_lock(thread->cache);
+	for (c = 0; c < TCACHE_CLASS_COUNT; ++c)
+		tcache_bin_flush(thread->cache, &thread->bins[c], thread->bins[c].count);
+	tcache_unlock(thread->cache);
+	thread->cache = NULL;
+}
+
+void* tcache_malloc(tcache_thread_t* thread, size_t bytes)
+{
+	tcache_bin* bin;
+	void* ptr;
+	size_t i;
+	int c;
+	assert(thread != NULL && thread->cache != NULL);
+
+	c = tcache_class_of(bytes);
+	if (c < 0)
+	{
+		tcache_lock(thread->cache);
+		ptr = tcache_backend_malloc(thread->cache, bytes);
+		tcache_unlock(thread->cache);
+		return ptr;
+	}
+
+	bin = &thread->bins[c];
+	if (bin->count == 0)
+	{
+		// Refill a batch, a partial one when the backend is running out
+		tcache_lock(thread->cache);
+		for (i = 0; i < TCACHE_BATCH; ++i)
+		{
+			ptr = tcache_backend_malloc(thread->cache, tcache_class_size(c));
+			if (!ptr)
+				break;
+			tcache_bin_push(bin, ptr);
+		}
+		tcache_unlock(thread->cache);
+
+		if (bin->count == 0)
+			return NULL;
+	}
+
+	return tcache_bin_pop(bin);
+}
+
+void tcache_free(tcache_thread_t* thread, void* ptr, size_t bytes)
+{
+	tcache_bin* bin;
+	int c;
+	assert(thread != NULL && thread->cache != NULL);
+
+	if (!ptr)
+		return;
+
+	c = tcache_class_of(bytes);
+	if (c < 0)
+	{
+		tcache_lock(thread->cache);
+		tcache_backend_free(thread->cache, ptr);
+		tcache_unlock(thread->cache);
+		return;
+	}
+
+	bin = &thread->bins[c];
+	if (bin->count >= TCACHE_BIN_LIMIT)
+	{
+		tcache_lock(thread->cache);
+		tcache_bin_flush(thread->cache, bin, TCACHE_BATCH);
+		tcache_unlock(thread->cache);
+	}
+	tcache_bin_push(bin, ptr);
+}
@@ -0,0 +1,159 @@
+// //////////////////////////////////////////////////////////////////////////////////////////
+// FILE: tcache.h
+// 
+// AUTHOR: Kirichenko Stanislav
+// 
+// DATE: 16 OCT 2026
+// 
+// DESCRIPTION: Thread caching front-end over a freelist or a gpalloc, which are not thread safe.
+// Each thread owns a tcache_thread with bounded bins of freed blocks by power of two size class.
+// A hit in the bin takes no lock, a miss refills TCACHE_BATCH blocks and a full bin flushes
+// TCACHE_BATCH blocks to the backend, both under the single lock of the tcache.
+// Requests bigger than TCACHE_MAX_SIZE go straight to the backend under the lock.
+// Cached blocks stay allocated in the backend until flushed, detach each thread to return them.
+// 
+// LICENSE: BSD-2
+// Copyright (c) 2025, Kirichenko Stanislav
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions, and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions, and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// MODIFICATIONS ////////////////////////////////////////////////////////////////////////////
+// 16 OCT 2026 ~ Kirichenko Stanislav ~ First version.
+//
+// USAGE ////////////////////////////////////////////////////////////////////////////////////
+//
+// Shared by all the threads, the backend must not be used directly while the tcache is in use
+// gpalloc_t backend;
+// tcache_t cache;
+// gpalloc_initialize(&backend, mem, size);
+// tcache_initialize_gpalloc(&cache, &backend);
+//
+// In each thread, keep the tcache_thread in thread local storage or in the worker context
+// tcache_thread_t local;
+// tcache_thread_attach(&local, &cache);
+// void* element = tcache_malloc(&local, 16);
+// tcache_free(&local, element, 16);
+// tcache_thread_detach(&local);
+//
+// Once all the threads are detached
+// tcache_destroy(&cache);
+//
+// //////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INCLUDED_TCACHE
+#define INCLUDED_TCACHE
+
+#include <stddef.h>
+
+#include "clow/freelist.h"
+#include "clow/gpalloc.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+/* Size classes are powers of two from 16 bytes up to TCACHE_MAX_SIZE. */
+#ifndef TCACHE_MAX_SIZE_LOG2
+#define TCACHE_MAX_SIZE_LOG2 11
+#endif
+#define TCACHE_MIN_SIZE_LOG2 4
+#define TCACHE_MAX_SIZE ((size_t)1 << TCACHE_MAX_SIZE_LOG2)
+#define TCACHE_CLASS_COUNT (TCACHE_MAX_SIZE_LOG2 - TCACHE_MIN_SIZE_LOG2 + 1)
+
+/* Blocks moved from or to the backend under a single lock. */
+#ifndef TCACHE_BATCH
+#define TCACHE_BATCH 16
+#endif
+
+/* Max cached blocks per class and thread, must be at least TCACHE_BATCH. */
+#ifndef TCACHE_BIN_LIMIT
+#define TCACHE_BIN_LIMIT 64
+#endif
+
+/* Alignment requested to gpalloc, freelist blocks are word aligned. */
+#ifndef TCACHE_ALIGNMENT
+#define TCACHE_ALIGNMENT 16
+#endif
+
+/* Shared part, the backend and its lock. */
+typedef struct {
+	freelist_t* freelist;
+	gpalloc_t* gpalloc;
+#if defined(_WIN32)
+	void* lock; // SRWLOCK
+#else
+	pthread_mutex_t lock;
+#endif
+	/* Times the lock was taken, only read it when the threads are quiet. */
+	size_t lock_count;
+} tcache;
+
+/* Freed blocks of a size class, linked through their first word. */
+typedef struct {
+	void* head;
+	size_t count;
+} tcache_bin;
+
+/* Per thread part, never shared. */
+typedef struct {
+	tcache* cache;
+	tcache_bin bins[TCACHE_CLASS_COUNT];
+} tcache_thread;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+	typedef tcache tcache_t;
+	typedef tcache_thread tcache_thread_t;
+
+	/* Initialize over a freelist, TLSF mode is advised since cached blocks are released in any order. */
+	void tcache_initialize_freelist(tcache_t* cache, freelist_t* backend);
+
+	/* Initialize over a gpalloc. */
+	void tcache_initialize_gpalloc(tcache_t* cache, gpalloc_t* backend);
+
+	/* Deinitialize, all the threads must be detached. The backend is left as is. */
+	void tcache_destroy(tcache_t* cache);
+
+	/* Binds the calling thread cache to the tcache. */
+	void tcache_thread_attach(tcache_thread_t* thread, tcache_t* cache);
+
+	/* Flushes all the cached blocks back to the backend under one lock. */
+	void tcache_thread_detach(tcache_thread_t* thread);
+
+	/* Allocates from the thread cache, refilling it from the backend on a miss. NULL when the backend is exhausted. */
+	void* tcache_malloc(tcache_thread_t* thread, size_t bytes);
+
+	/* Release memory to the thread cache, bytes must be the size given to tcache_malloc. Any thread attached
+	   to the same tcache can release it. */
+	void tcache_free(tcache_thread_t* thread, void* ptr, size_t bytes);
+
+#if defined(__cplusplus)
+};
+#endif
+
+
+#endif /*INCLUDED_TCACHE*/
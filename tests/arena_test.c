@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+
+
+#include "clow/arena.c"
+
+#define BUF_ALLOC_VALUE ((size_t)'W')
+
+/* Word aligned storage for the tests, ANSI C has no alignment specifier. */
+#define WORD_BUFFER(name, size) union { size_t word; double real; char bytes[size]; } name
+
+static void arena_tests(void)
+{
+	// Consecutive allocations without overhead
+	{
+		WORD_BUFFER(buffer, 64);
+		arena_t a;
+		void* x;
+		void* y;
+
+		arena_initialize(&a, buffer.bytes, sizeof(buffer.bytes));
+		x = arena_alloc(&a, 16, 1);
+		y = arena_alloc(&a, 16, 1);
+		assert(x == (void*)buffer.bytes);
+		assert(y == (void*)(buffer.bytes + 16));
+		assert(arena_remaining(&a) == 32);
+
+		// Exhaustion
+		assert(arena_alloc(&a, 32, 1) != NULL);
+		assert(arena_alloc(&a, 1, 1) == NULL);
+		assert(a.peak == 64);
+	}
+
+	// Alignment is on the address, the padding is skipped
+	{
+		WORD_BUFFER(buffer, 256);
+		arena_t a;
+		void* x;
+
+		arena_initialize(&a, buffer.bytes + 1, sizeof(buffer.bytes) - 1);
+		x = arena_alloc(&a, 3, 1);
+		assert(x == (void*)(buffer.bytes + 1));
+		x = arena_alloc(&a, 8, 64);
+		assert(x && ((uintptr_t)x) % 64 == 0);
+		x = arena_alloc(&a, 8, 0);
+		assert(x && ((uintptr_t)x) % ARENA_DEFAULT_ALIGNMENT == 0);
+
+		// Padding that doesn't fit fails without moving, an odd address needs at least 7 bytes to get to 16
+		arena_initialize(&a, buffer.bytes + 1, 7);
+		assert(arena_alloc(&a, 1, 16) == NULL);
+		assert(arena_get_marker(&a) == 0);
+	}
+
+	// Markers release everything allocated after them
+	{
+		WORD_BUFFER(buffer, 128);
+		arena_t a;
+		arena_marker marker;
+		void* x;
+		void* y;
+
+		arena_initialize(&a, buffer.bytes, sizeof(buffer.bytes));
+		x = arena_alloc(&a, 16, 8);
+		memset(x, BUF_ALLOC_VALUE, 16);
+		marker = arena_get_marker(&a);
+		y = arena_alloc(&a, 64, 8);
+		assert(y);
+		arena_restore(&a, marker);
+		assert(arena_alloc(&a, 64, 8) == y && "Restored space must be reused!");
+		assert(((char*)x)[15] == (char)BUF_ALLOC_VALUE);
+
+		arena_reset(&a);
+		assert(arena_remaining(&a) == sizeof(buffer.bytes));
+		assert(a.peak == 80);
+	}
+}
+
+static void arena_frame_tests(void)
+{
+	// Double buffering keeps the previous frame, recycles the one before
+	{
+		WORD_BUFFER(buffer, 256);
+		arena_frame_t f;
+		char* frame0;
+		char* frame1;
+		char* frame2;
+
+		arena_frame_initialize(&f, buffer.bytes, sizeof(buffer.bytes), 2);
+		assert(f.frame_count == 2);
+		assert(arena_frame_current(&f)->buffer_size == 128);
+
+		frame0 = (char*)arena_frame_alloc(&f, 100, 1);
+		assert(frame0);
+		memset(frame0, 'a', 100);
+		assert(arena_frame_alloc(&f, 100, 1) == NULL && "A frame only owns its share of the buffer!");
+
+		arena_frame_begin(&f);
+		frame1 = (char*)arena_frame_alloc(&f, 100, 1);
+		assert(frame1 && frame1 != frame0);
+		memset(frame1, 'b', 100);
+		assert(arena_frame_previous(&f, 1)->buffer == (void*)frame0);
+		assert(frame0[99] == 'a' && "Previous frame data must be untouched!");
+
+		arena_frame_begin(&f);
+		frame2 = (char*)arena_frame_alloc(&f, 100, 1);
+		assert(frame2 == frame0 && "Frame N - 2 arena is recycled!");
+		assert(arena_frame_previous(&f, 0) == arena_frame_current(&f));
+		assert(frame1[99] == 'b');
+	}
+
+	// Triple buffering
+	{
+		WORD_BUFFER(buffer, 96);
+		arena_frame_t f;
+		void* first;
+		size_t i;
+
+		arena_frame_initialize(&f, buffer.bytes, sizeof(buffer.bytes), 3);
+		first = arena_frame_alloc(&f, 32, 1);
+		for (i = 1; i < 3; i++)
+		{
+			arena_frame_begin(&f);
+			assert(arena_frame_alloc(&f, 32, 1) != first);
+		}
+		assert(arena_frame_previous(&f, 2)->buffer == first);
+		arena_frame_begin(&f);
+		assert(arena_frame_alloc(&f, 32, 1) == first);
+	}
+}
+
+int main(void)
+{
+	arena_tests();
+	arena_frame_tests();
+	return 0;
+}
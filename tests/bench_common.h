@@ -0,0 +1,490 @@
+// Shared pieces of the benchmarks: clock, random numbers, latency statistics and a common interface
+// over the clow allocators and libc malloc. Include it from a single .c file, it includes the allocators sources.
+
+#ifndef INCLUDED_BENCH_COMMON
+#define INCLUDED_BENCH_COMMON
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clow/freelist.c"
+// Both sources define their own punning helper
+#undef pun_cpy
+#include "clow/gpalloc.c"
+#include "clow/slice.c"
+
+/* Monotonic clock in nanoseconds. */
+static uint64_t bench_now_ns(void)
+{
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* xorshift64*, deterministic for a seed so runs are reproducible. */
+static uint64_t bench_rng_state = 0x9E3779B97F4A7C15ull;
+
+static void bench_seed(uint64_t seed)
+{
+	bench_rng_state = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+static uint64_t bench_rand(void)
+{
+	bench_rng_state ^= bench_rng_state >> 12;
+	bench_rng_state ^= bench_rng_state << 25;
+	bench_rng_state ^= bench_rng_state >> 27;
+	return bench_rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+/* Uniform in [min, max]. */
+static size_t bench_rand_range(size_t min, size_t max)
+{
+	return min + (size_t)(bench_rand() % (uint64_t)(max - min + 1));
+}
+
+/* Latency samples of one run. */
+typedef struct {
+	uint32_t* samples;
+	size_t count;
+	size_t capacity;
+	uint64_t total_ns;
+} bench_latencies;
+
+static void bench_latencies_init(bench_latencies* l, size_t capacity)
+{
+	l->samples = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+	l->count = 0;
+	l->capacity = capacity;
+	l->total_ns = 0;
+}
+
+static void bench_latencies_free(bench_latencies* l)
+{
+	free(l->samples);
+	memset(l, 0, sizeof(*l));
+}
+
+static void bench_latencies_add(bench_latencies* l, uint64_t ns)
+{
+	l->total_ns += ns;
+	if (l->count < l->capacity)
+		l->samples[l->count++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+static int bench_compare_u32(const void* a, const void* b)
+{
+	const uint32_t x = *(const uint32_t*)a;
+	const uint32_t y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+/* Sorts the samples, call once before bench_percentile. */
+static void bench_latencies_sort(bench_latencies* l)
+{
+	qsort(l->samples, l->count, sizeof(uint32_t), bench_compare_u32);
+}
+
+static uint32_t bench_percentile(const bench_latencies* l, double p)
+{
+	size_t i;
+	if (l->count == 0)
+		return 0;
+	i = (size_t)(p * (double)(l->count - 1) + 0.5);
+	return l->samples[i];
+}
+
+/* Common interface over the allocators. Slice allocates element counts, its "pointer" is offset + 1. */
+typedef struct {
+	const char* name;
+	/* Creates an allocator over pool_size bytes (or elements for slice), returns its context. */
+	void* (*create)(size_t pool_size);
+	void (*destroy)(void* context);
+	void* (*alloc)(void* context, size_t size, size_t alignment);
+	void (*release)(void* context, void* ptr, size_t size);
+	/* Bytes of metadata out of the pool, 0 when not measurable. */
+	size_t (*metadata_bytes)(void* context);
+	/* Non zero when alloc honours the alignment, the benchmarks only vary it for those. */
+	int aligned;
+	/* Free bytes in the pool and the biggest free block, NULL when not measurable. */
+	void (*free_space)(void* context, size_t* free_bytes, size_t* largest);
+} bench_allocator;
+
+static void bench_free_space_add(size_t block, size_t* free_bytes, size_t* largest)
+{
+	*free_bytes += block;
+	if (block > *largest)
+		*largest = block;
+}
+
+/* freelist */
+
+typedef struct {
+	freelist_t freelist;
+	void* buffer;
+} bench_freelist;
+
+static void* bench_freelist_create_mode(size_t pool_size, int tlsf)
+{
+	bench_freelist* b = (bench_freelist*)malloc(sizeof(bench_freelist));
+	b->buffer = malloc(pool_size);
+	if (tlsf)
+		freelist_initialize_tlsf(&b->freelist, b->buffer, pool_size);
+	else
+		freelist_initialize(&b->freelist, b->buffer, pool_size);
+	return b;
+}
+
+static void* bench_freelist_create(size_t pool_size)
+{
+	return bench_freelist_create_mode(pool_size, 0);
+}
+
+static void* bench_freelist_tlsf_create(size_t pool_size)
+{
+	return bench_freelist_create_mode(pool_size, 1);
+}
+
+static void bench_freelist_destroy(void* context)
+{
+	bench_freelist* b = (bench_freelist*)context;
+	freelist_reset(&b->freelist);
+	free(b->buffer);
+	free(b);
+}
+
+static void* bench_freelist_alloc(void* context, size_t size, size_t alignment)
+{
+	bench_freelist* b = (bench_freelist*)context;
+	if (alignment > sizeof(void*))
+		return freelist_malloc_aligned(&b->freelist, size, alignment);
+	// Linked list mode has a minimum block and keeps the headers aligned only for aligned sizes
+	if (size < freelist_min_alloc_block())
+		size = freelist_min_alloc_block();
+	size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	return freelist_malloc(&b->freelist, size);
+}
+
+static void bench_freelist_release(void* context, void* ptr, size_t size)
+{
+	((void)size);
+	freelist_free(&((bench_freelist*)context)->freelist, ptr);
+}
+
+static size_t bench_freelist_metadata(void* context)
+{
+	// Headers are in band, TLSF also has its control structure in the pool
+	return ((bench_freelist*)context)->freelist.tlsf ? freelist_tlsf_overhead() : 0;
+}
+
+static void bench_freelist_free_space(void* context, size_t* free_bytes, size_t* largest)
+{
+	freelist_t* fl = &((bench_freelist*)context)->freelist;
+	*free_bytes = 0;
+	*largest = 0;
+	if (fl->tlsf)
+	{
+		freelist_tlsf_block* block;
+		for (block = freelist_tlsf_first_block(fl->tlsf); !freelist_tlsf_block_is_last(block); block = freelist_tlsf_block_next(block))
+			if (freelist_tlsf_block_is_free(block))
+				bench_free_space_add(freelist_tlsf_block_size(block), free_bytes, largest);
+	}
+	else
+	{
+		freelist_block* block;
+		for (block = fl->free_block; block; block = block->next)
+			bench_free_space_add(block->block_size, free_bytes, largest);
+	}
+}
+
+/* gpalloc */
+
+typedef struct {
+	gpalloc_t gpalloc;
+	void* buffer;
+} bench_gpalloc;
+
+static void* bench_gpalloc_create_options(size_t pool_size, const gpalloc_options* options)
+{
+	bench_gpalloc* b = (bench_gpalloc*)malloc(sizeof(bench_gpalloc));
+	b->buffer = malloc(pool_size);
+	gpalloc_initialize_ex(&b->gpalloc, b->buffer, pool_size, options);
+	return b;
+}
+
+static void* bench_gpalloc_create(size_t pool_size)
+{
+	return bench_gpalloc_create_options(pool_size, NULL);
+}
+
+static void* bench_gpalloc_indexed_create(size_t pool_size)
+{
+	gpalloc_options options;
+	memset(&options, 0, sizeof(options));
+	options.policy = GPALLOC_BEST_FIT;
+	return bench_gpalloc_create_options(pool_size, &options);
+}
+
+static void* bench_gpalloc_policy_create(size_t pool_size, gpalloc_policy policy)
+{
+	gpalloc_options options;
+	memset(&options, 0, sizeof(options));
+	options.policy = policy;
+	return bench_gpalloc_create_options(pool_size, &options);
+}
+
+static void* bench_gpalloc_next_create(size_t pool_size)
+{
+	return bench_gpalloc_policy_create(pool_size, GPALLOC_NEXT_FIT);
+}
+
+static void* bench_gpalloc_worst_create(size_t pool_size)
+{
+	return bench_gpalloc_policy_create(pool_size, GPALLOC_WORST_FIT);
+}
+
+static void* bench_gpalloc_hybrid_create(size_t pool_size)
+{
+	return bench_gpalloc_policy_create(pool_size, GPALLOC_HYBRID_FIT);
+}
+
+static void* bench_gpalloc_deferred_create(size_t pool_size)
+{
+	gpalloc_options options;
+	memset(&options, 0, sizeof(options));
+	options.deferred_coalescing = 1;
+	return bench_gpalloc_create_options(pool_size, &options);
+}
+
+/* Index with the address map, 16 KiB pages are 4096 entries over the 64 MiB pool of the bench. */
+static void* bench_gpalloc_mapped_create(size_t pool_size)
+{
+	gpalloc_options options;
+	memset(&options, 0, sizeof(options));
+	options.policy = GPALLOC_BEST_FIT;
+	options.address_map_page = 16 * 1024;
+	return bench_gpalloc_create_options(pool_size, &options);
+}
+
+static void bench_gpalloc_destroy(void* context)
+{
+	bench_gpalloc* b = (bench_gpalloc*)context;
+	gpalloc_destroy(&b->gpalloc);
+	free(b->buffer);
+	free(b);
+}
+
+static void* bench_gpalloc_alloc(void* context, size_t size, size_t alignment)
+{
+	return gpalloc_malloc(&((bench_gpalloc*)context)->gpalloc, size, alignment);
+}
+
+static void bench_gpalloc_release(void* context, void* ptr, size_t size)
+{
+	((void)size);
+	gpalloc_free(&((bench_gpalloc*)context)->gpalloc, ptr);
+}
+
+static size_t bench_gpalloc_metadata(void* context)
+{
+	const gpalloc_t* g = &((bench_gpalloc*)context)->gpalloc;
+	return gpalloc_table_bytes(g) + g->free_index.nodes_capacity * sizeof(gpalloc_index_node) + (g->address_map != NULL ? g->address_map_pages + 1 : 0) * sizeof(uint32_t);
+}
+
+static void bench_gpalloc_free_space(void* context, size_t* free_bytes, size_t* largest)
+{
+	const gpalloc_t* g = &((bench_gpalloc*)context)->gpalloc;
+	size_t i;
+	*free_bytes = 0;
+	*largest = 0;
+	for (i = 0; i < g->allocation_array_size; ++i)
+	{
+		const gpalloc_allocation block = gpalloc_block_get(g, i);
+		if (!block.used)
+			bench_free_space_add(block.size, free_bytes, largest);
+	}
+}
+
+/* Built with GPALLOC_COMPACT_TABLE the rows tell so. */
+#if GPALLOC_COMPACT_TABLE
+#define BENCH_GPALLOC_SUFFIX "_compact"
+#else
+#define BENCH_GPALLOC_SUFFIX ""
+#endif
+
+/* Same for narrower slice offsets. */
+#if SLICE_OFFSET_BITS == 32
+#define BENCH_SLICE_SUFFIX "32"
+#elif SLICE_OFFSET_BITS == 16
+#define BENCH_SLICE_SUFFIX "16"
+#else
+#define BENCH_SLICE_SUFFIX ""
+#endif
+
+/* slice */
+
+static void* bench_slice_create_policy(size_t pool_size, slice_policy policy)
+{
+	slice_allocator* s = (slice_allocator*)calloc(1, sizeof(slice_allocator));
+	slice_initialize_with_policy(s, pool_size, policy);
+	return s;
+}
+
+static void* bench_slice_create(size_t pool_size)
+{
+	return bench_slice_create_policy(pool_size, SLICE_POLICY_FIRST_FIT);
+}
+
+static void* bench_slice_best_fit_create(size_t pool_size)
+{
+	return bench_slice_create_policy(pool_size, SLICE_POLICY_BEST_FIT);
+}
+
+static void bench_slice_destroy(void* context)
+{
+	slice_destroy((slice_allocator*)context);
+	free(context);
+}
+
+static void* bench_slice_alloc(void* context, size_t size, size_t alignment)
+{
+	slice_t s;
+	((void)alignment);
+	s = slice_alloc((slice_allocator*)context, size);
+	return s.count ? (void*)(uintptr_t)(s.offset + 1) : NULL;
+}
+
+static void bench_slice_release(void* context, void* ptr, size_t size)
+{
+	slice_t s;
+	s.offset = (slice_offset_t)((size_t)(uintptr_t)ptr - 1);
+	s.count = (slice_offset_t)size;
+	slice_free((slice_allocator*)context, s);
+}
+
+static size_t bench_slice_metadata(void* context)
+{
+	const slice_allocator* s = (const slice_allocator*)context;
+	return s->free_slices_array_capacity * sizeof(slice_t) + s->index_nodes_capacity * sizeof(slice_index_node);
+}
+
+static void bench_slice_free_space(void* context, size_t* free_bytes, size_t* largest)
+{
+	const slice_allocator* s = (const slice_allocator*)context;
+	size_t i;
+	*free_bytes = 0;
+	*largest = 0;
+	for (i = 0; i < s->free_slices_array_size; ++i)
+		bench_free_space_add(s->free_slices[i].count, free_bytes, largest);
+}
+
+/* Buddy mode, blocks of 16 elements keep the tree of a 64 MiB space at 8 MiB. */
+#define BENCH_SLICE_BUDDY_MIN_COUNT 16
+
+static void* bench_slice_buddy_create(size_t pool_size)
+{
+	slice_buddy_allocator* s = (slice_buddy_allocator*)calloc(1, sizeof(slice_buddy_allocator));
+	slice_buddy_initialize(s, pool_size, BENCH_SLICE_BUDDY_MIN_COUNT);
+	return s;
+}
+
+static void bench_slice_buddy_destroy(void* context)
+{
+	slice_buddy_destroy((slice_buddy_allocator*)context);
+	free(context);
+}
+
+static void* bench_slice_buddy_alloc(void* context, size_t size, size_t alignment)
+{
+	slice_t s;
+	((void)alignment);
+	s = slice_buddy_alloc((slice_buddy_allocator*)context, size);
+	return s.count ? (void*)(uintptr_t)(s.offset + 1) : NULL;
+}
+
+static void bench_slice_buddy_release(void* context, void* ptr, size_t size)
+{
+	slice_t s;
+	s.offset = (slice_offset_t)((size_t)(uintptr_t)ptr - 1);
+	s.count = (slice_offset_t)size;
+	slice_buddy_free((slice_buddy_allocator*)context, s);
+}
+
+static size_t bench_slice_buddy_metadata(void* context)
+{
+	return slice_buddy_tree_bytes((const slice_buddy_allocator*)context);
+}
+
+static void bench_slice_buddy_free_space(void* context, size_t* free_bytes, size_t* largest)
+{
+	const slice_buddy_allocator* s = (const slice_buddy_allocator*)context;
+	*free_bytes = slice_buddy_compute_unused_count(s);
+	*largest = s->tree && s->tree[1] ? s->min_count << (s->tree[1] - 1) : 0;
+}
+
+/* libc baseline */
+
+static void* bench_libc_create(size_t pool_size)
+{
+	((void)pool_size);
+	return NULL;
+}
+
+static void bench_libc_destroy(void* context)
+{
+	((void)context);
+}
+
+static void* bench_libc_alloc(void* context, size_t size, size_t alignment)
+{
+	((void)context);
+	((void)alignment);
+	return malloc(size);
+}
+
+static void bench_libc_release(void* context, void* ptr, size_t size)
+{
+	((void)context);
+	((void)size);
+	free(ptr);
+}
+
+static size_t bench_libc_metadata(void* context)
+{
+	((void)context);
+	return 0;
+}
+
+static const bench_allocator bench_allocators[] = {
+	{ "malloc", bench_libc_create, bench_libc_destroy, bench_libc_alloc, bench_libc_release, bench_libc_metadata, 0, NULL },
+	{ "freelist", bench_freelist_create, bench_freelist_destroy, bench_freelist_alloc, bench_freelist_release, bench_freelist_metadata, 1, bench_freelist_free_space },
+	{ "freelist_tlsf", bench_freelist_tlsf_create, bench_freelist_destroy, bench_freelist_alloc, bench_freelist_release, bench_freelist_metadata, 1, bench_freelist_free_space },
+	{ "gpalloc" BENCH_GPALLOC_SUFFIX, bench_gpalloc_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_index" BENCH_GPALLOC_SUFFIX, bench_gpalloc_indexed_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_next" BENCH_GPALLOC_SUFFIX, bench_gpalloc_next_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_worst" BENCH_GPALLOC_SUFFIX, bench_gpalloc_worst_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_hybrid" BENCH_GPALLOC_SUFFIX, bench_gpalloc_hybrid_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_deferred" BENCH_GPALLOC_SUFFIX, bench_gpalloc_deferred_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "gpalloc_index_map" BENCH_GPALLOC_SUFFIX, bench_gpalloc_mapped_create, bench_gpalloc_destroy, bench_gpalloc_alloc, bench_gpalloc_release, bench_gpalloc_metadata, 1, bench_gpalloc_free_space },
+	{ "slice" BENCH_SLICE_SUFFIX, bench_slice_create, bench_slice_destroy, bench_slice_alloc, bench_slice_release, bench_slice_metadata, 0, bench_slice_free_space },
+	{ "slice_best_fit" BENCH_SLICE_SUFFIX, bench_slice_best_fit_create, bench_slice_destroy, bench_slice_alloc, bench_slice_release, bench_slice_metadata, 0, bench_slice_free_space },
+	{ "slice_buddy" BENCH_SLICE_SUFFIX, bench_slice_buddy_create, bench_slice_buddy_destroy, bench_slice_buddy_alloc, bench_slice_buddy_release, bench_slice_buddy_metadata, 0, bench_slice_buddy_free_space },
+};
+
+#define BENCH_ALLOCATOR_COUNT (sizeof(bench_allocators) / sizeof(bench_allocators[0]))
+
+#endif /*INCLUDED_BENCH_COMMON*/
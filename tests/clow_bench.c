@@ -0,0 +1,254 @@
+// Microbenchmarks of the allocators against libc malloc.
+// Usage: clow_bench [operations] [seed]
+// Every run is deterministic for a seed, the latency of each malloc and free is sampled to report percentiles.
+
+#include "bench_common.h"
+
+#define BENCH_POOL_SIZE (64u * 1024u * 1024u)
+#define BENCH_SLOTS 1024
+
+typedef struct {
+	void* ptr;
+	size_t size;
+} bench_slot;
+
+typedef struct {
+	const bench_allocator* allocator;
+	void* context;
+	size_t alignment;
+	bench_slot slots[BENCH_SLOTS];
+	bench_latencies latencies;
+	size_t operations;
+	size_t failures;
+	size_t peak_metadata;
+} bench_run;
+
+static int bench_done(const bench_run* run)
+{
+	return run->latencies.count >= run->latencies.capacity;
+}
+
+static void bench_sample_metadata(bench_run* run)
+{
+	const size_t bytes = run->allocator->metadata_bytes(run->context);
+	if (bytes > run->peak_metadata)
+		run->peak_metadata = bytes;
+}
+
+static void bench_alloc(bench_run* run, bench_slot* slot, size_t size)
+{
+	uint64_t start;
+	void* ptr;
+
+	assert(slot->ptr == NULL);
+	start = bench_now_ns();
+	ptr = run->allocator->alloc(run->context, size, run->alignment);
+	bench_latencies_add(&run->latencies, bench_now_ns() - start);
+	++run->operations;
+	if (ptr == NULL)
+	{
+		++run->failures;
+		return;
+	}
+	slot->ptr = ptr;
+	slot->size = size;
+	bench_sample_metadata(run);
+}
+
+static void bench_release(bench_run* run, bench_slot* slot)
+{
+	uint64_t start;
+
+	if (slot->ptr == NULL)
+		return;
+	start = bench_now_ns();
+	run->allocator->release(run->context, slot->ptr, slot->size);
+	bench_latencies_add(&run->latencies, bench_now_ns() - start);
+	++run->operations;
+	slot->ptr = NULL;
+	bench_sample_metadata(run);
+}
+
+/* Same size blocks allocated and freed at random slots. */
+static void bench_fixed_churn(bench_run* run)
+{
+	while (!bench_done(run))
+	{
+		bench_slot* slot = &run->slots[bench_rand() % BENCH_SLOTS];
+		if (slot->ptr)
+			bench_release(run, slot);
+		else
+			bench_alloc(run, slot, 64);
+	}
+}
+
+/* Random sizes allocated and freed at random slots. */
+static void bench_random_sizes(bench_run* run)
+{
+	while (!bench_done(run))
+	{
+		bench_slot* slot = &run->slots[bench_rand() % BENCH_SLOTS];
+		if (slot->ptr)
+			bench_release(run, slot);
+		else
+			bench_alloc(run, slot, bench_rand_range(16, 4096));
+	}
+}
+
+/* Fill up then free in reverse order. */
+static void bench_lifo(bench_run* run)
+{
+	size_t i;
+	while (!bench_done(run))
+	{
+		for (i = 0; i < BENCH_SLOTS; ++i)
+			bench_alloc(run, &run->slots[i], bench_rand_range(16, 512));
+		for (i = BENCH_SLOTS; i-- > 0;)
+			bench_release(run, &run->slots[i]);
+	}
+}
+
+/* Queue, the oldest allocation is freed once all the slots are in use. */
+static void bench_fifo(bench_run* run)
+{
+	size_t head = 0;
+	while (!bench_done(run))
+	{
+		bench_slot* slot = &run->slots[head];
+		bench_release(run, slot);
+		bench_alloc(run, slot, bench_rand_range(16, 512));
+		head = (head + 1) % BENCH_SLOTS;
+	}
+}
+
+/* Interleaved small blocks, every other one freed, then bigger blocks that do not fit in the holes. */
+static void bench_fragmentation(bench_run* run)
+{
+	size_t i;
+	size_t order[BENCH_SLOTS];
+
+	while (!bench_done(run))
+	{
+		for (i = 0; i < BENCH_SLOTS; ++i)
+			bench_alloc(run, &run->slots[i], bench_rand_range(16, 256));
+		for (i = 1; i < BENCH_SLOTS; i += 2)
+			bench_release(run, &run->slots[i]);
+		for (i = 1; i < BENCH_SLOTS; i += 2)
+			bench_alloc(run, &run->slots[i], bench_rand_range(512, 4096));
+
+		// Free everything in random order
+		for (i = 0; i < BENCH_SLOTS; ++i)
+			order[i] = i;
+		for (i = BENCH_SLOTS - 1; i > 0; --i)
+		{
+			const size_t j = bench_rand() % (i + 1);
+			const size_t tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+		for (i = 0; i < BENCH_SLOTS; ++i)
+			bench_release(run, &run->slots[order[i]]);
+	}
+}
+
+typedef struct {
+	const char* name;
+	void (*run)(bench_run* run);
+} bench_workload;
+
+static const bench_workload bench_workloads[] = {
+	{ "fixed_churn", bench_fixed_churn },
+	{ "random_sizes", bench_random_sizes },
+	{ "lifo", bench_lifo },
+	{ "fifo", bench_fifo },
+	{ "fragmentation", bench_fragmentation },
+};
+
+static void bench_execute(const bench_allocator* allocator, const bench_workload* workload, size_t alignment, size_t operations, uint64_t seed)
+{
+	static bench_run run;
+	size_t i;
+
+	memset(&run, 0, sizeof(run));
+	run.allocator = allocator;
+	run.alignment = alignment;
+	run.context = allocator->create(BENCH_POOL_SIZE);
+	bench_latencies_init(&run.latencies, operations);
+	bench_seed(seed);
+
+	workload->run(&run);
+
+	for (i = 0; i < BENCH_SLOTS; ++i)
+	{
+		if (run.slots[i].ptr)
+		{
+			allocator->release(run.context, run.slots[i].ptr, run.slots[i].size);
+			run.slots[i].ptr = NULL;
+		}
+	}
+	allocator->destroy(run.context);
+
+	bench_latencies_sort(&run.latencies);
+	printf("%-16s %-14s %5u %9u %8u %8.1f %7u %7u %7u %9u %12u\n",
+		allocator->name, workload->name, (unsigned)alignment,
+		(unsigned)run.operations, (unsigned)run.failures,
+		run.operations ? (double)run.latencies.total_ns / (double)run.operations : 0.0,
+		(unsigned)bench_percentile(&run.latencies, 0.50),
+		(unsigned)bench_percentile(&run.latencies, 0.90),
+		(unsigned)bench_percentile(&run.latencies, 0.99),
+		(unsigned)run.latencies.samples[run.latencies.count ? run.latencies.count - 1 : 0],
+		(unsigned)run.peak_metadata);
+	bench_latencies_free(&run.latencies);
+}
+
+/* Median cost of reading the clock twice, included in every latency sample. */
+static uint32_t bench_clock_overhead(void)
+{
+	bench_latencies latencies;
+	uint32_t median;
+	size_t i;
+
+	bench_latencies_init(&latencies, 1001);
+	for (i = 0; i < latencies.capacity; ++i)
+	{
+		const uint64_t start = bench_now_ns();
+		bench_latencies_add(&latencies, bench_now_ns() - start);
+	}
+	bench_latencies_sort(&latencies);
+	median = bench_percentile(&latencies, 0.5);
+	bench_latencies_free(&latencies);
+	return median;
+}
+
+int main(int argc, char** argv)
+{
+	static const size_t alignments[] = { 8, 64, 256 };
+	size_t operations = 200000;
+	uint64_t seed = 1;
+	size_t a, w, i;
+
+	if (argc > 1)
+		operations = (size_t)strtoull(argv[1], NULL, 10);
+	if (argc > 2)
+		seed = (uint64_t)strtoull(argv[2], NULL, 10);
+	if (operations == 0)
+		operations = 1;
+
+	printf("operations %u, seed %u, latencies in ns including ~%u ns of clock overhead\n", (unsigned)operations, (unsigned)seed, (unsigned)bench_clock_overhead());
+	printf("%-16s %-14s %5s %9s %8s %8s %7s %7s %7s %9s %12s\n",
+		"allocator", "workload", "align", "ops", "failed", "ns/op", "p50", "p90", "p99", "max", "peak_meta");
+
+	for (a = 0; a < BENCH_ALLOCATOR_COUNT; ++a)
+	{
+		const bench_allocator* allocator = &bench_allocators[a];
+		for (w = 0; w < sizeof(bench_workloads) / sizeof(bench_workloads[0]); ++w)
+		{
+			// Only vary the alignment where it is honoured
+			const size_t alignment_count = allocator->aligned ? sizeof(alignments) / sizeof(alignments[0]) : 1;
+			for (i = 0; i < alignment_count; ++i)
+				bench_execute(allocator, &bench_workloads[w], alignments[i], operations, seed);
+		}
+	}
+
+	return 0;
+}
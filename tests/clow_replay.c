@@ -0,0 +1,336 @@
+// Replays an allocation trace against the allocators.
+// Usage: clow_replay <trace> [fragmentation samples]
+//        clow_replay --generate <trace> [events] [seed]
+// Every allocator runs the trace twice from a fresh pool: once at full speed for the throughput, once timing
+// each operation for the latencies while sampling the fragmentation (1 - biggest free block / free bytes).
+
+#include "bench_common.h"
+#include "clow_trace.h"
+
+#define REPLAY_NONE UINT32_MAX
+#define REPLAY_MAX_SAMPLES 64
+
+typedef struct {
+	void* ptr;
+	size_t size;
+} replay_slot;
+
+/* The trace with pointer handles resolved to dense allocation ids. */
+typedef struct {
+	const clow_trace_event* events;
+	size_t event_count;
+	uint32_t* ids;         // Per event, REPLAY_NONE for frees of unknown pointers
+	size_t id_count;
+	size_t peak_live_bytes;
+	size_t max_alignment;
+} replay_trace;
+
+static size_t replay_hash(uint64_t handle, size_t mask)
+{
+	handle ^= handle >> 33;
+	handle *= 0xFF51AFD7ED558CCDull;
+	handle ^= handle >> 33;
+	return (size_t)handle & mask;
+}
+
+/* Pairs every free with its alloc through an open addressing table of the live handles. */
+static int replay_resolve(replay_trace* trace)
+{
+	uint64_t* keys;
+	uint32_t* values;
+	uint32_t* sizes;
+	size_t capacity = 16;
+	size_t live_bytes = 0;
+	size_t i;
+
+	while (capacity < trace->event_count * 2)
+		capacity *= 2;
+	keys = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+	values = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+	sizes = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+	trace->ids = (uint32_t*)malloc((trace->event_count + 1) * sizeof(uint32_t));
+	if (!keys || !values || !sizes || !trace->ids)
+	{
+		free(keys);
+		free(values);
+		free(sizes);
+		return 0;
+	}
+
+	trace->id_count = 0;
+	trace->peak_live_bytes = 0;
+	trace->max_alignment = 1;
+	for (i = 0; i < trace->event_count; ++i)
+	{
+		const clow_trace_event* event = &trace->events[i];
+		// Handle 0 marks an empty entry
+		const uint64_t key = event->handle + 1;
+		size_t h = replay_hash(key, capacity - 1);
+
+		while (keys[h] && keys[h] != key)
+			h = (h + 1) & (capacity - 1);
+
+		if (event->op == CLOW_TRACE_ALLOC)
+		{
+			// A live handle allocated again missed its free, the old allocation is leaked
+			keys[h] = key;
+			values[h] = (uint32_t)trace->id_count;
+			sizes[h] = event->size;
+			trace->ids[i] = (uint32_t)trace->id_count++;
+			live_bytes += event->size;
+			if (live_bytes > trace->peak_live_bytes)
+				trace->peak_live_bytes = live_bytes;
+			if (((size_t)1 << event->alignment_log2) > trace->max_alignment)
+				trace->max_alignment = (size_t)1 << event->alignment_log2;
+		}
+		else if (keys[h])
+		{
+			size_t j = h;
+
+			trace->ids[i] = values[h];
+			live_bytes -= sizes[h];
+
+			// Backward shift deletion keeps the probe sequences intact
+			keys[h] = 0;
+			for (;;)
+			{
+				size_t home;
+				j = (j + 1) & (capacity - 1);
+				if (!keys[j])
+					break;
+				home = replay_hash(keys[j], capacity - 1);
+				if (((j - home) & (capacity - 1)) >= ((j - h) & (capacity - 1)))
+				{
+					keys[h] = keys[j];
+					values[h] = values[j];
+					sizes[h] = sizes[j];
+					keys[j] = 0;
+					h = j;
+				}
+			}
+		}
+		else
+		{
+			// Freed before the capture started
+			trace->ids[i] = REPLAY_NONE;
+		}
+	}
+
+	free(keys);
+	free(values);
+	free(sizes);
+	return 1;
+}
+
+typedef struct {
+	size_t failures;
+	uint64_t throughput_ns;
+	bench_latencies latencies;
+	size_t samples;
+	double fragmentation[REPLAY_MAX_SAMPLES];
+} replay_result;
+
+/* Runs the whole trace, timing each operation and sampling the fragmentation when timed, else only the total. */
+static void replay_run(const bench_allocator* allocator, const replay_trace* trace, size_t pool_size, replay_slot* slots,
+	replay_result* result, int timed)
+{
+	void* context = allocator->create(pool_size);
+	const size_t sample_every = result->samples ? (trace->event_count + result->samples - 1) / result->samples : 0;
+	size_t sample = 0;
+	uint64_t start = 0;
+	size_t i;
+
+	memset(slots, 0, trace->id_count * sizeof(replay_slot));
+	result->failures = 0;
+	if (!timed)
+		start = bench_now_ns();
+
+	for (i = 0; i < trace->event_count; ++i)
+	{
+		const clow_trace_event* event = &trace->events[i];
+		const uint32_t id = trace->ids[i];
+		replay_slot* slot;
+		uint64_t op_start = 0;
+
+		if (id == REPLAY_NONE)
+			continue;
+		slot = &slots[id];
+
+		if (timed)
+			op_start = bench_now_ns();
+		if (event->op == CLOW_TRACE_ALLOC)
+		{
+			slot->size = event->size ? event->size : 1;
+			slot->ptr = allocator->alloc(context, slot->size, (size_t)1 << event->alignment_log2);
+			if (!slot->ptr)
+				++result->failures;
+		}
+		else if (slot->ptr)
+		{
+			allocator->release(context, slot->ptr, slot->size);
+			slot->ptr = NULL;
+		}
+		if (timed)
+		{
+			bench_latencies_add(&result->latencies, bench_now_ns() - op_start);
+
+			if (sample_every && (i + 1) % sample_every == 0 && sample < REPLAY_MAX_SAMPLES && allocator->free_space)
+			{
+				size_t free_bytes, largest;
+				allocator->free_space(context, &free_bytes, &largest);
+				result->fragmentation[sample++] = free_bytes ? 1.0 - (double)largest / (double)free_bytes : 0.0;
+			}
+		}
+	}
+
+	if (!timed)
+		result->throughput_ns = bench_now_ns() - start;
+
+	for (i = 0; i < trace->id_count; ++i)
+		if (slots[i].ptr)
+			allocator->release(context, slots[i].ptr, slots[i].size);
+	allocator->destroy(context);
+}
+
+static int replay(const char* path, size_t samples)
+{
+	clow_trace_view view;
+	replay_trace trace;
+	replay_slot* slots;
+	size_t pool_size;
+	size_t a, s;
+
+	if (!clow_trace_map(&view, path))
+	{
+		fprintf(stderr, "Can't read trace %s\n", path);
+		return 1;
+	}
+	memset(&trace, 0, sizeof(trace));
+	trace.events = view.events;
+	trace.event_count = view.event_count;
+	if (!replay_resolve(&trace))
+	{
+		fprintf(stderr, "Out of memory\n");
+		clow_trace_unmap(&view);
+		return 1;
+	}
+	slots = (replay_slot*)malloc((trace.id_count + 1) * sizeof(replay_slot));
+
+	// Twice the peak for headers, alignment and fragmentation
+	pool_size = trace.peak_live_bytes * 2 + trace.max_alignment * 2 + freelist_tlsf_overhead() + (1u << 20);
+
+	printf("%s: %u events, %u allocations, peak live %u bytes, pool %u bytes\n", path,
+		(unsigned)trace.event_count, (unsigned)trace.id_count, (unsigned)trace.peak_live_bytes, (unsigned)pool_size);
+	printf("%-16s %10s %8s %8s %9s  fragmentation over time\n", "allocator", "Mops/s", "failed", "p99", "max");
+
+	for (a = 0; a < BENCH_ALLOCATOR_COUNT; ++a)
+	{
+		const bench_allocator* allocator = &bench_allocators[a];
+		replay_result result;
+
+		memset(&result, 0, sizeof(result));
+		result.samples = samples;
+		replay_run(allocator, &trace, pool_size, slots, &result, 0);
+		bench_latencies_init(&result.latencies, trace.event_count);
+		replay_run(allocator, &trace, pool_size, slots, &result, 1);
+		bench_latencies_sort(&result.latencies);
+
+		printf("%-16s %10.2f %8u %8u %9u ", allocator->name,
+			result.throughput_ns ? (double)trace.event_count * 1000.0 / (double)result.throughput_ns : 0.0,
+			(unsigned)result.failures,
+			(unsigned)bench_percentile(&result.latencies, 0.99),
+			(unsigned)bench_percentile(&result.latencies, 1.0));
+		if (!allocator->free_space)
+			printf(" -");
+		for (s = 0; allocator->free_space && s < samples && s < REPLAY_MAX_SAMPLES; ++s)
+			printf(" %.2f", result.fragmentation[s]);
+		printf("\n");
+		bench_latencies_free(&result.latencies);
+	}
+
+	free(slots);
+	free(trace.ids);
+	clow_trace_unmap(&view);
+	return 0;
+}
+
+/* Engine like stream captured from libc malloc: per frame temporaries, long lived objects and a few big aligned buffers. */
+static int generate(const char* path, size_t events, uint64_t seed)
+{
+	enum { LIVE = 4096 };
+	static void* live[LIVE];
+	static void* frame[256];
+	clow_trace_writer writer;
+	size_t recorded = 0;
+	size_t live_count = 0;
+	size_t i;
+
+	if (!clow_trace_open(&writer, path))
+	{
+		fprintf(stderr, "Can't write trace %s\n", path);
+		return 1;
+	}
+	bench_seed(seed);
+
+	while (recorded < events)
+	{
+		const size_t temporaries = bench_rand_range(16, 256);
+
+		// Frame temporaries, freed in allocation order at the end of the frame
+		for (i = 0; i < temporaries; ++i)
+		{
+			const size_t size = bench_rand_range(16, 256);
+			frame[i] = malloc(size);
+			clow_trace_alloc(&writer, frame[i], size, 8);
+		}
+
+		// Long lived objects come and go
+		for (i = 0; i < 8; ++i)
+		{
+			const size_t slot = bench_rand() % LIVE;
+			if (live[slot])
+			{
+				clow_trace_free(&writer, live[slot]);
+				free(live[slot]);
+				live[slot] = NULL;
+				--live_count;
+			}
+			else
+			{
+				const int big = bench_rand() % 64 == 0;
+				const size_t size = big ? bench_rand_range(16384, 262144) : bench_rand_range(32, 2048);
+				live[slot] = malloc(size);
+				clow_trace_alloc(&writer, live[slot], size, big ? 256 : 16);
+				++live_count;
+			}
+		}
+
+		for (i = 0; i < temporaries; ++i)
+		{
+			clow_trace_free(&writer, frame[i]);
+			free(frame[i]);
+		}
+		recorded = (size_t)writer.event_count;
+	}
+
+	for (i = 0; i < LIVE; ++i)
+		free(live[i]);
+	if (!clow_trace_close(&writer))
+	{
+		fprintf(stderr, "Can't write trace %s\n", path);
+		return 1;
+	}
+	printf("%s: %u events, %u live at the end\n", path, (unsigned)recorded, (unsigned)live_count);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 3 && strcmp(argv[1], "--generate") == 0)
+		return generate(argv[2], argc > 3 ? (size_t)strtoull(argv[3], NULL, 10) : 1000000, argc > 4 ? (uint64_t)strtoull(argv[4], NULL, 10) : 1);
+	if (argc >= 2 && argv[1][0] != '-')
+		return replay(argv[1], argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : 10);
+
+	fprintf(stderr, "Usage: %s <trace> [fragmentation samples]\n       %s --generate <trace> [events] [seed]\n", argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,229 @@
+// Binary allocation trace, recorded from an application and replayed by clow_replay.
+// Standalone, include it where the allocations to capture happen:
+//
+//	clow_trace_writer trace;
+//	clow_trace_open(&trace, "engine.trace");
+//	p = my_alloc(size, alignment);
+//	clow_trace_alloc(&trace, p, size, alignment);
+//	clow_trace_free(&trace, p);
+//	my_free(p);
+//	clow_trace_close(&trace);
+//
+// The file is a clow_trace_header followed by header.event_count fixed size events, in host byte order.
+// Pointers are only used as handles to pair an alloc with its free, the replay maps them to its own allocations.
+
+#ifndef INCLUDED_CLOW_TRACE
+#define INCLUDED_CLOW_TRACE
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CLOW_TRACE_MAGIC 0x54574C43u  // "CLWT"
+#define CLOW_TRACE_VERSION 1u
+
+enum {
+	CLOW_TRACE_ALLOC = 1,
+	CLOW_TRACE_FREE = 2
+};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t event_count;
+} clow_trace_header;
+
+typedef struct {
+	uint64_t timestamp_ns;   // Since clow_trace_open
+	uint64_t handle;         // Pointer value of the allocation
+	uint32_t size;           // Requested bytes, 0 for free events
+	uint8_t op;              // CLOW_TRACE_ALLOC or CLOW_TRACE_FREE
+	uint8_t alignment_log2;  // Requested alignment, 0 for free events
+	uint16_t reserved;
+} clow_trace_event;
+
+typedef struct {
+	FILE* file;
+	uint64_t event_count;
+	uint64_t start_ns;
+} clow_trace_writer;
+
+typedef struct {
+	const clow_trace_event* events;
+	size_t event_count;
+	void* base;
+	size_t length;
+	int mapped;
+} clow_trace_view;
+
+static uint64_t clow_trace_now_ns(void)
+{
+	struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	timespec_get(&ts, TIME_UTC);
+#endif
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Creates the trace file. Success is 1 while 0 is error. */
+static int clow_trace_open(clow_trace_writer* writer, const char* path)
+{
+	clow_trace_header header;
+
+	writer->file = fopen(path, "wb");
+	writer->event_count = 0;
+	writer->start_ns = clow_trace_now_ns();
+	if (!writer->file)
+		return 0;
+
+	// The count is rewritten by clow_trace_close
+	header.magic = CLOW_TRACE_MAGIC;
+	header.version = CLOW_TRACE_VERSION;
+	header.event_count = 0;
+	return fwrite(&header, sizeof(header), 1, writer->file) == 1;
+}
+
+static void clow_trace_record(clow_trace_writer* writer, uint8_t op, const void* ptr, size_t size, size_t alignment)
+{
+	clow_trace_event event;
+	uint8_t alignment_log2 = 0;
+
+	if (!writer->file)
+		return;
+	while (((size_t)1 << alignment_log2) < alignment)
+		++alignment_log2;
+
+	event.timestamp_ns = clow_trace_now_ns() - writer->start_ns;
+	event.handle = (uint64_t)(uintptr_t)ptr;
+	event.size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+	event.op = op;
+	event.alignment_log2 = alignment_log2;
+	event.reserved = 0;
+	if (fwrite(&event, sizeof(event), 1, writer->file) == 1)
+		++writer->event_count;
+}
+
+/* Records a successful allocation, failed ones (ptr NULL) are skipped. */
+static void clow_trace_alloc(clow_trace_writer* writer, const void* ptr, size_t size, size_t alignment)
+{
+	if (ptr)
+		clow_trace_record(writer, CLOW_TRACE_ALLOC, ptr, size, alignment);
+}
+
+static void clow_trace_free(clow_trace_writer* writer, const void* ptr)
+{
+	if (ptr)
+		clow_trace_record(writer, CLOW_TRACE_FREE, ptr, 0, 0);
+}
+
+/* Writes the event count and closes the file. Success is 1 while 0 is error. */
+static int clow_trace_close(clow_trace_writer* writer)
+{
+	clow_trace_header header;
+	int ok;
+
+	if (!writer->file)
+		return 0;
+	header.magic = CLOW_TRACE_MAGIC;
+	header.version = CLOW_TRACE_VERSION;
+	header.event_count = writer->event_count;
+	ok = fseek(writer->file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, writer->file) == 1;
+	ok = fclose(writer->file) == 0 && ok;
+	writer->file = NULL;
+	return ok;
+}
+
+static void clow_trace_unmap(clow_trace_view* view)
+{
+#if !defined(_WIN32)
+	if (view->mapped)
+		munmap(view->base, view->length);
+	else
+#endif
+		free(view->base);
+	memset(view, 0, sizeof(*view));
+}
+
+/* Maps a trace read only, reading it in memory where mmap isn't available. Success is 1 while 0 is error. */
+static int clow_trace_map(clow_trace_view* view, const char* path)
+{
+	const clow_trace_header* header;
+	size_t length;
+
+	memset(view, 0, sizeof(*view));
+
+#if !defined(_WIN32)
+	{
+		struct stat st;
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return 0;
+		if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(clow_trace_header))
+		{
+			close(fd);
+			return 0;
+		}
+		length = (size_t)st.st_size;
+		view->base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (view->base == MAP_FAILED)
+		{
+			view->base = NULL;
+			return 0;
+		}
+		view->mapped = 1;
+	}
+#else
+	{
+		FILE* file = fopen(path, "rb");
+		long end;
+		if (!file)
+			return 0;
+		if (fseek(file, 0, SEEK_END) != 0 || (end = ftell(file)) < (long)sizeof(clow_trace_header) || fseek(file, 0, SEEK_SET) != 0)
+		{
+			fclose(file);
+			return 0;
+		}
+		length = (size_t)end;
+		view->base = malloc(length);
+		if (!view->base || fread(view->base, 1, length, file) != length)
+		{
+			free(view->base);
+			view->base = NULL;
+			fclose(file);
+			return 0;
+		}
+		fclose(file);
+	}
+#endif
+
+	view->length = length;
+	header = (const clow_trace_header*)view->base;
+	if (header->magic != CLOW_TRACE_MAGIC || header->version != CLOW_TRACE_VERSION
+		|| header->event_count > (length - sizeof(clow_trace_header)) / sizeof(clow_trace_event))
+	{
+		// Not a trace, other version or truncated
+		clow_trace_unmap(view);
+		return 0;
+	}
+	view->events = (const clow_trace_event*)((const char*)view->base + sizeof(clow_trace_header));
+	view->event_count = (size_t)header->event_count;
+	return 1;
+}
+
+#endif /*INCLUDED_CLOW_TRACE*/
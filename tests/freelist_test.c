@@ -35,12 +35,23 @@ static void* alloc(freelist_t* f, size_t size)
 	return a;
 }
 
+static void init_tlsf(freelist_t* f, char* buffer, size_t size)
+{
+	memset((void*)buffer, BUF_INIT_VALUE, size);
+
+	freelist_initialize_tlsf(f, buffer, size);
+	assert(freelist_verify_corruption(f) == 1);
+}
+
 static void deinit(freelist_t* f)
 {
 	freelist_verify_corruption(f);
 	freelist_reset(f);
 }
 
+/* Word aligned storage for the tests, ANSI C has no alignment specifier. */
+#define WORD_BUFFER(name, size) union { size_t word; double real; char bytes[size]; } name
+
 static void freelist_tests(void)
 {
 
@@ -173,6 +184,27 @@ static void freelist_tests(void)
 		deinit(&f);
 	}
 
+	// A remainder smaller than a free block node goes with the allocation
+	{
+		WORD_BUFFER(buffer, 40);
+		freelist_t f;
+		void* a;
+
+		init(&f, buffer.bytes, sizeof(buffer.bytes));
+
+		a = alloc(&f, 24);
+		assert(a);
+		assert(freelist_get_allocation_size(&f, a) == sizeof(buffer.bytes) - freelist_alloc_overhead());
+		assert(!alloc(&f, 16));
+
+		freelist_free(&f, a);
+		assert(freelist_verify_corruption(&f) == 1);
+		a = alloc(&f, 32);
+		assert(a);
+
+		deinit(&f);
+	}
+
 	// Catch metadata corruption when writing out of the allocation bounds
 	if (0/*This test throws also a memory corruption violation*/)
 	{
@@ -194,8 +226,356 @@ static void freelist_tests(void)
 
 }
 
+
+static void freelist_tlsf_tests(void)
+{
+	// Allocate 1 element
+	{
+		WORD_BUFFER(storage, 4096);
+		freelist_t f;
+		void* a;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+
+		a = alloc(&f, 16);
+		assert(a);
+		assert(freelist_range_check(&f, a) == 1);
+		assert(((uintptr_t)a) % sizeof(size_t) == 0 && "Must be aligned to the word size!");
+		assert(freelist_get_allocation_size(&f, a) >= 16);
+		freelist_free(&f, a);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		deinit(&f);
+	}
+
+	// Any free block that fits must be found, not only the most recently released one
+	{
+		WORD_BUFFER(storage, 4096);
+		freelist_t f;
+		void* a;
+		void* b;
+		void* c;
+		void* d;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+
+		a = alloc(&f, 512);
+		b = alloc(&f, 32);
+		c = alloc(&f, 32);
+		assert(a && b && c);
+		// Exhaust the rest of the buffer
+		while (alloc(&f, 32) != NULL)
+			;
+
+		// Free the big one first, then a small one that ends up at the head of the lists
+		freelist_free(&f, a);
+		freelist_free(&f, c);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		d = alloc(&f, 512);
+		assert(d == a && "Must reuse the only block that fits!");
+		((void)b);
+
+		deinit(&f);
+	}
+
+	// A free block must be found also when it's in the same size class of the request
+	{
+		WORD_BUFFER(storage, 8192);
+		freelist_t f;
+		void* a;
+		void* b;
+		void* c;
+		void* d;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+
+		a = alloc(&f, 32);
+		b = alloc(&f, 280);
+		c = alloc(&f, 32);
+		assert(a && b && c);
+		while (alloc(&f, 32) != NULL)
+			;
+
+		freelist_free(&f, b);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		d = alloc(&f, 280);
+		assert(d == b && "Must reuse the exact fit block!");
+		((void)a);
+		((void)c);
+
+		deinit(&f);
+	}
+
+	// Requests just under the whole free block must succeed on an empty pool
+	{
+		WORD_BUFFER(storage, 8192);
+		freelist_t f;
+		size_t pool;
+		void* a;
+
+		pool = 4064;
+		assert(freelist_tlsf_overhead() + pool <= sizeof(storage.bytes));
+
+		init_tlsf(&f, storage.bytes, freelist_tlsf_overhead() + pool);
+		a = alloc(&f, 4000);
+		assert(a && "Must fit in the empty pool!");
+		freelist_free(&f, a);
+
+		a = alloc(&f, 3969);
+		assert(a && "Must fit in the empty pool!");
+		freelist_free(&f, a);
+
+		a = alloc(&f, pool);
+		assert(a && "The whole pool must be allocatable!");
+		freelist_free(&f, a);
+
+		assert(alloc(&f, pool + 1) == NULL);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		deinit(&f);
+	}
+
+	// Free in scrambled order must coalesce back into a single block
+	{
+		WORD_BUFFER(storage, 16384);
+		freelist_t f;
+		void* allocations[64];
+		void* whole;
+		size_t i;
+		size_t count;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+
+		count = 0;
+		for (i = 0; i < 64; i++)
+		{
+			allocations[i] = alloc(&f, 8 + (i * 37) % 200);
+			if (allocations[i])
+				count++;
+		}
+		assert(count == 64);
+
+		// Free even, then odd in reverse
+		for (i = 0; i < 64; i += 2)
+		{
+			freelist_free(&f, allocations[i]);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+		for (i = 64; i-- > 0;)
+		{
+			if (!(i & 1))
+				continue;
+			freelist_free(&f, allocations[i]);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+
+		// Bigger than any hole left by the small blocks
+		whole = alloc(&f, sizeof(storage.bytes) / 2);
+		assert(whole && "All blocks must be merged back!");
+		freelist_free(&f, whole);
+
+		deinit(&f);
+	}
+
+	// Requesting more than available must fail
+	{
+		WORD_BUFFER(storage, 8192);
+		freelist_t f;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+		assert(alloc(&f, sizeof(storage.bytes)) == NULL);
+		deinit(&f);
+	}
+
+	// Too small buffer must not write out of bounds, allocations just fail
+	{
+		WORD_BUFFER(storage, 64);
+		freelist_t f;
+
+		memset(storage.bytes, BUF_INIT_VALUE, sizeof(storage.bytes));
+		if (0/*Asserts in debug builds*/)
+		{
+			freelist_initialize_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+			assert(freelist_malloc(&f, 16) == NULL);
+		}
+	}
+}
+
+/* Sum of the free blocks of the list mode. */
+static size_t free_bytes(freelist_t* f)
+{
+	freelist_block* block;
+	size_t sum = 0;
+	for (block = f->free_block; block; block = block->next)
+		sum += block->block_size;
+	return sum;
+}
+
+static void freelist_aligned_tests(void)
+{
+	// List mode, every alignment is honoured and the padding goes back to the free list
+	{
+		WORD_BUFFER(buffer, 4096);
+		static const size_t alignments[] = { 2, 8, 16, 32, 64, 256 };
+		freelist_t f;
+		void* allocations[6];
+		size_t i;
+
+		init(&f, buffer.bytes, sizeof(buffer.bytes));
+		for (i = 0; i < 6; i++)
+		{
+			allocations[i] = freelist_malloc_aligned(&f, 40, alignments[i]);
+			assert(allocations[i]);
+			assert(((uintptr_t)allocations[i]) % alignments[i] == 0);
+			assert(freelist_get_allocation_size(&f, allocations[i]) >= 40);
+			memset(allocations[i], BUF_ALLOC_VALUE, 40);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+		for (i = 0; i < 6; i++)
+		{
+			assert(((unsigned char*)allocations[i])[39] == (unsigned char)BUF_ALLOC_VALUE && "Allocations must not overlap!");
+			freelist_free(&f, allocations[i]);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+		assert(free_bytes(&f) == sizeof(buffer.bytes) && "No byte must be lost to the padding!");
+
+		deinit(&f);
+	}
+
+	// List mode, a padding too small for a free block moves to the next aligned address
+	{
+		WORD_BUFFER(buffer, 256);
+		freelist_t f;
+		void* a;
+
+		init(&f, buffer.bytes, sizeof(buffer.bytes));
+		a = freelist_malloc_aligned(&f, 16, sizeof(size_t) * 2);
+		assert(a && ((uintptr_t)a) % (sizeof(size_t) * 2) == 0);
+		assert((uintptr_t)a - freelist_alloc_overhead() == (uintptr_t)buffer.bytes
+			|| (uintptr_t)a - freelist_alloc_overhead() - (uintptr_t)buffer.bytes >= freelist_min_alloc_block());
+		freelist_free(&f, a);
+		assert(free_bytes(&f) == sizeof(buffer.bytes));
+
+		// No room for the padding
+		assert(freelist_malloc_aligned(&f, 200, 1024) == NULL);
+		deinit(&f);
+	}
+
+	// TLSF mode, aligned blocks and the padding coalesce back into the whole pool
+	{
+		WORD_BUFFER(storage, 16384);
+		freelist_t f;
+		void* allocations[32];
+		void* whole;
+		size_t i;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+		for (i = 0; i < 32; i++)
+		{
+			const size_t alignment = (size_t)16 << (i % 4);
+			allocations[i] = freelist_malloc_aligned(&f, 24 + i * 8, alignment);
+			assert(allocations[i]);
+			assert(((uintptr_t)allocations[i]) % alignment == 0);
+			memset(allocations[i], BUF_ALLOC_VALUE, 24 + i * 8);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+		for (i = 0; i < 32; i++)
+		{
+			freelist_free(&f, allocations[i]);
+			assert(freelist_verify_corruption(&f) == 1);
+		}
+
+		whole = alloc(&f, sizeof(storage.bytes) - freelist_tlsf_overhead() - 64);
+		assert(whole && "Padding blocks must be merged back!");
+		freelist_free(&f, whole);
+
+		// Word alignment is the plain allocation
+		assert(freelist_malloc_aligned(&f, 16, sizeof(size_t)) != NULL);
+		deinit(&f);
+	}
+}
+
+static void freelist_realloc_tests(void)
+{
+	// List mode, grows into the free block after it and gives back the tail
+	{
+		WORD_BUFFER(buffer, 512);
+		freelist_t f;
+		char* a;
+		char* b;
+		char* c;
+
+		init(&f, buffer.bytes, sizeof(buffer.bytes));
+		a = (char*)alloc(&f, 32);
+		assert(freelist_realloc(&f, a, 100) == a && "Next block is free, must grow in place!");
+		assert(freelist_get_allocation_size(&f, a) == 104 && "Rounded to the word size!");
+		assert(freelist_verify_corruption(&f) == 1);
+		assert(free_bytes(&f) == sizeof(buffer.bytes) - 104 - freelist_alloc_overhead());
+
+		assert(freelist_realloc(&f, a, 32) == a);
+		assert(freelist_get_allocation_size(&f, a) == 32);
+		assert(free_bytes(&f) == sizeof(buffer.bytes) - 32 - freelist_alloc_overhead() && "Tail must be released and merged!");
+
+		// Blocked by a used block, the content moves
+		b = (char*)alloc(&f, 32);
+		assert(b == a + 32 + freelist_alloc_overhead());
+		c = (char*)freelist_realloc(&f, a, 64);
+		assert(c && c != a);
+		assert(c[0] == (char)BUF_ALLOC_VALUE && c[31] == (char)BUF_ALLOC_VALUE);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		// Failure keeps the allocation
+		assert(freelist_realloc(&f, c, 1024) == NULL);
+		assert(c[0] == (char)BUF_ALLOC_VALUE);
+
+		freelist_free(&f, b);
+		assert(freelist_realloc(&f, c, 0) == NULL);
+		assert(free_bytes(&f) == sizeof(buffer.bytes));
+		deinit(&f);
+	}
+
+	// TLSF mode, in place both ways and moves when the next block is used
+	{
+		WORD_BUFFER(storage, 8192);
+		freelist_t f;
+		char* a;
+		char* b;
+		char* c;
+		void* whole;
+
+		init_tlsf(&f, storage.bytes, sizeof(storage.bytes));
+		a = (char*)alloc(&f, 64);
+		memset(a, BUF_ALLOC_VALUE, 64);
+		assert(freelist_realloc(&f, a, 1000) == a);
+		assert(freelist_get_allocation_size(&f, a) >= 1000);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		assert(freelist_realloc(&f, a, 64) == a);
+		assert(freelist_get_allocation_size(&f, a) == 64);
+		assert(freelist_verify_corruption(&f) == 1);
+
+		b = (char*)alloc(&f, 64);
+		c = (char*)freelist_realloc(&f, a, 256);
+		assert(c && c != a && c[63] == (char)BUF_ALLOC_VALUE);
+		assert(freelist_verify_corruption(&f) == 1);
+		assert(freelist_realloc(&f, b, sizeof(storage.bytes)) == NULL);
+
+		freelist_free(&f, b);
+		freelist_free(&f, c);
+		whole = alloc(&f, sizeof(storage.bytes) - freelist_tlsf_overhead());
+		assert(whole && "Everything must merge back!");
+		freelist_free(&f, whole);
+		deinit(&f);
+	}
+}
+
 int main(void)
 {
 	freelist_tests();
+	freelist_tlsf_tests();
+	freelist_aligned_tests();
+	freelist_realloc_tests();
 	return 0;
 }
@@ -15,6 +15,60 @@ static void* offset_ptr(void* begin, size_t offset)
 #define BUF_INIT_VALUE ((size_t)'A')
 #define BUF_ALLOC_VALUE ((size_t)'W')
 
+/* The free index must track exactly the free blocks of the allocation array. */
+static void check_free_index(gpalloc_t* gpa)
+{
+	size_t free_blocks = 0;
+	size_t i;
+	for (i = 0; i < gpa->allocation_array_size; i++)
+	{
+		const gpalloc_allocation block = gpalloc_block_get(gpa, i);
+		if (block.used)
+			continue;
+		free_blocks++;
+
+		uint32_t node;
+		uint16_t pos;
+		const gpalloc_index_key key = { .size = block.size, .address = (uintptr_t)block.address };
+		gpalloc_index_lower_bound(&gpa->free_index, key, &node, &pos);
+		assert(node != GPALLOC_INDEX_NULL && "Free block must be in the index!");
+		assert(gpa->free_index.nodes[node].keys[pos].size == key.size && gpa->free_index.nodes[node].keys[pos].address == key.address);
+	}
+	assert(free_blocks == gpa->free_index.count);
+}
+
+/* Fixed metadata region, a bump allocator that resizes the last block in place and fails when full. */
+typedef struct {
+	char* buffer;
+	size_t size;
+	size_t used;
+	void* last;
+	size_t calls;
+} metadata_region;
+
+static void* metadata_region_realloc(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	metadata_region* region = (metadata_region*)user;
+	region->calls++;
+	if (new_size == 0)
+		return NULL; // Released with the region
+	if (ptr != NULL && ptr == region->last && (size_t)((char*)ptr - region->buffer) + new_size <= region->size)
+	{
+		region->used = (size_t)((char*)ptr - region->buffer) + new_size;
+		return ptr;
+	}
+
+	const size_t start = (region->used + 15) & ~(size_t)15;
+	if (start > region->size || region->size - start < new_size)
+		return NULL;
+	void* block = region->buffer + start;
+	if (ptr != NULL)
+		memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+	region->used = start + new_size;
+	region->last = block;
+	return block;
+}
+
 static void gpalloc_tests(void)
 {
 	// Allocate 1 element
@@ -95,8 +149,1169 @@ static void gpalloc_tests(void)
 	}
 }
 
+static void gpalloc_free_index_tests(void)
+{
+	// Best fit must pick the smallest hole that fits, not the first one
+	{
+		_Alignas(16) char buffer[4096];
+		memset(buffer, BUF_INIT_VALUE, 4096);
+
+		gpalloc_t gpa;
+		gpalloc_options options = { .policy = GPALLOC_BEST_FIT };
+		gpalloc_initialize_ex(&gpa, buffer, 4096, &options);
+
+		void* a = gpalloc_malloc(&gpa, 64, 1);
+		void* b = gpalloc_malloc(&gpa, 16, 1);
+		void* c = gpalloc_malloc(&gpa, 32, 1);
+		void* d = gpalloc_malloc(&gpa, 16, 1);
+		assert(a && b && c && d);
+		gpalloc_free(&gpa, a);
+		gpalloc_free(&gpa, c);
+		check_free_index(&gpa);
+
+		void* e = gpalloc_malloc(&gpa, 32, 1);
+		assert(e == c && "Must reuse the exact fit hole!");
+		check_free_index(&gpa);
+
+		void* f = gpalloc_malloc(&gpa, 48, 16);
+		assert(f == a && "Must reuse the smallest hole that fits!");
+		assert(((uintptr_t)f) % 16 == 0 && "Must be aligned!");
+		check_free_index(&gpa);
+
+		gpalloc_free(&gpa, b);
+		gpalloc_free(&gpa, d);
+		gpalloc_free(&gpa, e);
+		gpalloc_free(&gpa, f);
+		check_free_index(&gpa);
+		assert(gpa.allocation_array_size == 1 && "Must coalesce back into a single block!");
+
+		gpalloc_destroy(&gpa);
+	}
+
+	// Many allocations with scrambled frees to split and shrink the tree
+	{
+		enum { count = 300 };
+		static _Alignas(64) char buffer[count * 96];
+		void* allocations[count];
+
+		gpalloc_t gpa;
+		gpalloc_options options = { .policy = GPALLOC_BEST_FIT };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		size_t i;
+		for (i = 0; i < count; i++)
+		{
+			const size_t alignment = (size_t)1 << (i % 5);
+			allocations[i] = gpalloc_malloc(&gpa, 8 + (i * 7) % 40, alignment);
+			assert(allocations[i] && "Must return valid ptr!");
+			assert(((uintptr_t)allocations[i]) % alignment == 0 && "Must be aligned!");
+		}
+		check_free_index(&gpa);
+
+		// Every third block, leaves many holes of different sizes
+		for (i = 0; i < count; i += 3)
+		{
+			gpalloc_free(&gpa, allocations[i]);
+			allocations[i] = NULL;
+		}
+		check_free_index(&gpa);
+
+		// Refill the holes
+		for (i = 0; i < count; i += 3)
+		{
+			allocations[i] = gpalloc_malloc(&gpa, 8, 8);
+			assert(allocations[i] && "Must return valid ptr!");
+		}
+		check_free_index(&gpa);
+
+		for (i = count; i-- > 0;)
+		{
+			gpalloc_free(&gpa, allocations[i]);
+		}
+		check_free_index(&gpa);
+		assert(gpa.allocation_array_size == 1 && "Must coalesce back into a single block!");
+		assert(gpa.free_index.count == 1);
+
+		gpalloc_destroy(&gpa);
+	}
+}
+
+static void gpalloc_verify_tests(void)
+{
+	// Valid metadata must pass the full sweep, with and without the free index
+	{
+		_Alignas(16) char buffer[1024];
+		size_t k;
+		for (k = 0; k < 2; k++)
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = (gpalloc_policy)k };
+			gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			void* a = gpalloc_malloc(&gpa, 24, 8);
+			void* b = gpalloc_malloc(&gpa, 40, 32);
+			void* c = gpalloc_malloc(&gpa, 8, 64);
+			assert(a && b && c);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			gpalloc_free(&gpa, b);
+			assert(gpalloc_verify(&gpa) == 1);
+			gpalloc_free(&gpa, a);
+			gpalloc_free(&gpa, c);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// Corrupted metadata must be detected
+	{
+		_Alignas(16) char buffer[1024];
+		gpalloc_t gpa;
+		gpalloc_options options = { .policy = GPALLOC_BEST_FIT };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		void* a = gpalloc_malloc(&gpa, 64, 1);
+		void* b = gpalloc_malloc(&gpa, 64, 1);
+		assert(a && b);
+
+		// Overlapping blocks
+		gpalloc_allocation block = gpalloc_block_get(&gpa, 0);
+		block.size += 1;
+		gpalloc_block_set(&gpa, 0, block);
+		assert(gpalloc_verify(&gpa) == 0);
+		block.size -= 1;
+		gpalloc_block_set(&gpa, 0, block);
+		assert(gpalloc_verify(&gpa) == 1);
+
+		// Free block missing from the index
+		block = gpalloc_block_get(&gpa, 1);
+		block.used = false;
+		gpalloc_block_set(&gpa, 1, block);
+		assert(gpalloc_verify(&gpa) == 0);
+		block.used = true;
+		gpalloc_block_set(&gpa, 1, block);
+		assert(gpalloc_verify(&gpa) == 1);
+
+		gpalloc_free(&gpa, a);
+		gpalloc_free(&gpa, b);
+		gpalloc_destroy(&gpa);
+	}
+}
+
+static void gpalloc_realloc_tests(void)
+{
+	// In place growth into the free neighbour, shrinking gives the tail back, moves only when blocked
+	{
+		_Alignas(16) char buffer[1024];
+		size_t k;
+		for (k = 0; k < 2; k++)
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = (gpalloc_policy)k };
+			gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+			char* a = (char*)gpalloc_malloc(&gpa, 64, 16);
+			assert(a);
+			memset(a, BUF_ALLOC_VALUE, 64);
+
+			assert(gpalloc_realloc(&gpa, a, 256, 16) == a && "Next block is free, must grow in place!");
+			assert(gpalloc_block_get(&gpa, 0).size == 256);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			assert(gpalloc_realloc(&gpa, a, 32, 16) == a);
+			assert(gpalloc_block_get(&gpa, 0).size == 32 && gpa.allocation_array_size == 2 && "Tail must merge with the free block!");
+			assert(gpalloc_verify(&gpa) == 1);
+
+			// Blocked by a used neighbour, the content moves
+			void* b = gpalloc_malloc(&gpa, 32, 16);
+			assert(b == (void*)(a + 32));
+			char* c = (char*)gpalloc_realloc(&gpa, a, 128, 16);
+			assert(c && c != a);
+			assert(c[0] == (char)BUF_ALLOC_VALUE && c[31] == (char)BUF_ALLOC_VALUE);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			// Shrinking against a used neighbour inserts a free block
+			assert(gpalloc_realloc(&gpa, b, 16, 16) == b);
+			assert(gpalloc_verify(&gpa) == 1);
+
+			// Failure leaves the allocation as it was
+			assert(gpalloc_realloc(&gpa, c, sizeof(buffer), 16) == NULL);
+			assert(c[0] == (char)BUF_ALLOC_VALUE);
+			assert(gpalloc_verify(&gpa) == 1);
+			if (k)
+				check_free_index(&gpa);
+
+			assert(gpalloc_realloc(&gpa, c, 0, 16) == NULL);
+			gpalloc_free(&gpa, b);
+			assert(gpa.allocation_array_size == 1 && gpalloc_verify(&gpa) == 1);
+
+			// NULL is a plain allocation
+			a = (char*)gpalloc_realloc(&gpa, NULL, 8, 8);
+			assert(a);
+			gpalloc_free(&gpa, a);
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// Exact fit consumes the whole neighbour
+	{
+		_Alignas(16) char buffer[256];
+		gpalloc_t gpa;
+		gpalloc_initialize(&gpa, buffer, sizeof(buffer));
+		void* a = gpalloc_malloc(&gpa, 64, 1);
+		assert(gpalloc_realloc(&gpa, a, sizeof(buffer), 1) == a);
+		assert(gpa.allocation_array_size == 1 && gpalloc_block_get(&gpa, 0).used);
+		gpalloc_free(&gpa, a);
+		gpalloc_destroy(&gpa);
+	}
+}
+
+static void gpalloc_metadata_tests(void)
+{
+	// A full metadata region fails the allocation cleanly, the allocator stays consistent
+	{
+		_Alignas(16) char buffer[1 << 16];
+		_Alignas(16) char metadata[1024];
+		size_t k;
+		for (k = 0; k < 2; k++)
+		{
+			metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+			gpalloc_options options = { .policy = (gpalloc_policy)k, .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+			void* allocations[1024];
+			size_t count = 0;
+			gpalloc_t gpa;
+
+			assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options) == 1);
+			assert(region.calls > 0 && "Metadata must come from the callback!");
+
+			// 16 bytes each, the buffer has room for more than the metadata can describe
+			while (count < 1024 && (allocations[count] = gpalloc_malloc(&gpa, 16, 16)) != NULL)
+				count++;
+			assert(count > 0 && count < 1024);
+			assert(gpalloc_verify(&gpa) == 1);
+			assert(region.used <= region.size);
+
+			while (count > 0)
+				gpalloc_free(&gpa, allocations[--count]);
+			assert(gpa.allocation_array_size == 1 && gpalloc_verify(&gpa) == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// No room at all, initialization reports it and nothing can be allocated
+	{
+		_Alignas(16) char buffer[256];
+		metadata_region region = { .buffer = NULL, .size = 0 };
+		gpalloc_options options = { .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		gpalloc_t gpa;
+
+		assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options) == 0);
+		assert(gpalloc_malloc(&gpa, 16, 8) == NULL);
+		gpalloc_destroy(&gpa);
+	}
+}
+
+#if GPALLOC_COMPACT_TABLE
+static void gpalloc_compact_tests(void)
+{
+	// The vector search must find the same blocks as the scalar one, across the bitmap words too
+	{
+		static _Alignas(16) char buffer[1 << 18];
+		void* allocations[600];
+		gpalloc_t gpa;
+		size_t i;
+
+		assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), NULL) == 1);
+		for (i = 0; i < 600; i++)
+		{
+			allocations[i] = gpalloc_malloc(&gpa, 1 + (i * 37) % 200, 1);
+			assert(allocations[i]);
+		}
+		for (i = 0; i < 600; i += 3)
+		{
+			gpalloc_free(&gpa, allocations[i]);
+			allocations[i] = NULL;
+		}
+		assert(gpa.allocation_array_size > 128);
+		assert(gpalloc_verify(&gpa) == 1);
+
+		uint32_t size;
+		for (size = 1; size < 260; size += 7)
+		{
+			uint32_t alignment;
+			for (alignment = 1; alignment <= 512; alignment *= 8)
+			{
+				size_t start;
+				for (start = 0; start <= gpa.allocation_array_size; start += 5)
+				{
+					const size_t found = gpalloc_find_free_scalar(&gpa, start, size, alignment - 1);
+					assert(gpalloc_find_free(&gpa, start, size, alignment - 1) == found);
+
+					// Exactly the first block where gpalloc_block_fit succeeds
+					size_t expected = start;
+					while (expected < gpa.allocation_array_size)
+					{
+						const gpalloc_allocation block = gpalloc_block_get(&gpa, expected);
+						if (!block.used && gpalloc_block_fit(&block, size, alignment))
+							break;
+						expected++;
+					}
+					assert(found == expected);
+				}
+			}
+		}
+
+		// First fit takes the lowest free block that fits
+		const size_t first = gpalloc_find_free_scalar(&gpa, 0, 150, 63);
+		assert(first < gpa.allocation_array_size);
+		const gpalloc_allocation first_block = gpalloc_block_get(&gpa, first);
+		assert(gpalloc_malloc(&gpa, 150, 64) == gpalloc_block_fit(&first_block, 150, 64));
+		assert(gpalloc_verify(&gpa) == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Half the metadata of the array of structs on 64 bit targets
+	{
+		_Alignas(16) char buffer[256];
+		gpalloc_t gpa;
+		gpalloc_initialize(&gpa, buffer, sizeof(buffer));
+		assert(gpalloc_table_bytes(&gpa) <= gpa.allocation_array_capacity * (2 * sizeof(uint32_t) + sizeof(uint64_t)));
+		gpalloc_destroy(&gpa);
+	}
+
+#if SIZE_MAX > UINT32_MAX
+	// Offsets are 32 bit
+	{
+		_Alignas(16) char buffer[256];
+		gpalloc_t gpa;
+		assert(gpalloc_initialize_ex(&gpa, buffer, (size_t)UINT32_MAX + 1, NULL) == 0);
+		assert(gpalloc_malloc(&gpa, 16, 8) == NULL);
+		gpalloc_destroy(&gpa);
+	}
+#endif
+}
+#endif
+
+/* Owner of the allocations in the defragmentation tests, moves fix up the pointer table. */
+typedef struct {
+	void* pointers[64];
+	size_t count;
+	size_t moves;
+	size_t bytes;
+} defragment_owner;
+
+static void defragment_move(void* user, void* from, void* to, size_t size)
+{
+	defragment_owner* owner = (defragment_owner*)user;
+	size_t i;
+	assert((uintptr_t)to < (uintptr_t)from && "Blocks only slide down!");
+	memmove(to, from, size);
+	for (i = 0; i < owner->count; i++)
+		if (owner->pointers[i] == from)
+			owner->pointers[i] = to;
+	owner->moves++;
+	owner->bytes += size;
+}
+
+static void gpalloc_defragment_tests(void)
+{
+	// Full pass gathers the free space at the end, contents and alignments are kept
+	{
+		_Alignas(256) static char buffer[1 << 14];
+		size_t k;
+		for (k = 0; k < 2; k++)
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = (gpalloc_policy)k };
+			defragment_owner owner;
+			size_t i;
+			memset(&owner, 0, sizeof(owner));
+			gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+			void* all[64];
+			for (i = 0; i < 64; i++)
+			{
+				const size_t alignment = i % 8 == 0 ? 64 : 8;
+				all[i] = gpalloc_malloc(&gpa, 24 + i * 3, alignment);
+				assert(all[i]);
+				memset(all[i], (int)i, 24 + i * 3);
+			}
+			for (i = 0; i < 64; i++)
+			{
+				if (i % 3 == 0)
+					gpalloc_free(&gpa, all[i]);
+				else
+					owner.pointers[owner.count++] = all[i];
+			}
+			assert(gpalloc_malloc(&gpa, sizeof(buffer) - 6000, 8) == NULL);
+
+			assert(gpalloc_defragment(&gpa, 0, defragment_move, &owner) == 1);
+			assert(gpalloc_verify(&gpa) == 1);
+			if (k)
+				check_free_index(&gpa);
+			assert(owner.moves > 0);
+
+			// Used blocks are packed up to the alignment padding, one free block at the end
+			const gpalloc_allocation last = gpalloc_block_get(&gpa, gpa.allocation_array_size - 1);
+			assert(!last.used);
+			for (i = 0; i + 1 < gpa.allocation_array_size; i++)
+			{
+				const gpalloc_allocation block = gpalloc_block_get(&gpa, i);
+				assert(block.used || block.size < GPALLOC_DEFRAGMENT_ALIGNMENT);
+			}
+			for (i = 0; i < owner.count; i++)
+			{
+				const size_t n = i + i / 2 + 1;
+				const unsigned char* bytes = (const unsigned char*)owner.pointers[i];
+				assert(bytes[0] == (unsigned char)n && bytes[23] == (unsigned char)n && "Moved content must be kept!");
+				if (n % 8 == 0)
+					assert((uintptr_t)bytes % 64 == 0 && "Alignment must be kept!");
+			}
+
+			void* big = gpalloc_malloc(&gpa, sizeof(buffer) - 6000, 8);
+			assert(big && "The free space must be in one block!");
+			gpalloc_free(&gpa, big);
+
+			// Nothing left to move
+			owner.moves = 0;
+			assert(gpalloc_defragment(&gpa, 0, defragment_move, &owner) == 1);
+			assert(owner.moves == 0);
+			for (i = 0; i < owner.count; i++)
+				gpalloc_free(&gpa, owner.pointers[i]);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// Incremental, every call stays within the budget and the passes end with the same packing
+	{
+		_Alignas(256) static char buffer[1 << 14];
+		gpalloc_t gpa;
+		defragment_owner owner;
+		size_t i, calls = 0;
+		memset(&owner, 0, sizeof(owner));
+		gpalloc_initialize(&gpa, buffer, sizeof(buffer));
+
+		void* all[64];
+		for (i = 0; i < 64; i++)
+			all[i] = gpalloc_malloc(&gpa, i == 11 ? 1000 : 100, 8);
+		for (i = 0; i < 64; i++)
+		{
+			if (i % 2 == 0)
+				gpalloc_free(&gpa, all[i]);
+			else
+				owner.pointers[owner.count++] = all[i];
+		}
+		void* first = owner.pointers[0];
+		for (;;)
+		{
+			const size_t before = owner.bytes;
+			const int done = gpalloc_defragment(&gpa, 250, defragment_move, &owner);
+			assert(owner.bytes - before <= 250);
+			assert(gpalloc_verify(&gpa) == 1);
+			calls++;
+			if (done)
+				break;
+		}
+		assert(calls > 10);
+		assert(owner.pointers[0] == (void*)buffer && first != owner.pointers[0]);
+
+		// Blocks over the budget stay, everything else after them is packed
+		for (i = 0; i < gpa.allocation_array_size; i++)
+		{
+			const gpalloc_allocation block = gpalloc_block_get(&gpa, i);
+			if (!block.used && block.size >= GPALLOC_DEFRAGMENT_ALIGNMENT)
+				assert(i + 1 == gpa.allocation_array_size || gpalloc_block_get(&gpa, i + 1).size == 1000);
+		}
+
+		// An allocation between the calls doesn't break the pass
+		void* extra = gpalloc_malloc(&gpa, 100, 8);
+		assert(gpalloc_defragment(&gpa, 0, defragment_move, &owner) == 1);
+		assert(gpalloc_verify(&gpa) == 1);
+		gpalloc_free(&gpa, extra);
+		gpalloc_destroy(&gpa);
+	}
+}
+
+static void gpalloc_handle_tests(void)
+{
+	// Handles resolve to their block, released handles and their copies are stale, slots are recycled
+	{
+		_Alignas(16) static char buffer[4096];
+		gpalloc_t gpa;
+		gpalloc_initialize(&gpa, buffer, sizeof(buffer));
+
+		const gpalloc_handle a = gpalloc_halloc(&gpa, 100, 16);
+		const gpalloc_handle b = gpalloc_halloc(&gpa, 200, 16);
+		assert(a != GPALLOC_NULL_HANDLE && b != GPALLOC_NULL_HANDLE && a != b);
+		assert(gpalloc_resolve(&gpa, a) == (void*)buffer);
+		assert((uintptr_t)gpalloc_resolve(&gpa, b) % 16 == 0);
+		assert(gpalloc_resolve(&gpa, GPALLOC_NULL_HANDLE) == NULL);
+		assert(gpalloc_resolve(&gpa, b + 1) == NULL && "Index out of the table!");
+
+		gpalloc_hfree(&gpa, a);
+		assert(gpalloc_resolve(&gpa, a) == NULL);
+		const gpalloc_handle c = gpalloc_halloc(&gpa, 50, 16);
+		assert((c & 0xFFFFFFFFu) == (a & 0xFFFFFFFFu) && c != a && "Slot is reused with a new generation!");
+		assert(gpalloc_resolve(&gpa, a) == NULL && gpalloc_resolve(&gpa, c) == (void*)buffer);
+
+		// Failed allocations don't consume a slot
+		assert(gpalloc_halloc(&gpa, sizeof(buffer), 16) == GPALLOC_NULL_HANDLE);
+		assert(gpa.handles_size == 2);
+
+		gpalloc_hfree(&gpa, b);
+		gpalloc_hfree(&gpa, c);
+		assert(gpa.allocation_array_size == 1 && gpalloc_verify(&gpa) == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Compaction moves the handle allocations only, the content follows and the raw allocations stay
+	{
+		_Alignas(256) static char buffer[1 << 14];
+		gpalloc_handle handles[64];
+		size_t k, i;
+		for (k = 0; k < 2; k++)
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = (gpalloc_policy)k };
+			gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+			void* raw = NULL;
+			for (i = 0; i < 64; i++)
+			{
+				if (i == 40)
+					raw = gpalloc_malloc(&gpa, 64, 8);
+				handles[i] = gpalloc_halloc(&gpa, 40 + i, 8);
+				assert(handles[i] != GPALLOC_NULL_HANDLE);
+				memset(gpalloc_resolve(&gpa, handles[i]), (int)i, 40 + i);
+			}
+			for (i = 0; i < 64; i += 2)
+				gpalloc_hfree(&gpa, handles[i]);
+
+			size_t calls = 0;
+			while (!gpalloc_hcompact(&gpa, 300))
+			{
+				assert(gpalloc_verify(&gpa) == 1);
+				calls++;
+			}
+			assert(calls > 0);
+			if (k)
+				check_free_index(&gpa);
+
+			assert(gpalloc_resolve(&gpa, handles[1]) == (void*)buffer);
+			for (i = 1; i < 64; i += 2)
+			{
+				const unsigned char* bytes = (const unsigned char*)gpalloc_resolve(&gpa, handles[i]);
+				assert(bytes && bytes[0] == (unsigned char)i && bytes[39 + i] == (unsigned char)i && "Moved content must be kept!");
+				assert((uintptr_t)bytes % 8 == 0);
+				if (i < 40)
+					assert(bytes < (unsigned char*)raw);
+			}
+			const size_t raw_index = gpalloc_lower_bound(&gpa, raw);
+			assert(gpalloc_block_address(&gpa, raw_index) == (uintptr_t)raw && gpalloc_block_get(&gpa, raw_index).used && "Raw allocations must stay!");
+
+			for (i = 1; i < 64; i += 2)
+				gpalloc_hfree(&gpa, handles[i]);
+			gpalloc_free(&gpa, raw);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+}
+
+static void gpalloc_address_map_tests(void)
+{
+	// Allocation sizes, without and with the map
+	{
+		_Alignas(16) char buffer[1024];
+		size_t page;
+		for (page = 0; page <= 128; page += 128)
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .address_map_page = page };
+			assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options));
+			assert((gpa.address_map != NULL) == (page != 0));
+
+			void* a = gpalloc_malloc(&gpa, 24, 8);
+			void* b = gpalloc_malloc(&gpa, 300, 64);
+			assert(a && b);
+			assert(gpalloc_get_allocation_size(&gpa, a) == 24);
+			assert(gpalloc_get_allocation_size(&gpa, b) == 300);
+			b = gpalloc_realloc(&gpa, b, 100, 64);
+			assert(gpalloc_get_allocation_size(&gpa, b) == 100);
+
+			gpalloc_free(&gpa, a);
+			gpalloc_free(&gpa, b);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// Churn with splits, merges, in place reallocs and moves, the map must always give the same block as the full search
+	{
+		_Alignas(256) static char buffer[1 << 15];
+		size_t k, page;
+		for (k = 0; k < 2; k++)
+		{
+			for (page = 64; page <= 4096; page *= 8)
+			{
+				gpalloc_t gpa;
+				// A buffer that isn't a whole number of pages, the last page is partial
+				gpalloc_options options = { .policy = (gpalloc_policy)k, .address_map_page = page };
+				defragment_owner owner;
+				size_t sizes[64];
+				unsigned state = 7;
+				size_t i, step;
+				memset(&owner, 0, sizeof(owner));
+				owner.count = 64;
+				assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer) - 100, &options));
+				assert(gpa.address_map_pages == (sizeof(buffer) - 100 + page - 1) / page);
+
+				for (step = 0; step < 3000; step++)
+				{
+					size_t slot;
+					state = state * 1103515245u + 12345u;
+					slot = (state >> 8) % 64;
+					if (owner.pointers[slot] == NULL)
+					{
+						sizes[slot] = 1 + (state >> 16) % 700;
+						owner.pointers[slot] = gpalloc_malloc(&gpa, sizes[slot], (size_t)1 << ((state >> 4) % 7));
+					}
+					else if ((state >> 20) % 3 == 0)
+					{
+						const size_t bytes = 1 + (state >> 12) % 900;
+						void* moved = gpalloc_realloc(&gpa, owner.pointers[slot], bytes, 1);
+						if (moved != NULL)
+						{
+							owner.pointers[slot] = moved;
+							sizes[slot] = bytes;
+						}
+					}
+					else
+					{
+						gpalloc_free(&gpa, owner.pointers[slot]);
+						owner.pointers[slot] = NULL;
+					}
+					if (step % 200 == 199)
+						gpalloc_defragment(&gpa, 2048, defragment_move, &owner);
+
+					assert(gpalloc_verify(&gpa) == 1);
+					if (owner.pointers[slot] != NULL)
+						assert(gpalloc_get_allocation_size(&gpa, owner.pointers[slot]) == sizes[slot]);
+				}
+
+				for (i = 0; i < 64; i++)
+				{
+					if (owner.pointers[i] == NULL)
+						continue;
+					// Inside an allocation the lower bound is the next block
+					void* const inside = offset_ptr(owner.pointers[i], sizes[i] / 2);
+					assert(gpalloc_lower_bound(&gpa, owner.pointers[i]) == gpalloc_lower_bound_in(&gpa, owner.pointers[i], 0, gpa.allocation_array_size));
+					assert(gpalloc_lower_bound(&gpa, inside) == gpalloc_lower_bound_in(&gpa, inside, 0, gpa.allocation_array_size));
+					assert(gpalloc_get_allocation_size(&gpa, owner.pointers[i]) == sizes[i]);
+					gpalloc_free(&gpa, owner.pointers[i]);
+				}
+				assert(gpa.allocation_array_size == 1);
+				for (i = 1; i <= gpa.address_map_pages; i++)
+					assert(gpalloc_map_prefix(&gpa, i) == 1);
+				gpalloc_destroy(&gpa);
+			}
+		}
+	}
+
+	// The map is metadata too, no memory for it fails the initialization
+	{
+		_Alignas(16) char buffer[1 << 12];
+		_Alignas(16) char metadata[512];
+		metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+		gpalloc_t gpa;
+		gpalloc_options options = { .address_map_page = 1, .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		assert(!gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options));
+		assert(gpalloc_malloc(&gpa, 16, 1) == NULL);
+		gpalloc_destroy(&gpa);
+	}
+}
+
+static void gpalloc_policy_tests(void)
+{
+	// Same layout for every policy: | x0 32 | hole 128 at 32 | x1 32 | hole 144 at 192 | x2 16 | free 672 at 352 |
+	{
+		_Alignas(256) static char buffer[1024];
+		gpalloc_policy policy;
+		for (policy = GPALLOC_FIRST_FIT; policy <= GPALLOC_HYBRID_FIT; policy = (gpalloc_policy)(policy + 1))
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = policy };
+			assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options));
+
+			void* x0 = gpalloc_malloc(&gpa, 32, 1);
+			void* a = gpalloc_malloc(&gpa, 128, 1);
+			void* x1 = gpalloc_malloc(&gpa, 32, 1);
+			void* b = gpalloc_malloc(&gpa, 144, 1);
+			void* x2 = gpalloc_malloc(&gpa, 16, 1);
+			assert(x0 == buffer && a == buffer + 32 && b == buffer + 192 && x2 == buffer + 336);
+			gpalloc_free(&gpa, a);
+			gpalloc_free(&gpa, b);
+
+			void* c = gpalloc_malloc(&gpa, 64, 64);
+			void* d = gpalloc_malloc(&gpa, 16, 1);
+			switch (policy)
+			{
+			case GPALLOC_FIRST_FIT:
+				assert(c == buffer + 64 && "Lowest block that fits!");
+				assert(d == buffer + 32 && "The padding in front is reused!");
+				break;
+			case GPALLOC_BEST_FIT:
+				// 128 needs 32 bytes of padding, waste 64 + 2 * 32 against 80 for the aligned 144
+				assert(c == buffer + 192 && "The padding must count in the waste!");
+				assert(d == buffer + 256 && "Remainder of 16 is an exact fit!");
+				break;
+			case GPALLOC_NEXT_FIT:
+				assert(c == buffer + 384 && "Continues after the last allocation!");
+				assert(d == buffer + 448);
+				break;
+			case GPALLOC_WORST_FIT:
+				assert(c == buffer + 384 && "Biggest block!");
+				assert(d == buffer + 448 && "Remainder after the allocation is still the biggest!");
+				break;
+			default:
+				assert(c == buffer + 384 && d == buffer + 448 && "Small requests use next fit!");
+				break;
+			}
+			assert(gpalloc_verify(&gpa) == 1);
+
+			gpalloc_free(&gpa, x0);
+			gpalloc_free(&gpa, x1);
+			gpalloc_free(&gpa, x2);
+			gpalloc_free(&gpa, c);
+			gpalloc_free(&gpa, d);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+
+	// Hybrid, big requests take the smallest hole even when it's behind the cursor
+	{
+		_Alignas(16) static char buffer[1 << 12];
+		const size_t big = GPALLOC_HYBRID_SMALL_SIZE + 16;
+		gpalloc_t gpa;
+		gpalloc_options options = { .policy = GPALLOC_HYBRID_FIT };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		void* a = gpalloc_malloc(&gpa, big * 2, 1);
+		void* x0 = gpalloc_malloc(&gpa, 16, 1);
+		void* b = gpalloc_malloc(&gpa, big, 1);
+		void* x1 = gpalloc_malloc(&gpa, 16, 1);
+		assert(a && x0 && b && x1);
+		gpalloc_free(&gpa, a);
+		gpalloc_free(&gpa, b);
+		assert(gpalloc_malloc(&gpa, big, 1) == b && "Exact fit behind the cursor!");
+		assert(gpalloc_malloc(&gpa, 16, 1) == (char*)x1 + 16 && "Small ones go on after the cursor!");
+		assert(gpalloc_verify(&gpa) == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Next fit wraps around when nothing fits after the cursor
+	{
+		_Alignas(16) char buffer[256];
+		gpalloc_t gpa;
+		gpalloc_options options = { .policy = GPALLOC_NEXT_FIT };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		void* a = gpalloc_malloc(&gpa, 100, 1);
+		void* b = gpalloc_malloc(&gpa, 100, 1);
+		assert(a == buffer && b == buffer + 100);
+		gpalloc_free(&gpa, a);
+		assert(gpalloc_malloc(&gpa, 60, 1) == buffer && "Only the start has room for it!");
+		assert(gpalloc_malloc(&gpa, 30, 1) == buffer + 60 && "Continues after the wrapped allocation!");
+		assert(gpalloc_malloc(&gpa, 100, 1) == NULL);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Churn, every policy keeps the metadata valid and the contents intact
+	{
+		_Alignas(256) static char buffer[1 << 15];
+		gpalloc_policy policy;
+		for (policy = GPALLOC_FIRST_FIT; policy <= GPALLOC_HYBRID_FIT; policy = (gpalloc_policy)(policy + 1))
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = policy };
+			void* pointers[64] = { 0 };
+			size_t sizes[64];
+			unsigned state = 3;
+			size_t i, step;
+			gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+			for (step = 0; step < 3000; step++)
+			{
+				size_t slot;
+				state = state * 1103515245u + 12345u;
+				slot = (state >> 8) % 64;
+				if (pointers[slot] != NULL)
+				{
+					assert(((unsigned char*)pointers[slot])[sizes[slot] - 1] == (unsigned char)slot);
+					gpalloc_free(&gpa, pointers[slot]);
+					pointers[slot] = NULL;
+					continue;
+				}
+				sizes[slot] = 1 + (state >> 16) % 1000;
+				const size_t alignment = (size_t)1 << ((state >> 4) % 8);
+				pointers[slot] = gpalloc_malloc(&gpa, sizes[slot], alignment);
+				if (pointers[slot] != NULL)
+				{
+					assert((uintptr_t)pointers[slot] % alignment == 0);
+					memset(pointers[slot], (int)slot, sizes[slot]);
+				}
+			}
+			for (i = 0; i < 64; i++)
+				if (pointers[i] != NULL)
+					gpalloc_free(&gpa, pointers[i]);
+			assert(gpalloc_verify(&gpa) == 1);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+}
+
+static void gpalloc_deferred_tests(void)
+{
+	// Same size frees are taken back without changing the table, collect merges them
+	{
+		_Alignas(64) char buffer[1024];
+		gpalloc_t gpa;
+		gpalloc_options options = { .deferred_coalescing = 1 };
+		assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options));
+
+		void* a = gpalloc_malloc(&gpa, 48, 1);
+		void* b = gpalloc_malloc(&gpa, 48, 1);
+		void* c = gpalloc_malloc(&gpa, 48, 1);
+		assert(a == buffer && b == buffer + 48 && c == buffer + 96 && gpa.allocation_array_size == 4);
+
+		gpalloc_free(&gpa, b);
+		gpalloc_free(&gpa, c);
+		assert(gpa.allocation_array_size == 4 && gpa.deferred_frees == 2 && "Nothing merged yet!");
+		assert(gpalloc_verify(&gpa) == 1);
+		assert(gpalloc_malloc(&gpa, 48, 16) == c && "Newest free of the size first!");
+		assert(gpa.allocation_array_size == 4);
+
+		// b is 16 aligned but not 32, the cache skips it and the search splits the tail
+		void* d = gpalloc_malloc(&gpa, 48, 32);
+		assert(d != b && (uintptr_t)d % 32 == 0);
+		assert(gpa.allocation_array_size > 4);
+		assert(gpalloc_malloc(&gpa, 48, 16) == b);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Collect folds runs of free blocks, the cache forgets them
+	{
+		_Alignas(64) char buffer[1024];
+		gpalloc_t gpa;
+		gpalloc_options options = { .deferred_coalescing = 1 };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		void* a = gpalloc_malloc(&gpa, 100, 1);
+		void* b = gpalloc_malloc(&gpa, 100, 1);
+		void* c = gpalloc_malloc(&gpa, 100, 1);
+		void* d = gpalloc_malloc(&gpa, 100, 1);
+		gpalloc_free(&gpa, a);
+		gpalloc_free(&gpa, b);
+		gpalloc_free(&gpa, d);
+		assert(gpa.allocation_array_size == 5);
+
+		assert(gpalloc_collect(&gpa) == 2 && "a with b, d with the tail!");
+		assert(gpa.allocation_array_size == 3 && gpa.deferred_frees == 0);
+		assert(gpalloc_collect(&gpa) == 0);
+		assert(gpalloc_malloc(&gpa, 100, 1) == a && "Stale cache entry must not be used!");
+		assert(gpalloc_get_allocation_size(&gpa, a) == 100);
+		gpalloc_free(&gpa, a);
+		gpalloc_free(&gpa, c);
+		gpalloc_collect(&gpa);
+		assert(gpa.allocation_array_size == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// A failed allocation collects and retries
+	{
+		_Alignas(64) char buffer[1024];
+		void* blocks[4];
+		size_t i;
+		gpalloc_t gpa;
+		gpalloc_options options = { .deferred_coalescing = 1 };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		for (i = 0; i < 4; i++)
+			blocks[i] = gpalloc_malloc(&gpa, 256, 1);
+		for (i = 0; i < 4; i++)
+			gpalloc_free(&gpa, blocks[i]);
+		assert(gpa.allocation_array_size == 4);
+		assert(gpalloc_malloc(&gpa, 1024, 1) == buffer);
+		assert(gpa.allocation_array_size == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Frees past what the cache remembers compact the table on their own
+	{
+		_Alignas(64) static char buffer[1 << 16];
+		static void* blocks[1024];
+		size_t i;
+		gpalloc_t gpa;
+		gpalloc_options options = { .deferred_coalescing = 1 };
+		gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options);
+
+		for (i = 0; i < 1024; i++)
+			blocks[i] = gpalloc_malloc(&gpa, 32, 1);
+		for (i = 0; i < 1024; i++)
+		{
+			gpalloc_free(&gpa, blocks[i]);
+			assert(gpa.deferred_frees <= GPALLOC_REUSE_BUCKETS * GPALLOC_REUSE_WAYS + 1024 / 8);
+		}
+		assert(gpa.allocation_array_size < 1024);
+		gpalloc_collect(&gpa);
+		assert(gpa.allocation_array_size == 1);
+		gpalloc_destroy(&gpa);
+	}
+
+	// Churn with every policy, the address map, reallocs and defragmentation
+	{
+		_Alignas(256) static char buffer[1 << 15];
+		gpalloc_policy policy;
+		for (policy = GPALLOC_FIRST_FIT; policy <= GPALLOC_HYBRID_FIT; policy = (gpalloc_policy)(policy + 1))
+		{
+			gpalloc_t gpa;
+			gpalloc_options options = { .policy = policy, .deferred_coalescing = 1, .address_map_page = policy % 2 ? 256 : 0 };
+			defragment_owner owner;
+			size_t sizes[64];
+			unsigned state = 11;
+			size_t i, step;
+			memset(&owner, 0, sizeof(owner));
+			owner.count = 64;
+			assert(gpalloc_initialize_ex(&gpa, buffer, sizeof(buffer), &options));
+
+			for (step = 0; step < 3000; step++)
+			{
+				size_t slot;
+				state = state * 1103515245u + 12345u;
+				slot = (state >> 8) % 64;
+				if (owner.pointers[slot] == NULL)
+				{
+					// Few sizes so the cache hits
+					sizes[slot] = 16 * (1 + (state >> 16) % 24);
+					owner.pointers[slot] = gpalloc_malloc(&gpa, sizes[slot], (size_t)1 << ((state >> 4) % 6));
+					if (owner.pointers[slot] != NULL)
+						memset(owner.pointers[slot], (int)slot, sizes[slot]);
+				}
+				else if ((state >> 20) % 4 == 0)
+				{
+					const size_t bytes = 16 * (1 + (state >> 12) % 24);
+					void* moved = gpalloc_realloc(&gpa, owner.pointers[slot], bytes, 1);
+					if (moved != NULL)
+					{
+						owner.pointers[slot] = moved;
+						sizes[slot] = bytes;
+						memset(moved, (int)slot, bytes);
+					}
+				}
+				else
+				{
+					assert(((unsigned char*)owner.pointers[slot])[sizes[slot] - 1] == (unsigned char)slot);
+					gpalloc_free(&gpa, owner.pointers[slot]);
+					owner.pointers[slot] = NULL;
+				}
+				if (step % 500 == 499)
+					gpalloc_defragment(&gpa, 0, defragment_move, &owner);
+				if (step % 700 == 699)
+					gpalloc_collect(&gpa);
+				assert(gpalloc_verify(&gpa) == 1);
+			}
+
+			for (i = 0; i < 64; i++)
+			{
+				if (owner.pointers[i] == NULL)
+					continue;
+				assert(((unsigned char*)owner.pointers[i])[0] == (unsigned char)i);
+				gpalloc_free(&gpa, owner.pointers[i]);
+			}
+			gpalloc_collect(&gpa);
+			assert(gpalloc_verify(&gpa) == 1);
+			assert(gpa.allocation_array_size == 1);
+			gpalloc_destroy(&gpa);
+		}
+	}
+}
+
+/* Backing regions from the C library, counted to check they all go back. */
+typedef struct {
+	size_t allocated;
+	size_t released;
+	size_t live_bytes;
+	size_t fail_after;
+} heap_regions;
+
+static void* heap_regions_realloc(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	heap_regions* regions = (heap_regions*)user;
+	if (new_size == 0)
+	{
+		regions->released++;
+		regions->live_bytes -= old_size;
+		free(ptr);
+		return NULL;
+	}
+	assert(ptr == NULL);
+	if (regions->fail_after != 0 && regions->allocated >= regions->fail_after)
+		return NULL;
+	regions->allocated++;
+	regions->live_bytes += new_size;
+	return malloc(new_size);
+}
+
+static void gpalloc_heap_tests(void)
+{
+	// Grows past the initial buffer, frees find their region and empty regions go back
+	{
+		_Alignas(16) static char buffer[4096];
+		heap_regions backing = { 0 };
+		gpalloc_heap_options options = { .region_realloc = heap_regions_realloc, .region_user = &backing };
+		gpalloc_heap heap;
+		void* blocks[40];
+		size_t i;
+		assert(gpalloc_heap_initialize(&heap, buffer, sizeof(buffer), &options));
+		assert(heap.regions_size == 1);
+
+		for (i = 0; i < 40; i++)
+		{
+			blocks[i] = gpalloc_heap_malloc(&heap, 1000, 16);
+			assert(blocks[i] && (uintptr_t)blocks[i] % 16 == 0);
+			memset(blocks[i], (int)i, 1000);
+		}
+		assert(blocks[0] == (void*)buffer && "The initial buffer is used first!");
+		assert(heap.regions_size > 1 && backing.allocated == heap.regions_size - 1);
+		assert(heap.regions_size < 8 && "Regions grow geometrically!");
+		for (i = 1; i < heap.regions_size; i++)
+			assert((uintptr_t)heap.regions[i - 1].allocator.buffer < (uintptr_t)heap.regions[i].allocator.buffer);
+
+		for (i = 0; i < 40; i++)
+		{
+			assert(gpalloc_heap_get_allocation_size(&heap, blocks[i]) == 1000);
+			assert(((unsigned char*)blocks[i])[999] == (unsigned char)i);
+			gpalloc_heap_free(&heap, blocks[i]);
+		}
+		assert(backing.allocated - backing.released <= 1 && "One empty region is kept!");
+		gpalloc_heap_trim(&heap);
+		assert(heap.regions_size == 1 && backing.allocated == backing.released);
+		assert(heap.regions[0].allocator.allocation_array_size == 1);
+		gpalloc_heap_destroy(&heap);
+	}
+
+	// Without an initial buffer, requests bigger than the region size and reallocs across regions
+	{
+		heap_regions backing = { 0 };
+		gpalloc_heap_options options = { .region_realloc = heap_regions_realloc, .region_user = &backing, .region_size = 1024 };
+		gpalloc_heap heap;
+		assert(gpalloc_heap_initialize(&heap, NULL, 0, &options));
+		assert(heap.regions_size == 0);
+
+		char* a = (char*)gpalloc_heap_malloc(&heap, 100, 8);
+		assert(a && heap.regions_size == 1);
+		assert(heap.regions[0].allocator.buffer_size == GPALLOC_HEAP_GRANULARITY && "Rounded up to the granularity!");
+		memset(a, 'a', 100);
+
+		void* big = gpalloc_heap_malloc(&heap, GPALLOC_HEAP_GRANULARITY * 3, 64);
+		assert(big && heap.regions_size == 2 && (uintptr_t)big % 64 == 0);
+
+		a = (char*)gpalloc_heap_realloc(&heap, a, GPALLOC_HEAP_GRANULARITY * 2, 8);
+		assert(a && a[99] == 'a' && "Contents move with the allocation!");
+		assert(gpalloc_heap_get_allocation_size(&heap, a) == GPALLOC_HEAP_GRANULARITY * 2);
+
+		gpalloc_heap_free(&heap, big);
+		gpalloc_heap_free(&heap, a);
+		gpalloc_heap_destroy(&heap);
+		assert(backing.allocated == backing.released && backing.live_bytes == 0);
+	}
+
+	// No region to chain, the allocation fails and the heap is still usable
+	{
+		_Alignas(16) static char buffer[1024];
+		heap_regions backing = { .fail_after = 1 };
+		gpalloc_heap_options options = { .region_realloc = heap_regions_realloc, .region_user = &backing };
+		gpalloc_heap heap;
+		gpalloc_heap_initialize(&heap, buffer, sizeof(buffer), &options);
+
+		void* a = gpalloc_heap_malloc(&heap, 2000, 1);
+		assert(a && heap.regions_size == 2);
+		assert(gpalloc_heap_malloc(&heap, 1 << 20, 1) == NULL);
+		void* b = gpalloc_heap_malloc(&heap, 512, 1);
+		assert(b && gpalloc_heap_get_allocation_size(&heap, b) == 512);
+		gpalloc_heap_free(&heap, a);
+		gpalloc_heap_free(&heap, b);
+		gpalloc_heap_destroy(&heap);
+		assert(backing.allocated == backing.released);
+	}
+
+	// Churn over the default backing, every region stays valid and the contents intact
+	{
+		gpalloc_heap_options options = { .allocator = { .policy = GPALLOC_BEST_FIT, .address_map_page = 4096 }, .region_size = GPALLOC_HEAP_GRANULARITY };
+		gpalloc_heap heap;
+		void* pointers[256] = { 0 };
+		size_t sizes[256];
+		unsigned state = 5;
+		size_t i, step;
+		gpalloc_heap_initialize(&heap, NULL, 0, &options);
+
+		for (step = 0; step < 20000; step++)
+		{
+			size_t slot;
+			state = state * 1103515245u + 12345u;
+			slot = (state >> 8) % 256;
+			if (pointers[slot] == NULL)
+			{
+				sizes[slot] = 1 + (state >> 12) % 4000;
+				pointers[slot] = gpalloc_heap_malloc(&heap, sizes[slot], 16);
+				assert(pointers[slot]);
+				memset(pointers[slot], (int)slot, sizes[slot]);
+			}
+			else if ((state >> 20) % 4 == 0)
+			{
+				sizes[slot] = 1 + (state >> 12) % 8000;
+				pointers[slot] = gpalloc_heap_realloc(&heap, pointers[slot], sizes[slot], 16);
+				assert(pointers[slot]);
+				memset(pointers[slot], (int)slot, sizes[slot]);
+			}
+			else
+			{
+				assert(((unsigned char*)pointers[slot])[sizes[slot] - 1] == (unsigned char)slot);
+				gpalloc_heap_free(&heap, pointers[slot]);
+				pointers[slot] = NULL;
+			}
+		}
+		for (i = 0; i < heap.regions_size; i++)
+			assert(gpalloc_verify(&heap.regions[i].allocator) == 1);
+		for (i = 0; i < 256; i++)
+			if (pointers[i] != NULL)
+				gpalloc_heap_free(&heap, pointers[i]);
+		gpalloc_heap_trim(&heap);
+		assert(heap.regions_size == 0);
+		gpalloc_heap_destroy(&heap);
+	}
+}
+
 int main(void)
 {
 	gpalloc_tests();
+	gpalloc_free_index_tests();
+	gpalloc_verify_tests();
+	gpalloc_realloc_tests();
+	gpalloc_metadata_tests();
+	gpalloc_defragment_tests();
+	gpalloc_handle_tests();
+	gpalloc_address_map_tests();
+	gpalloc_policy_tests();
+	gpalloc_deferred_tests();
+	gpalloc_heap_tests();
+#if GPALLOC_COMPACT_TABLE
+	gpalloc_compact_tests();
+#endif
 	return 0;
 }
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+#include "clow/pool.c"
+
+#define BUF_ALLOC_VALUE ((size_t)'W')
+
+/* Word aligned storage for the tests, ANSI C has no alignment specifier. */
+#define WORD_BUFFER(name, size) union { size_t word; double real; char bytes[size]; } name
+
+static void pool_tests(void)
+{
+	{
+		assert(pool_min_block_size() == sizeof(uint32_t));
+	}
+
+	// Blocks are handed out in address order from a fresh pool, then exhaustion
+	{
+		WORD_BUFFER(buffer, 48 * 4);
+		pool_t p;
+		void* blocks[4];
+		size_t i;
+
+		pool_initialize(&p, buffer.bytes, sizeof(buffer.bytes), 48);
+		assert(p.block_count == 4);
+		assert(pool_count_free(&p) == 4);
+
+		for (i = 0; i < 4; i++)
+		{
+			blocks[i] = pool_alloc(&p);
+			assert(blocks[i] == (void*)(buffer.bytes + i * 48));
+			memset(blocks[i], BUF_ALLOC_VALUE, 48);
+		}
+		assert(pool_alloc(&p) == NULL);
+		assert(pool_count_free(&p) == 0);
+
+		// LIFO reuse
+		pool_free(&p, blocks[2]);
+		pool_free(&p, blocks[0]);
+		assert(pool_verify_corruption(&p) == 1);
+		assert(pool_alloc(&p) == blocks[0]);
+		assert(pool_alloc(&p) == blocks[2]);
+
+		for (i = 0; i < 4; i++)
+			pool_free(&p, blocks[i]);
+		assert(pool_count_free(&p) == 4);
+		assert(pool_verify_corruption(&p) == 1);
+	}
+
+	// Block sizes are rounded up to the word size and the start of the buffer is aligned
+	{
+		WORD_BUFFER(buffer, 64);
+		pool_t p;
+		void* a;
+
+		pool_initialize(&p, buffer.bytes + 1, sizeof(buffer.bytes) - 1, 1);
+		assert(p.block_size == sizeof(void*));
+		assert(p.block_count == (sizeof(buffer.bytes) - sizeof(void*)) / sizeof(void*));
+		a = pool_alloc(&p);
+		assert(a && ((uintptr_t)a) % sizeof(void*) == 0);
+		assert(pool_range_check(&p, a) == 1);
+		assert(pool_range_check(&p, buffer.bytes) == 0);
+		pool_free(&p, a);
+
+		// Buffer size helper accounts for the alignment padding
+		assert(pool_buffer_size(1, 7) == 7 * sizeof(void*) + sizeof(void*) - 1);
+	}
+
+	// Too small buffer behaves as an empty pool
+	{
+		WORD_BUFFER(buffer, 16);
+		pool_t p;
+
+		pool_initialize(&p, buffer.bytes, 8, 16);
+		assert(p.block_count == 0);
+		assert(pool_alloc(&p) == NULL);
+		assert(pool_verify_corruption(&p) == 1);
+	}
+
+	// Reset frees everything
+	{
+		WORD_BUFFER(buffer, 32 * 8);
+		pool_t p;
+
+		pool_initialize(&p, buffer.bytes, sizeof(buffer.bytes), 32);
+		while (pool_alloc(&p) != NULL)
+			;
+		pool_reset(&p);
+		assert(pool_count_free(&p) == 8);
+	}
+
+	// A block written after its release is detected
+	{
+		WORD_BUFFER(buffer, 16 * 4);
+		pool_t p;
+		void* a;
+
+		pool_initialize(&p, buffer.bytes, sizeof(buffer.bytes), 16);
+		a = pool_alloc(&p);
+		pool_free(&p, a);
+		memset(a, BUF_ALLOC_VALUE, 16);
+		assert(pool_verify_corruption(&p) == 0);
+	}
+}
+
+#if !defined(_WIN32)
+#include <pthread.h>
+
+#define STRESS_THREADS 8
+#define STRESS_BLOCKS 64
+#define STRESS_ROUNDS 20000
+
+static pool_t stress_pool;
+
+/* Every thread owns the blocks it holds, a block handed out twice would have its mark overwritten. */
+static void* stress_thread(void* arg)
+{
+	const size_t mark = (size_t)(uintptr_t)arg;
+	void* held[4];
+	size_t i, j;
+
+	for (i = 0; i < STRESS_ROUNDS; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			held[j] = pool_alloc(&stress_pool);
+			if (held[j])
+				memcpy(held[j], &mark, sizeof(mark));
+		}
+		for (j = 0; j < 4; j++)
+		{
+			if (held[j])
+			{
+				size_t value;
+				memcpy(&value, held[j], sizeof(value));
+				assert(value == mark && "Block handed out to two threads!");
+				pool_free(&stress_pool, held[j]);
+			}
+		}
+	}
+	return NULL;
+}
+
+static void pool_thread_tests(void)
+{
+	// Many producers and consumers, fewer blocks than requests to force contention and exhaustion
+	{
+		static WORD_BUFFER(buffer, 16 * STRESS_BLOCKS);
+		pthread_t threads[STRESS_THREADS];
+		size_t i;
+
+		pool_initialize(&stress_pool, buffer.bytes, sizeof(buffer.bytes), 16);
+		for (i = 0; i < STRESS_THREADS; i++)
+			pthread_create(&threads[i], NULL, stress_thread, (void*)(uintptr_t)(i + 1));
+		for (i = 0; i < STRESS_THREADS; i++)
+			pthread_join(threads[i], NULL);
+
+		assert(pool_verify_corruption(&stress_pool) == 1);
+		assert(pool_count_free(&stress_pool) == STRESS_BLOCKS);
+	}
+}
+#endif
+
+int main(void)
+{
+	pool_tests();
+#if !defined(_WIN32)
+	pool_thread_tests();
+#endif
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+
+
+#include "clow/ring.c"
+
+static void ring_tests(void)
+{
+    // Ranges are carved in order and released by fence
+    {
+        ring_allocator ring;
+        ring_initialize(&ring, 100);
+
+        assert(ring_alloc(&ring, 30, 1) == 0);
+        assert(ring_alloc(&ring, 30, 1) == 30);
+        assert(ring_fence(&ring, 1));
+        assert(ring_alloc(&ring, 30, 1) == 60);
+        assert(ring_fence(&ring, 2));
+        assert(ring_used(&ring) == 90);
+        assert(ring_alloc(&ring, 20, 1) == RING_INVALID_OFFSET);
+
+        // Retiring fence 1 frees the beginning, the request doesn't straddle the end
+        ring_retire(&ring, 1);
+        assert(ring_used(&ring) == 30);
+        assert(ring_alloc(&ring, 20, 1) == 0);
+        assert(ring_used(&ring) == 30 + 10 + 20 && "Skipped end is in flight until the range after it is released!");
+        assert(ring_fence(&ring, 3));
+
+        ring_retire(&ring, 3);
+        assert(ring_used(&ring) == 0);
+        assert(ring.head == 0 && ring.tail == 0);
+    }
+
+    // Alignment of the offsets
+    {
+        ring_allocator ring;
+        ring_initialize(&ring, 256);
+
+        assert(ring_alloc(&ring, 3, 1) == 0);
+        assert(ring_alloc(&ring, 8, 16) == 16);
+        assert(ring_alloc(&ring, 8, 0) == 24);
+        assert(ring_used(&ring) == 32);
+    }
+
+    // Exact fit to the end, full ring and zero sized requests
+    {
+        ring_allocator ring;
+        ring_initialize(&ring, 64);
+
+        assert(ring_alloc(&ring, 0, 1) == RING_INVALID_OFFSET);
+        assert(ring_alloc(&ring, 65, 1) == RING_INVALID_OFFSET);
+        assert(ring_alloc(&ring, 64, 1) == 0);
+        assert(ring_alloc(&ring, 1, 1) == RING_INVALID_OFFSET);
+        assert(ring_fence(&ring, 7));
+        ring_retire(&ring, 6);
+        assert(ring_used(&ring) == 64);
+        ring_retire(&ring, 7);
+        assert(ring_used(&ring) == 0);
+    }
+
+    // Fences without new ranges are not recorded, the queue has a limit
+    {
+        ring_allocator ring;
+        size_t i;
+        ring_initialize(&ring, RING_MAX_FENCES * 2);
+
+        assert(ring_fence(&ring, 1));
+        assert(ring.fence_count == 0);
+        for (i = 0; i < RING_MAX_FENCES; i++)
+        {
+            assert(ring_alloc(&ring, 1, 1) != RING_INVALID_OFFSET);
+            assert(ring_fence(&ring, 2 + i));
+            assert(ring_fence(&ring, 1000 + i) && "Nothing new, not recorded");
+        }
+        assert(ring.fence_count == RING_MAX_FENCES);
+        assert(ring_alloc(&ring, 1, 1) != RING_INVALID_OFFSET);
+        assert(!ring_fence(&ring, 5000));
+
+        // Retiring makes room, the pending range goes with the next fence
+        ring_retire(&ring, 2);
+        assert(ring_fence(&ring, 5001));
+        ring_retire(&ring, 5001);
+        assert(ring_used(&ring) == 0);
+    }
+
+    // Wait query, which fence gives room
+    {
+        ring_allocator ring;
+        uint64_t fence = 0;
+        ring_initialize(&ring, 100);
+
+        assert(ring_wait_fence(&ring, 100, 1, &fence) == RING_WAIT_NONE);
+        assert(ring_wait_fence(&ring, 101, 1, &fence) == RING_WAIT_NEVER);
+
+        ring_alloc(&ring, 40, 1);
+        ring_fence(&ring, 10);
+        ring_alloc(&ring, 40, 1);
+        ring_fence(&ring, 11);
+        ring_alloc(&ring, 10, 1);
+
+        assert(ring_wait_fence(&ring, 10, 1, &fence) == RING_WAIT_NONE);
+        assert(ring_wait_fence(&ring, 30, 1, &fence) == RING_WAIT_FENCE && fence == 10);
+        assert(ring_wait_fence(&ring, 60, 1, &fence) == RING_WAIT_FENCE && fence == 11 && "Can't straddle the end, needs [0, 60)!");
+        assert(ring_wait_fence(&ring, 95, 1, &fence) == RING_WAIT_NEVER && "The last range has no fence yet!");
+
+        ring_fence(&ring, 12);
+        assert(ring_wait_fence(&ring, 95, 1, &fence) == RING_WAIT_FENCE && fence == 12);
+
+        // The answer matches what ring_alloc does after the retirement
+        assert(ring_wait_fence(&ring, 30, 1, &fence) == RING_WAIT_FENCE);
+        ring_retire(&ring, fence);
+        assert(ring_alloc(&ring, 30, 1) == 0);
+    }
+
+    // Streaming, never more in flight than the capacity and every range inside the space
+    {
+        ring_allocator ring;
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        size_t i;
+        unsigned state = 1;
+        ring_initialize(&ring, 1000);
+
+        for (i = 0; i < 10000; i++)
+        {
+            size_t count, offset;
+            uint64_t fence;
+            state = state * 1103515245u + 12345u;
+            count = 1 + (state >> 8) % 300;
+
+            if (ring_wait_fence(&ring, count, 4, &fence) == RING_WAIT_FENCE)
+            {
+                completed = fence;
+                ring_retire(&ring, completed);
+            }
+            offset = ring_alloc(&ring, count, 4);
+            assert(offset != RING_INVALID_OFFSET);
+            assert(offset % 4 == 0 && offset + count <= 1000);
+            assert(ring_used(&ring) <= 1000);
+            ring_fence(&ring, ++submitted);
+        }
+        ring_retire(&ring, submitted);
+        assert(ring_used(&ring) == 0);
+        ((void)completed);
+    }
+}
+
+int main(void)
+{
+    ring_tests();
+    return 0;
+}
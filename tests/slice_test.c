@@ -7,6 +7,64 @@
 
 #include "clow/slice.c"
 
+/* Big space for the tests, within the 16 bit offsets. */
+#define TEST_ELEMENTS (SLICE_MAX_ELEMENTS < 100000 ? SLICE_MAX_ELEMENTS : 100000)
+
+/* Number of slices in the size index subtree, checking the key order. */
+static size_t index_count(const slice_allocator* s, uint32_t node, size_t min_count, size_t max_count)
+{
+	if (node == SLICE_INDEX_NULL)
+		return 0;
+	const slice_index_node* n = s->index_nodes + node;
+	assert(n->count >= min_count && n->count <= max_count && "Index must be ordered by count!");
+	return 1 + index_count(s, n->left, min_count, n->count) + index_count(s, n->right, n->count, max_count);
+}
+
+/* The size index must hold exactly the free slices. */
+static void check_index(const slice_allocator* s)
+{
+	assert(index_count(s, s->index_root, 0, (size_t)-1) == s->free_slices_array_size);
+	for (size_t i = 0; i < s->free_slices_array_size; i++)
+	{
+		const uint32_t node = slice_index_lower_bound(s, s->free_slices[i].count);
+		assert(node != SLICE_INDEX_NULL && s->index_nodes[node].count <= s->free_slices[i].count);
+		if (i > 0)
+			assert(s->free_slices[i - 1].offset + s->free_slices[i - 1].count < s->free_slices[i].offset && "Free slices must be ordered and merged!");
+	}
+}
+
+
+/* Fixed metadata region, a bump allocator that resizes the last block in place and fails when full. */
+typedef struct {
+	char* buffer;
+	size_t size;
+	size_t used;
+	void* last;
+	size_t calls;
+} metadata_region;
+
+static void* metadata_region_realloc(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	metadata_region* region = (metadata_region*)user;
+	region->calls++;
+	if (new_size == 0)
+		return NULL; // Released with the region
+	if (ptr != NULL && ptr == region->last && (size_t)((char*)ptr - region->buffer) + new_size <= region->size)
+	{
+		region->used = (size_t)((char*)ptr - region->buffer) + new_size;
+		return ptr;
+	}
+
+	const size_t start = (region->used + 15) & ~(size_t)15;
+	if (start > region->size || region->size - start < new_size)
+		return NULL;
+	void* block = region->buffer + start;
+	if (ptr != NULL)
+		memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+	region->used = start + new_size;
+	region->last = block;
+	return block;
+}
 
 static void slice_tests(void)
 {
@@ -86,8 +144,627 @@ static void slice_tests(void)
 
 };
 
+static void slice_best_fit_tests(void)
+{
+	// Best fit must pick the smallest free slice that fits
+	{
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_initialize_with_policy(&s, 20, SLICE_POLICY_BEST_FIT);
+		slice_t a = slice_alloc(&s, 3);
+		slice_t b = slice_alloc(&s, 2);
+		slice_t c = slice_alloc(&s, 5);
+		slice_t d = slice_alloc(&s, 1);
+		assert(a.offset == 0 && b.offset == 3 && c.offset == 5 && d.offset == 10);
+		slice_free(&s, a);
+		slice_free(&s, c);
+		check_index(&s);
+
+		slice_t e = slice_alloc(&s, 4);
+		assert(e.offset == 5 && e.count == 4);
+		slice_t f = slice_alloc(&s, 3);
+		assert(f.offset == 0 && f.count == 3);
+		slice_t g = slice_alloc(&s, 9);
+		assert(g.offset == 11 && g.count == 9);
+		slice_t h = slice_alloc(&s, 2);
+		assert(h.count == 0 && "Nothing must fit!");
+		check_index(&s);
+
+		slice_free(&s, b);
+		slice_free(&s, d);
+		slice_free(&s, e);
+		slice_free(&s, f);
+		slice_free(&s, g);
+		check_index(&s);
+		assert(s.free_slices_array_size == 1 && slice_compute_unused_count(&s) == 20);
+
+		slice_destroy(&s);
+	}
+
+	// Fragmented space, free in scrambled order must coalesce back
+	{
+		enum { count = 1000 };
+		slice_t slices[count];
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_initialize_with_policy(&s, TEST_ELEMENTS, SLICE_POLICY_BEST_FIT);
+		for (size_t i = 0; i < count; i++)
+		{
+			slices[i] = slice_alloc(&s, 1 + (i * 13) % 50);
+			assert(slices[i].count == 1 + (i * 13) % 50);
+		}
+		for (size_t i = 0; i < count; i += 2)
+		{
+			slice_free(&s, slices[i]);
+		}
+		check_index(&s);
+		for (size_t i = 0; i < count; i += 2)
+		{
+			slices[i] = slice_alloc(&s, 1 + (i * 7) % 50);
+			assert(slices[i].count == 1 + (i * 7) % 50);
+		}
+		check_index(&s);
+		for (size_t i = 0; i < count; i++)
+		{
+			slice_free(&s, slices[(i * 617) % count]);
+		}
+		check_index(&s);
+		assert(s.free_slices_array_size == 1);
+		assert(s.free_slices[0].offset == 0 && s.free_slices[0].count == TEST_ELEMENTS);
+
+		slice_destroy(&s);
+	}
+}
+
+static void slice_realloc_tests(void)
+{
+	for (int policy = 0; policy < 2; policy++)
+	{
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_initialize_with_policy(&s, 100, (slice_policy)policy);
+
+		slice_t a = slice_alloc(&s, 10);
+		slice_t b = slice_realloc(&s, a, 30);
+		assert(b.offset == a.offset && b.count == 30 && "Free neighbour, must grow in place!");
+		b = slice_realloc(&s, b, 20);
+		assert(b.offset == 0 && b.count == 20);
+		assert(slice_compute_unused_count(&s) == 80 && s.free_slices_array_size == 1);
+
+		// Blocked by an allocated slice, moves
+		slice_t c = slice_alloc(&s, 10);
+		assert(c.offset == 20);
+		slice_t moved = slice_realloc(&s, b, 40);
+		assert(moved.count == 40 && moved.offset == 30);
+		assert(slice_compute_unused_count(&s) == 50);
+
+		// Failure keeps the slice allocated
+		slice_t failed = slice_realloc(&s, moved, 91);
+		assert(failed.count == 0);
+		assert(slice_compute_unused_count(&s) == 50);
+
+		// Exact fit takes the whole neighbour
+		moved = slice_realloc(&s, moved, 70);
+		assert(moved.offset == 30 && moved.count == 70 && slice_compute_unused_count(&s) == 20);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&s);
+
+		assert(slice_realloc(&s, moved, 0).count == 0);
+		slice_free(&s, c);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].count == 100);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&s);
+		slice_destroy(&s);
+	}
+}
+
+static void slice_metadata_tests(void)
+{
+	// A full metadata region fails the allocation, frees of whole slices never need more
+	for (int policy = 0; policy < 2; policy++)
+	{
+		_Alignas(16) char metadata[2048];
+		metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+		slice_options options = { .policy = (slice_policy)policy, .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		slice_t slices[1024];
+		size_t count = 0;
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+
+		assert(slice_initialize_ex(&s, TEST_ELEMENTS, &options) == 1);
+		while (count < 1024 && (slices[count] = slice_alloc(&s, 10)).count != 0)
+			count++;
+		assert(count > 0 && count < 1024);
+
+		// Every other slice makes the most free slices, none of the frees may be lost
+		const size_t calls = region.calls;
+		for (size_t i = 0; i < count; i += 2)
+			slice_free(&s, slices[i]);
+		assert(region.calls == calls && "Frees must not allocate metadata!");
+		assert(slice_compute_unused_count(&s) == TEST_ELEMENTS - 10 * (count / 2));
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&s);
+		for (size_t i = 1; i < count; i += 2)
+			slice_free(&s, slices[i]);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].count == TEST_ELEMENTS);
+		slice_destroy(&s);
+	}
+
+	// No room at all, initialization reports it and nothing can be allocated
+	{
+		metadata_region region = { .buffer = NULL, .size = 0 };
+		slice_options options = { .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+
+		assert(slice_initialize_ex(&s, 100, &options) == 0);
+		assert(slice_alloc(&s, 1).count == 0);
+		slice_destroy(&s);
+	}
+}
+
+static void slice_offset_tests(void)
+{
+	// The whole range of the offsets can be used, one more element can't be represented
+	{
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+#if SLICE_OFFSET_BITS != 0
+		assert(sizeof(slice_t) == SLICE_OFFSET_BITS / 4);
+#endif
+		if (SLICE_MAX_ELEMENTS < SIZE_MAX)
+		{
+			assert(slice_initialize_ex(&s, SLICE_MAX_ELEMENTS + 1, NULL) == 0);
+			assert(slice_alloc(&s, 1).count == 0);
+			slice_destroy(&s);
+			memset(&s, 0, sizeof(s));
+		}
+		if (SLICE_MAX_ELEMENTS <= UINT32_MAX)
+		{
+			assert(slice_initialize_ex(&s, SLICE_MAX_ELEMENTS, NULL) == 1);
+			slice_t a = slice_alloc(&s, SLICE_MAX_ELEMENTS - 1);
+			slice_t b = slice_alloc(&s, 1);
+			assert(a.offset == 0 && a.count == SLICE_MAX_ELEMENTS - 1);
+			assert(b.offset == SLICE_MAX_ELEMENTS - 1 && b.count == 1);
+			assert(slice_alloc(&s, 1).count == 0);
+			slice_free(&s, a);
+			slice_free(&s, b);
+			assert(s.free_slices_array_size == 1 && s.free_slices[0].count == SLICE_MAX_ELEMENTS);
+			slice_destroy(&s);
+		}
+	}
+}
+
+static void slice_many_tests(void)
+{
+	// Batched free ends with the same free slices as freeing one by one
+	for (int policy = 0; policy < 2; policy++)
+	{
+		enum { count = 2000 };
+		static slice_t slices[count];
+		static slice_t batch[count];
+		slice_allocator one, many;
+		size_t batch_size = 0;
+		memset(&one, 0, sizeof(one));
+		memset(&many, 0, sizeof(many));
+		slice_initialize_with_policy(&one, TEST_ELEMENTS, (slice_policy)policy);
+		slice_initialize_with_policy(&many, TEST_ELEMENTS, (slice_policy)policy);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			slices[i] = slice_alloc(&one, 1 + (i * 13) % 20);
+			const slice_t same = slice_alloc(&many, 1 + (i * 13) % 20);
+			assert(slices[i].count && same.offset == slices[i].offset);
+		}
+
+		// Scrambled, with neighbours of each other and of the free slices
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t j = (i * 617) % count;
+			if (j % 3 == 0)
+				continue;
+			slice_free(&one, slices[j]);
+			batch[batch_size++] = slices[j];
+		}
+		slice_free_many(&many, batch, batch_size);
+		assert(many.free_slices_array_size == one.free_slices_array_size);
+		assert(memcmp(many.free_slices, one.free_slices, one.free_slices_array_size * sizeof(slice_t)) == 0);
+		assert(many.allocated_slices == one.allocated_slices);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&many);
+
+		// Both place the next slice the same, the rest makes the whole space again
+		batch_size = 0;
+		batch[batch_size] = slice_alloc(&many, 15);
+		assert(batch[batch_size++].offset == slice_alloc(&one, 15).offset);
+		for (size_t i = 0; i < count; i += 3)
+			batch[batch_size++] = slices[i];
+		slice_free_many(&many, batch, batch_size);
+		slice_free_many(&many, batch, 0);
+		assert(many.free_slices_array_size == 1 && many.free_slices[0].count == TEST_ELEMENTS);
+		assert(many.allocated_slices == 0);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&many);
+		slice_destroy(&one);
+		slice_destroy(&many);
+	}
+
+	// Batched alloc carves in one pass, what doesn't fit after the previous request falls back to first fit
+	{
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_initialize(&s, 100);
+		slice_t holes[5];
+		for (size_t i = 0; i < 5; i++)
+			holes[i] = slice_alloc(&s, 10);
+		slice_t rest = slice_alloc(&s, 50);
+		slice_free(&s, holes[0]);
+		slice_free(&s, holes[2]);
+		slice_free(&s, holes[4]);
+
+		const size_t counts[5] = { 4, 6, 10, 8, 50 };
+		slice_t slices[5];
+		assert(slice_alloc_many(&s, counts, slices, 5) == 4);
+		assert(slices[0].offset == 0 && slices[0].count == 4);
+		assert(slices[1].offset == 4 && slices[1].count == 6 && "Exact fit takes the whole free slice!");
+		assert(slices[2].offset == 20 && slices[2].count == 10);
+		assert(slices[3].offset == 40 && slices[3].count == 8);
+		assert(slices[4].count == 0);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].offset == 48 && s.free_slices[0].count == 2);
+		assert(s.allocated_slices == 3 + 4);
+
+		slice_free_many(&s, slices, 4);
+		slice_free(&s, holes[1]);
+		slice_free(&s, holes[3]);
+		slice_free(&s, rest);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].count == 100 && s.allocated_slices == 0);
+		slice_destroy(&s);
+	}
+
+	// Batched free without metadata memory for the scratch copy still releases everything
+	{
+		_Alignas(16) char metadata[256];
+		metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+		slice_options options = { .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		slice_t slices[8];
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		assert(slice_initialize_ex(&s, 100, &options) == 1);
+		size_t counts[8];
+		for (size_t i = 0; i < 8; i++)
+			counts[i] = 5;
+		assert(slice_alloc_many(&s, counts, slices, 8) == 8);
+		region.used = region.size;
+		region.last = NULL;
+		slice_free_many(&s, slices, 8);
+		assert(s.free_slices_array_size == 1 && slice_compute_unused_count(&s) == 100);
+		slice_destroy(&s);
+	}
+}
+
+static void slice_grow_tests(void)
+{
+	for (int policy = 0; policy < 2; policy++)
+	{
+		slice_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_initialize_with_policy(&s, 10, (slice_policy)policy);
+
+		// Full space, the new elements make a free slice at the end
+		slice_t a = slice_alloc(&s, 10);
+		assert(slice_alloc(&s, 1).count == 0);
+		assert(slice_grow(&s, 20) == 1 && s.max_elements == 20);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].offset == 10 && s.free_slices[0].count == 10);
+		slice_t b = slice_alloc(&s, 4);
+		assert(b.offset == 10);
+
+		// Trailing free slice is extended in place
+		assert(slice_grow(&s, 40) == 1);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].offset == 14 && s.free_slices[0].count == 26);
+		slice_t c = slice_alloc(&s, 26);
+		assert(c.offset == 14);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&s);
+
+		// Shrinking only drops the trailing free slice
+		slice_free(&s, c);
+		slice_free(&s, a);
+		assert(slice_shrink_to_fit(&s) == 14 && s.max_elements == 14);
+		assert(s.free_slices_array_size == 1 && s.free_slices[0].count == 10);
+		assert(slice_shrink_to_fit(&s) == 14);
+		assert(slice_alloc(&s, 11).count == 0);
+		if (policy == SLICE_POLICY_BEST_FIT)
+			check_index(&s);
+
+		slice_free(&s, b);
+		assert(slice_shrink_to_fit(&s) == 0 && s.free_slices_array_size == 0);
+		assert(slice_alloc(&s, 1).count == 0);
+		assert(slice_grow(&s, 8) == 1);
+		assert(slice_alloc(&s, 8).offset == 0);
+		if (SLICE_MAX_ELEMENTS < SIZE_MAX)
+			assert(slice_grow(&s, SLICE_MAX_ELEMENTS + 1) == 0 && s.max_elements == 8);
+		slice_destroy(&s);
+	}
+}
+
+/* Every inner node of the buddy tree must match its children. */
+static void check_buddy(const slice_buddy_allocator* s)
+{
+	for (uint32_t order = 1; order <= s->levels; order++)
+	{
+		const size_t first = (size_t)1 << (s->levels - order);
+		for (size_t node = first; node < first * 2; node++)
+		{
+			const uint8_t left = s->tree[node * 2];
+			const uint8_t right = s->tree[node * 2 + 1];
+			const uint8_t whole = (uint8_t)(order + 1);
+			assert((s->tree[node] == 0 || s->tree[node] == whole || s->tree[node] == (left > right ? left : right)) && "Tree must be consistent!");
+			if (s->tree[node] == whole)
+				assert(left == order && right == order);
+		}
+	}
+}
+
+static void slice_buddy_tests(void)
+{
+	// Power of two blocks aligned on their size, buddies merge back
+	{
+		slice_buddy_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_buddy_initialize(&s, 64, 1);
+		assert(s.levels == 6);
+
+		slice_t a = slice_buddy_alloc(&s, 3);
+		assert(a.offset == 0 && a.count == 3);
+		slice_t b = slice_buddy_alloc(&s, 1);
+		assert(b.offset == 4 && b.count == 1);
+		slice_t c = slice_buddy_alloc(&s, 8);
+		assert(c.offset == 8 && c.count == 8);
+		slice_t d = slice_buddy_alloc(&s, 2);
+		assert(d.offset == 6 && "Lowest free block of the size!");
+		slice_t e = slice_buddy_alloc(&s, 33);
+		assert(e.count == 0 && "64 elements block is split!");
+		slice_t f = slice_buddy_alloc(&s, 32);
+		assert(f.offset == 32);
+		assert(slice_buddy_compute_unused_count(&s) == 64 - 4 - 1 - 8 - 2 - 32);
+		check_buddy(&s);
+
+		slice_buddy_free(&s, b);
+		slice_buddy_free(&s, d);
+		slice_buddy_free(&s, a);
+		check_buddy(&s);
+		assert(slice_buddy_alloc(&s, 8).offset == 0 && "Buddies must be merged!");
+		slice_buddy_free(&s, (slice_t){ .offset = 0, .count = 8 });
+		slice_buddy_free(&s, c);
+		slice_buddy_free(&s, f);
+		check_buddy(&s);
+		assert(s.tree[1] == 7 && slice_buddy_compute_unused_count(&s) == 64);
+		slice_buddy_destroy(&s);
+	}
+
+	// Space that isn't a power of two and bigger blocks
+	{
+		slice_buddy_allocator s;
+		memset(&s, 0, sizeof(s));
+		slice_buddy_initialize(&s, 100, 3);
+		assert(s.min_count == 4 && s.levels == 5);
+		assert(slice_buddy_compute_unused_count(&s) == 100);
+
+		slice_t a = slice_buddy_alloc(&s, 64);
+		assert(a.offset == 0);
+		assert(slice_buddy_alloc(&s, 64).count == 0 && "Blocks past the space are never free!");
+		slice_t b = slice_buddy_alloc(&s, 32);
+		slice_t c = slice_buddy_alloc(&s, 1);
+		assert(b.offset == 64 && c.offset == 96 && c.count == 1);
+		assert(slice_buddy_alloc(&s, 1).count == 0);
+		assert(slice_buddy_compute_unused_count(&s) == 0);
+		slice_buddy_free(&s, b);
+		slice_buddy_free(&s, a);
+		slice_buddy_free(&s, c);
+		check_buddy(&s);
+		assert(slice_buddy_compute_unused_count(&s) == 100);
+		slice_buddy_destroy(&s);
+	}
+
+	// Random churn against a shadow of the used elements
+	{
+		enum { space = 4096, count = 300 };
+		static unsigned char owner[space];
+		slice_t slices[count];
+		slice_buddy_allocator s;
+		unsigned state = 1;
+		memset(&s, 0, sizeof(s));
+		memset(slices, 0, sizeof(slices));
+		memset(owner, 0, sizeof(owner));
+		slice_buddy_initialize(&s, space, 1);
+
+		for (size_t i = 0; i < 20000; i++)
+		{
+			state = state * 1103515245u + 12345u;
+			const size_t slot = (state >> 8) % count;
+			if (slices[slot].count)
+			{
+				for (size_t e = 0; e < slices[slot].count; e++)
+				{
+					assert(owner[slices[slot].offset + e] == (unsigned char)(slot + 1));
+					owner[slices[slot].offset + e] = 0;
+				}
+				slice_buddy_free(&s, slices[slot]);
+				slices[slot].count = 0;
+			}
+			else
+			{
+				slices[slot] = slice_buddy_alloc(&s, 1 + (state >> 16) % 40);
+				for (size_t e = 0; e < slices[slot].count; e++)
+				{
+					assert(owner[slices[slot].offset + e] == 0 && "Slices must not overlap!");
+					owner[slices[slot].offset + e] = (unsigned char)(slot + 1);
+				}
+			}
+		}
+		check_buddy(&s);
+		for (size_t i = 0; i < count; i++)
+			if (slices[i].count)
+				slice_buddy_free(&s, slices[i]);
+		assert(s.tree[1] == s.levels + 1 && slice_buddy_compute_unused_count(&s) == space);
+		slice_buddy_destroy(&s);
+	}
+
+	// The tree goes through the metadata callback, too small a region fails the initialization
+	{
+		_Alignas(16) char metadata[64];
+		metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+		slice_options options = { .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		slice_buddy_allocator s;
+		memset(&s, 0, sizeof(s));
+		assert(slice_buddy_initialize_ex(&s, 32, 1, &options) == 1);
+		assert(region.calls == 1 && region.used == 64);
+		slice_buddy_destroy(&s);
+
+		memset(&s, 0, sizeof(s));
+		region.used = 0;
+		assert(slice_buddy_initialize_ex(&s, 64, 1, &options) == 0);
+		assert(slice_buddy_alloc(&s, 1).count == 0);
+		slice_buddy_destroy(&s);
+	}
+}
+
+static void slice_concurrent_tests(void)
+{
+	// Runs inside a word, lowest offset first from the cursor, never across words
+	{
+		slice_concurrent_allocator s;
+		slice_concurrent_cursor cursor;
+		memset(&s, 0, sizeof(s));
+		slice_concurrent_initialize(&s, 130);
+		assert(s.word_count == 3);
+		assert(slice_concurrent_compute_unused_count(&s) == 130);
+		slice_concurrent_cursor_initialize(&cursor, &s, 0);
+		assert(cursor.hint == 0);
+
+		slice_t a = slice_concurrent_alloc(&cursor, 10);
+		slice_t b = slice_concurrent_alloc(&cursor, 50);
+		assert(a.offset == 0 && a.count == 10);
+		assert(b.offset == 10 && b.count == 50);
+		slice_t c = slice_concurrent_alloc(&cursor, 5);
+		assert(c.offset == 64 && "4 elements left in the first word!");
+		assert(cursor.hint == 1);
+		slice_t d = slice_concurrent_alloc(&cursor, 3);
+		assert(d.offset == 69);
+		slice_t e = slice_concurrent_alloc(&cursor, 2);
+		assert(e.offset == 72);
+		assert(slice_concurrent_alloc(&cursor, 57).count == 0 && "Last word only has 2 elements!");
+		slice_t f = slice_concurrent_alloc(&cursor, 2);
+		assert(f.offset == 74);
+		assert(slice_concurrent_compute_unused_count(&s) == 130 - 10 - 50 - 5 - 3 - 2 - 2);
+
+		// Freed elements are reused, a whole word at once
+		slice_concurrent_free(&s, a);
+		slice_concurrent_free(&s, b);
+		cursor.hint = 0;
+		slice_t g = slice_concurrent_alloc(&cursor, 60);
+		assert(g.offset == 0 && g.count == 60);
+		slice_concurrent_free(&s, g);
+		slice_concurrent_free(&s, c);
+		slice_concurrent_free(&s, d);
+		slice_concurrent_free(&s, e);
+		slice_concurrent_free(&s, f);
+		slice_t h = slice_concurrent_alloc(&cursor, 64);
+		assert(h.offset == 0 && h.count == 64);
+		slice_concurrent_free(&s, h);
+		assert(slice_concurrent_compute_unused_count(&s) == 130);
+		slice_concurrent_destroy(&s);
+	}
+
+	// The bitmap goes through the metadata callback
+	{
+		_Alignas(16) char metadata[16];
+		metadata_region region = { .buffer = metadata, .size = sizeof(metadata) };
+		slice_options options = { .metadata_realloc = metadata_region_realloc, .metadata_user = &region };
+		slice_concurrent_allocator s;
+		memset(&s, 0, sizeof(s));
+		assert(slice_concurrent_initialize_ex(&s, 128, &options) == 1);
+		slice_concurrent_destroy(&s);
+		memset(&s, 0, sizeof(s));
+		region.used = 0;
+		assert(slice_concurrent_initialize_ex(&s, 129, &options) == 0);
+		slice_concurrent_destroy(&s);
+	}
+}
+
+#if !defined(_WIN32)
+#include <pthread.h>
+
+#define STRESS_THREADS 8
+#define STRESS_ELEMENTS 2048
+#define STRESS_ROUNDS 20000
+
+static slice_concurrent_allocator stress_slices;
+static volatile unsigned char stress_owner[STRESS_ELEMENTS];
+
+/* Every thread marks the elements it holds, an element handed out twice would have its mark overwritten. */
+static void* stress_thread(void* arg)
+{
+	const unsigned char mark = (unsigned char)(uintptr_t)arg;
+	slice_concurrent_cursor cursor;
+	slice_t held[4];
+	unsigned state = mark;
+	size_t i, j, e;
+
+	slice_concurrent_cursor_initialize(&cursor, &stress_slices, mark);
+	for (i = 0; i < STRESS_ROUNDS; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			state = state * 1103515245u + 12345u;
+			held[j] = slice_concurrent_alloc(&cursor, 1 + (state >> 16) % 40);
+			for (e = 0; e < held[j].count; e++)
+				stress_owner[held[j].offset + e] = mark;
+		}
+		for (j = 0; j < 4; j++)
+		{
+			for (e = 0; e < held[j].count; e++)
+				assert(stress_owner[held[j].offset + e] == mark && "Element handed out to two threads!");
+			if (held[j].count)
+				slice_concurrent_free(&stress_slices, held[j]);
+		}
+	}
+	return NULL;
+}
+
+static void slice_concurrent_thread_tests(void)
+{
+	// Many threads, fewer elements than they ask for to force contention and exhaustion
+	{
+		pthread_t threads[STRESS_THREADS];
+		size_t i;
+
+		memset(&stress_slices, 0, sizeof(stress_slices));
+		slice_concurrent_initialize(&stress_slices, STRESS_ELEMENTS / 4);
+		for (i = 0; i < STRESS_THREADS; i++)
+			pthread_create(&threads[i], NULL, stress_thread, (void*)(uintptr_t)(i + 1));
+		for (i = 0; i < STRESS_THREADS; i++)
+			pthread_join(threads[i], NULL);
+
+		assert(slice_concurrent_compute_unused_count(&stress_slices) == STRESS_ELEMENTS / 4);
+		slice_concurrent_destroy(&stress_slices);
+	}
+}
+#endif
+
 int main(void)
 {
 	slice_tests();
+	slice_best_fit_tests();
+	slice_realloc_tests();
+	slice_metadata_tests();
+	slice_offset_tests();
+	slice_buddy_tests();
+	slice_many_tests();
+	slice_grow_tests();
+	slice_concurrent_tests();
+#if !defined(_WIN32)
+	slice_concurrent_thread_tests();
+#endif
 	return 0;
 }
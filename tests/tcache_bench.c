@@ -0,0 +1,211 @@
+// Multi threaded scalability of the thread cache against a global mutex around the backend.
+// Usage: tcache_bench [operations per thread] [max threads]
+// Each thread churns random sizes over its own slots, the total throughput is reported per thread count.
+
+#include "bench_common.h"
+#include "clow/tcache.c"
+
+#include <pthread.h>
+
+#define TBENCH_POOL_SIZE (256u * 1024u * 1024u)
+#define TBENCH_SLOTS 256
+#define TBENCH_MAX_THREADS 64
+
+typedef enum {
+	TBENCH_MUTEX_GPALLOC,
+	TBENCH_TCACHE_GPALLOC,
+	TBENCH_MUTEX_FREELIST,
+	TBENCH_TCACHE_FREELIST,
+	TBENCH_MALLOC,
+	TBENCH_MODE_COUNT
+} tbench_mode;
+
+static const char* const tbench_mode_names[TBENCH_MODE_COUNT] = {
+	"gpalloc+mutex", "tcache(gpalloc)", "freelist_tlsf+mutex", "tcache(freelist_tlsf)", "malloc"
+};
+
+typedef struct {
+	tbench_mode mode;
+	pthread_mutex_t lock;
+	gpalloc_t gpalloc;
+	freelist_t freelist;
+	tcache_t cache;
+	size_t operations;
+	size_t failures;
+} tbench_shared;
+
+typedef struct {
+	tbench_shared* shared;
+	uint64_t seed;
+} tbench_thread;
+
+static void* tbench_alloc(tbench_shared* shared, tcache_thread_t* local, size_t size)
+{
+	void* ptr;
+	switch (shared->mode)
+	{
+	case TBENCH_MUTEX_GPALLOC:
+		pthread_mutex_lock(&shared->lock);
+		ptr = gpalloc_malloc(&shared->gpalloc, size, TCACHE_ALIGNMENT);
+		pthread_mutex_unlock(&shared->lock);
+		return ptr;
+	case TBENCH_MUTEX_FREELIST:
+		pthread_mutex_lock(&shared->lock);
+		ptr = freelist_malloc(&shared->freelist, size);
+		pthread_mutex_unlock(&shared->lock);
+		return ptr;
+	case TBENCH_TCACHE_GPALLOC:
+	case TBENCH_TCACHE_FREELIST:
+		return tcache_malloc(local, size);
+	default:
+		return malloc(size);
+	}
+}
+
+static void tbench_release(tbench_shared* shared, tcache_thread_t* local, void* ptr, size_t size)
+{
+	switch (shared->mode)
+	{
+	case TBENCH_MUTEX_GPALLOC:
+		pthread_mutex_lock(&shared->lock);
+		gpalloc_free(&shared->gpalloc, ptr);
+		pthread_mutex_unlock(&shared->lock);
+		break;
+	case TBENCH_MUTEX_FREELIST:
+		pthread_mutex_lock(&shared->lock);
+		freelist_free(&shared->freelist, ptr);
+		pthread_mutex_unlock(&shared->lock);
+		break;
+	case TBENCH_TCACHE_GPALLOC:
+	case TBENCH_TCACHE_FREELIST:
+		tcache_free(local, ptr, size);
+		break;
+	default:
+		free(ptr);
+		break;
+	}
+}
+
+static void* tbench_worker(void* arg)
+{
+	tbench_thread* thread = (tbench_thread*)arg;
+	tbench_shared* shared = thread->shared;
+	void* slots[TBENCH_SLOTS];
+	size_t sizes[TBENCH_SLOTS];
+	tcache_thread_t local;
+	uint64_t state = thread->seed;
+	size_t failures = 0;
+	size_t i;
+
+	memset(slots, 0, sizeof(slots));
+	if (shared->mode == TBENCH_TCACHE_GPALLOC || shared->mode == TBENCH_TCACHE_FREELIST)
+		tcache_thread_attach(&local, &shared->cache);
+
+	for (i = 0; i < shared->operations; ++i)
+	{
+		size_t slot;
+		// Per thread xorshift, the global one in bench_common.h is not thread safe
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		slot = (size_t)((state * 0x2545F4914F6CDD1Dull) >> 32) % TBENCH_SLOTS;
+		if (slots[slot])
+		{
+			tbench_release(shared, &local, slots[slot], sizes[slot]);
+			slots[slot] = NULL;
+		}
+		else
+		{
+			sizes[slot] = 16 + (size_t)(state >> 40) % 1008;
+			slots[slot] = tbench_alloc(shared, &local, sizes[slot]);
+			failures += slots[slot] == NULL;
+		}
+	}
+	for (i = 0; i < TBENCH_SLOTS; ++i)
+		if (slots[i])
+			tbench_release(shared, &local, slots[i], sizes[i]);
+
+	if (shared->mode == TBENCH_TCACHE_GPALLOC || shared->mode == TBENCH_TCACHE_FREELIST)
+		tcache_thread_detach(&local);
+
+	pthread_mutex_lock(&shared->lock);
+	shared->failures += failures;
+	pthread_mutex_unlock(&shared->lock);
+	return NULL;
+}
+
+static double tbench_run(tbench_mode mode, size_t threads, size_t operations, void* buffer, size_t* failures)
+{
+	static tbench_shared shared;
+	pthread_t handles[TBENCH_MAX_THREADS];
+	tbench_thread contexts[TBENCH_MAX_THREADS];
+	uint64_t start, elapsed;
+	size_t i;
+
+	memset(&shared, 0, sizeof(shared));
+	shared.mode = mode;
+	shared.operations = operations;
+	pthread_mutex_init(&shared.lock, NULL);
+	gpalloc_initialize(&shared.gpalloc, buffer, TBENCH_POOL_SIZE);
+	freelist_initialize_tlsf(&shared.freelist, buffer, TBENCH_POOL_SIZE);
+	if (mode == TBENCH_TCACHE_GPALLOC)
+		tcache_initialize_gpalloc(&shared.cache, &shared.gpalloc);
+	else
+		tcache_initialize_freelist(&shared.cache, &shared.freelist);
+
+	start = bench_now_ns();
+	for (i = 0; i < threads; ++i)
+	{
+		contexts[i].shared = &shared;
+		contexts[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+		pthread_create(&handles[i], NULL, tbench_worker, &contexts[i]);
+	}
+	for (i = 0; i < threads; ++i)
+		pthread_join(handles[i], NULL);
+	elapsed = bench_now_ns() - start;
+
+	tcache_destroy(&shared.cache);
+	gpalloc_destroy(&shared.gpalloc);
+	pthread_mutex_destroy(&shared.lock);
+	*failures = shared.failures;
+	return (double)(operations * threads) * 1000.0 / (double)elapsed;
+}
+
+int main(int argc, char** argv)
+{
+	size_t operations = 200000;
+	size_t max_threads = 8;
+	void* buffer;
+	size_t threads;
+	int mode;
+
+	if (argc > 1)
+		operations = (size_t)strtoull(argv[1], NULL, 10);
+	if (argc > 2)
+		max_threads = (size_t)strtoull(argv[2], NULL, 10);
+	if (max_threads > TBENCH_MAX_THREADS)
+		max_threads = TBENCH_MAX_THREADS;
+
+	buffer = malloc(TBENCH_POOL_SIZE);
+	printf("operations per thread %u, Mops/s total (failed allocations)\n", (unsigned)operations);
+	printf("%-22s", "threads");
+	for (threads = 1; threads <= max_threads; threads *= 2)
+		printf(" %14u", (unsigned)threads);
+	printf("\n");
+
+	for (mode = 0; mode < TBENCH_MODE_COUNT; ++mode)
+	{
+		printf("%-22s", tbench_mode_names[mode]);
+		for (threads = 1; threads <= max_threads; threads *= 2)
+		{
+			size_t failures;
+			const double mops = tbench_run((tbench_mode)mode, threads, operations, buffer, &failures);
+			printf(" %8.2f (%3u)", mops, (unsigned)failures);
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+
+	free(buffer);
+	return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "clow/freelist.c"
+// Both sources define their own punning helper
+#undef pun_cpy
+#include "clow/gpalloc.c"
+#include "clow/tcache.c"
+
+#define POOL_SIZE (1u << 20)
+
+static void tcache_freelist_tests(void)
+{
+	// A hit in the bin takes no lock, a miss refills a batch with one lock
+	{
+		void* buffer = malloc(POOL_SIZE);
+		freelist_t backend;
+		tcache_t cache;
+		tcache_thread_t local;
+		void* a;
+		void* b;
+
+		freelist_initialize_tlsf(&backend, buffer, POOL_SIZE);
+		tcache_initialize_freelist(&cache, &backend);
+		tcache_thread_attach(&local, &cache);
+
+		a = tcache_malloc(&local, 24);
+		assert(a);
+		assert(cache.lock_count == 1);
+		assert(local.bins[1].count == TCACHE_BATCH - 1 && "24 bytes is in the 32 bytes class!");
+		assert(freelist_get_allocation_size(&backend, a) >= 32);
+
+		tcache_free(&local, a, 24);
+		b = tcache_malloc(&local, 32);
+		assert(b == a && "Must reuse the last freed block of the class!");
+		assert(cache.lock_count == 1);
+		tcache_free(&local, b, 32);
+
+		tcache_thread_detach(&local);
+		assert(cache.lock_count == 2);
+		assert(freelist_verify_corruption(&backend) == 1);
+
+		// Everything went back, the whole pool is allocatable again
+		a = freelist_malloc(&backend, POOL_SIZE - freelist_tlsf_overhead());
+		assert(a);
+		freelist_free(&backend, a);
+
+		tcache_destroy(&cache);
+		free(buffer);
+	}
+
+	// A full bin flushes a batch, the bin never exceeds its limit
+	{
+		void* buffer = malloc(POOL_SIZE);
+		void* blocks[TCACHE_BIN_LIMIT * 2];
+		freelist_t backend;
+		tcache_t cache;
+		tcache_thread_t local;
+		size_t i;
+
+		freelist_initialize_tlsf(&backend, buffer, POOL_SIZE);
+		tcache_initialize_freelist(&cache, &backend);
+		tcache_thread_attach(&local, &cache);
+
+		for (i = 0; i < TCACHE_BIN_LIMIT * 2; ++i)
+		{
+			blocks[i] = tcache_malloc(&local, 64);
+			assert(blocks[i]);
+			memset(blocks[i], 'W', 64);
+		}
+		for (i = 0; i < TCACHE_BIN_LIMIT * 2; ++i)
+		{
+			tcache_free(&local, blocks[i], 64);
+			assert(local.bins[2].count <= TCACHE_BIN_LIMIT);
+		}
+		assert(freelist_verify_corruption(&backend) == 1);
+
+		tcache_thread_detach(&local);
+		assert(freelist_verify_corruption(&backend) == 1);
+		tcache_destroy(&cache);
+		free(buffer);
+	}
+
+	// Requests bigger than the classes go to the backend, exhaustion returns NULL
+	{
+		void* buffer = malloc(POOL_SIZE);
+		freelist_t backend;
+		tcache_t cache;
+		tcache_thread_t local;
+		void* a;
+
+		freelist_initialize_tlsf(&backend, buffer, POOL_SIZE);
+		tcache_initialize_freelist(&cache, &backend);
+		tcache_thread_attach(&local, &cache);
+
+		a = tcache_malloc(&local, TCACHE_MAX_SIZE + 1);
+		assert(a);
+		assert(tcache_malloc(&local, POOL_SIZE) == NULL);
+		tcache_free(&local, a, TCACHE_MAX_SIZE + 1);
+
+		tcache_thread_detach(&local);
+		assert(freelist_verify_corruption(&backend) == 1);
+		tcache_destroy(&cache);
+		free(buffer);
+	}
+}
+
+static void tcache_gpalloc_tests(void)
+{
+	// Blocks come from gpalloc aligned and return there on detach
+	{
+		void* buffer = malloc(POOL_SIZE);
+		void* blocks[100];
+		gpalloc_t backend;
+		tcache_t cache;
+		tcache_thread_t local;
+		size_t i;
+
+		gpalloc_initialize(&backend, buffer, POOL_SIZE);
+		tcache_initialize_gpalloc(&cache, &backend);
+		tcache_thread_attach(&local, &cache);
+
+		for (i = 0; i < 100; ++i)
+		{
+			blocks[i] = tcache_malloc(&local, 16 + i * 16);
+			assert(blocks[i]);
+			assert((uintptr_t)blocks[i] % TCACHE_ALIGNMENT == 0);
+		}
+		for (i = 0; i < 100; ++i)
+			tcache_free(&local, blocks[i], 16 + i * 16);
+		assert(gpalloc_verify(&backend) == 1);
+
+		tcache_thread_detach(&local);
+		assert(gpalloc_verify(&backend) == 1);
+		assert(backend.allocation_array_size == 1 && !backend.allocation_array[0].used);
+
+		tcache_destroy(&cache);
+		gpalloc_destroy(&backend);
+		free(buffer);
+	}
+}
+
+#if !defined(_WIN32)
+
+#define STRESS_THREADS 4
+#define STRESS_SLOTS 128
+
+typedef struct {
+	tcache_t* cache;
+	unsigned seed;
+} stress_context;
+
+static void* stress_thread(void* arg)
+{
+	stress_context* context = (stress_context*)arg;
+	void* slots[STRESS_SLOTS];
+	size_t sizes[STRESS_SLOTS];
+	tcache_thread_t local;
+	unsigned state = context->seed;
+	size_t i;
+
+	memset(slots, 0, sizeof(slots));
+	tcache_thread_attach(&local, context->cache);
+	for (i = 0; i < 20000; ++i)
+	{
+		size_t slot;
+		state = state * 1103515245u + 12345u;
+		slot = (state >> 8) % STRESS_SLOTS;
+		if (slots[slot])
+		{
+			// The pattern must survive the other threads
+			assert(*(unsigned char*)slots[slot] == (unsigned char)slot);
+			tcache_free(&local, slots[slot], sizes[slot]);
+			slots[slot] = NULL;
+		}
+		else
+		{
+			sizes[slot] = 16 + (state >> 16) % 4000;
+			slots[slot] = tcache_malloc(&local, sizes[slot]);
+			assert(slots[slot]);
+			memset(slots[slot], (int)slot, sizes[slot]);
+		}
+	}
+	for (i = 0; i < STRESS_SLOTS; ++i)
+		tcache_free(&local, slots[i], sizes[i]);
+	tcache_thread_detach(&local);
+	return NULL;
+}
+
+static void tcache_thread_tests(void)
+{
+	// Many threads over one gpalloc, the backend must end up consistent and empty
+	{
+		void* buffer = malloc(POOL_SIZE * 16);
+		pthread_t threads[STRESS_THREADS];
+		stress_context contexts[STRESS_THREADS];
+		gpalloc_t backend;
+		tcache_t cache;
+		size_t i;
+
+		gpalloc_initialize(&backend, buffer, POOL_SIZE * 16);
+		tcache_initialize_gpalloc(&cache, &backend);
+
+		for (i = 0; i < STRESS_THREADS; ++i)
+		{
+			contexts[i].cache = &cache;
+			contexts[i].seed = (unsigned)i + 1;
+			pthread_create(&threads[i], NULL, stress_thread, &contexts[i]);
+		}
+		for (i = 0; i < STRESS_THREADS; ++i)
+			pthread_join(threads[i], NULL);
+
+		assert(gpalloc_verify(&backend) == 1);
+		assert(backend.allocation_array_size == 1 && !backend.allocation_array[0].used);
+
+		tcache_destroy(&cache);
+		gpalloc_destroy(&backend);
+		free(buffer);
+	}
+}
+
+#endif
+
+int main(void)
+{
+	tcache_freelist_tests();
+	tcache_gpalloc_tests();
+#if !defined(_WIN32)
+	tcache_thread_tests();
+#endif
+	return 0;
+}